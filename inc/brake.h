@@ -0,0 +1,54 @@
+/**
+  ******************************************************************************
+  * @file brake.h
+  * @brief Active braking and regen-limited deceleration
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef BRAKE_H
+#define BRAKE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "pwm_stm8s.h" // PWM_PERIOD_COUNTS
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Brake level full scale i.e. low-sides shorted on every PWM frame
+ */
+#define BRK_LEVEL_FULL  PWM_PERIOD_COUNTS
+
+/**
+ * @brief Brake level step of the terminal key, 1/8 of full scale
+ */
+#define BRK_LEVEL_STEP  ( BRK_LEVEL_FULL / 8 )
+
+/* types ---------------------------------------------------------------------*/
+
+/**
+ * @brief Deceleration modes
+ */
+typedef enum
+{
+    BRAKE_OFF = 0,  /**< motor windmills when switched off (default) */
+    BRAKE_ACTIVE,   /**< low-sides shorted at brake level when switched off */
+    BRAKE_REGEN,    /**< as active, and deceleration limited by bus voltage */
+    BRAKE_NR_MODES
+}
+brake_mode_t;
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Brake_set_mode(brake_mode_t);
+brake_mode_t Brake_get_mode(void);
+void Brake_set_level(uint16_t);
+uint16_t Brake_get_level(void);
+
+uint16_t Brake_regen_limit(uint16_t);
+void Brake_Ctrl(void);
+void Brake_on_PWM_edge(void);
+
+#endif // BRAKE_H
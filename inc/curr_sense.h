@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file curr_sense.h
+  * @brief Motor current sensing and cycle-by-cycle current limit
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef CURR_SENSE_H
+#define CURR_SENSE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "pwm_stm8s.h" // PWM_PERIOD_COUNTS
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Scaling of current-sense amplifier output
+ * @details Shunt 1 mOhm, amplifier gain 50 -> 50 mV/A, 10-bit ADC w/ 5v ref
+ *  i.e. 1024 / 5v * 0.050 v/A = 10.24 counts/A, 0 A is 0 counts.
+ */
+#define CURR_ADC_COUNTS_PER_100A 1024
+#define CURR_ADC_OFFSET          0
+
+#define CURR_AMPS_TO_COUNTS( _AMPS_ ) \
+    (uint16_t)FXP_RATIO( _AMPS_, CURR_ADC_COUNTS_PER_100A, 100 )
+
+/**
+ * @brief Peak current limit applied each PWM cycle
+ */
+#define CURR_PEAK_LIMIT   CURR_AMPS_TO_COUNTS( 40 )
+
+/**
+ * @brief Average current fault threshold (30 A ESC rating)
+ */
+#define CURR_AVG_LIMIT    CURR_AMPS_TO_COUNTS( 30 )
+
+/**
+ * @brief Duty-cycle trim step added on each PWM cycle over the peak limit, and
+ *  removed by 1 count on each PWM cycle under the limit.
+ */
+#define CURR_TRIM_STEP    ( PWM_PERIOD_COUNTS / 64 )
+
+/**
+ * @brief Time constant of the average current filter (2^N PWM cycles)
+ */
+#define CURR_AVG_SH       6
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Curr_reset(void);
+uint16_t Curr_on_sample(uint16_t);
+
+uint16_t Curr_get_sample(void);
+uint16_t Curr_get_avg(void);
+uint16_t Curr_get_dc_trim(void);
+
+#endif // CURR_SENSE_H
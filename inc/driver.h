@@ -25,16 +25,43 @@
  * 100% / 250 counts == 0.4% per count
  * 250 * .004 == 1
  */
-#define PWM_PERCENT_PER_COUNT_250  0.004 //  ( 100.0 / MDATA_TBL_SIZE ) // .4% i.e. .004
+#define PWM_COUNTS_PER_STEP_250  250 //  ( 100.0 / MDATA_TBL_SIZE ) // .4% i.e. .004
 
 // table size originated from 250 step PWM confiugration
-#define MSPEED_PCNT_INCREM_STEP   ( PWM_PERIOD_COUNTS * PWM_PERCENT_PER_COUNT_250 )
+#define MSPEED_PCNT_INCREM_STEP   ( PWM_PERIOD_COUNTS / PWM_COUNTS_PER_STEP_250 )
 
 #define RX_BUFFER_SIZE  16  //how big should this be?
 
+/*
+ * Back-EMF samples taken at the quarter-sector ticks of the commutation timer
+ */
+#define DRIVER_BEMF_SMP_15  0  // 15 degrees into the sector
+#define DRIVER_BEMF_SMP_45  1  // 45 degrees into the sector
+#define DRIVER_BEMF_NR_SMP  2
+
+/*
+ * Phase voltage dividers on ADC channels AIN0, AIN1, AIN2. Boards without the
+ * phase B and C dividers (no PH1_BEMF_IN_PORT, S003) sense phase A only.
+ */
+#define DRIVER_PHASE_A      0
+#define DRIVER_PHASE_B      1
+#define DRIVER_PHASE_C      2
+#define DRIVER_NR_PHASES    3
+
 
 /* types --------------------------------------------------------------------*/
 
+/**
+ * @brief Snapshot of the ADC scan of one PWM cycle (ADC counts)
+ */
+typedef struct
+{
+  uint16_t phase[DRIVER_NR_PHASES]; /**< phase dividers, AIN0:2 */
+  uint16_t vbatt;   /**< phase A divider while phase A is driven PWM */
+  uint16_t slider;  /**< analog slider, AIN3 */
+  uint16_t curr;    /**< current-sense amplifier, AIN4 (0 if not fitted) */
+}
+driver_adc_scan_t;
 
 
 /* prototypes ---------------------------------------------------------------*/
@@ -42,14 +69,20 @@
 void Driver_Step(void);
 void Driver_Update(void);
 
-uint16_t Driver_Get_ADC(void);
 uint16_t Driver_Get_Back_EMF_Avg(void);
+uint16_t Driver_get_bemf_sample(uint8_t);
+uint16_t Driver_get_bemf_sample_tm(uint8_t);
+void Driver_set_sector_phases(uint8_t, uint8_t, uint8_t);
+void Driver_get_adc_scan(driver_adc_scan_t *);
 
 void Driver_on_PWM_edge(void);
 void Driver_on_ADC_conv(void);
 
 void Driver_on_capture_rise(void);
 void Driver_on_capture_fall(void);
+void Driver_on_capture_frame(void);
+void Driver_on_hall_edge(void);
+void Driver_on_zcp_capture(void);
 
 uint16_t Driver_get_motor_spd_pcnt(void);
 uint16_t Driver_get_pulse_dur(void);
@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file dshot.h
+  * @brief DShot digital throttle protocol decoder
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef DSHOT_H
+#define DSHOT_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Frame value range
+ * @details 11-bit value: 0 is disarmed (motor stop), 1-47 are commands and
+ *  48-2047 is the throttle.
+ */
+#define DSHOT_CMD_MOTOR_STOP     0
+#define DSHOT_CMD_SAVE_SETTINGS  12
+#define DSHOT_CMD_MAX            47
+#define DSHOT_THR_MIN            48
+#define DSHOT_THR_MAX            2047
+
+/**
+ * @brief Number of consecutive frames of a command before it is accepted
+ */
+#define DSHOT_CMD_REPEAT         6
+
+/**
+ * @brief Bit period of the capture timer counts (0.5 us), the bit rate is
+ *  detected from the timestamps
+ */
+#define DSHOT_CT_PER_US          2
+#define DSHOT_BIT_T_150          ( 20 * DSHOT_CT_PER_US / 3 ) // 6.67 us
+#define DSHOT_BIT_T_300          ( 10 * DSHOT_CT_PER_US / 3 ) // 3.33 us
+
+/**
+ * @brief Bits per frame, and the capture timeout that ends an incomplete frame
+ *  (no edge within 2 bit periods of DShot150, capture timer counts)
+ */
+#define DSHOT_FRAME_BITS         16
+#define DSHOT_EDGE_TMO           ( 2 * DSHOT_BIT_T_150 )
+
+/* types ---------------------------------------------------------------------*/
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Dshot_reset(void);
+
+uint8_t Dshot_on_frame(const uint16_t * pstart, const uint16_t * pend, uint8_t nr_bits);
+
+uint8_t Dshot_get_value(uint16_t * pvalue);
+uint8_t Dshot_get_command(void);
+uint16_t Dshot_get_rate(void);
+uint16_t Dshot_get_frames(void);
+uint16_t Dshot_get_errors(void);
+
+#endif // DSHOT_H
@@ -18,6 +18,21 @@
 #endif
 
 
+/*
+ * defines
+ */
+
+/**
+ * @brief Number of freeze-frame records retained in the fault history ring
+ */
+#define FAULTM_HIST_LEN  4
+
+/**
+ * @brief Bit in the fault status word corresponding to a fault ID
+ */
+#define FAULTM_STATUS_BIT( _ID_ )  (fault_status_reg_t)( 1 << (_ID_) )
+
+
 /*
  * types
  */
@@ -30,15 +45,21 @@ typedef char faultm_assert_t;
 /**
  * @brief integer enumeration of all defined system faults
  *
- * Relies on assigning explicit integer values to use bit-positions in the
- * system-error word - the system word is expected to fit in 8-bits.
+ * The ID is the index of the fault in the descriptor table (faultm.c) and the
+ * bit-position in the system-error word - the system word is expected to fit
+ * in 8-bits.
  */
 typedef enum
 {
-    FAULT_0 = 1,
-    FAULT_1 = 2,
-    VOLTAGE_NG = 4,
-    THROTTLE_HI = 8
+    FAULT_0 = 0,
+    FAULT_1,
+    VOLTAGE_NG,
+    THROTTLE_HI,
+    OVERCURRENT,
+    STALL,
+    SUPERVISOR,
+    SIGNAL_LOSS,
+    FAULTM_NR_FAULTS
 } faultm_ID_t;
 
 /**
@@ -46,6 +67,35 @@ typedef enum
  */
 typedef uint8_t fault_status_reg_t; // fault status bitmap
 
+/**
+ * @brief Fault descriptor
+ *
+ * @details The bucket is incremented by 'incr' while the fault condition is
+ *  asserted and leaks by 'decr' while it is not. The fault trips when the
+ *  bucket reaches 'thresh'.
+ */
+typedef struct
+{
+    uint8_t incr;    /**< bucket increment per update with condition asserted */
+    uint8_t decr;    /**< bucket decrement per update with condition cleared */
+    uint8_t thresh;  /**< trip threshold of the bucket */
+    uint8_t enabled; /**< fault enabled at initialization */
+}
+faultm_desc_t;
+
+/**
+ * @brief Freeze-frame record of the system state at the time of a fault trip
+ */
+typedef struct
+{
+    uint8_t  fault_ID;    /**< faultm_ID_t of the tripped fault */
+    uint8_t  opstate;     /**< BL control opstate */
+    uint16_t comm_period; /**< commutation period, timer counts */
+    uint16_t duty;        /**< PWM duty-cycle, PWM counts */
+    uint16_t vbatt;       /**< system voltage, ADC counts */
+}
+faultm_frame_t;
+
 
 /*
  * prototypes
@@ -55,9 +105,13 @@ void Faultm_init(void);
 
 void Faultm_upd(faultm_ID_t faultm_ID, faultm_assert_t tcondition);
 void Faultm_set(faultm_ID_t faultm_ID);
+void Faultm_enable(faultm_ID_t faultm_ID, int enable_b);
 //void Faultm_clr(faultm_ID_t faultm_ID); // unimplemented
 
 fault_status_reg_t Faultm_get_status(void);
 
+uint8_t Faultm_get_nr_history(void);
+const faultm_frame_t * Faultm_get_history(uint8_t);
+
 
 #endif // FAULTM_H
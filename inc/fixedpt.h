@@ -0,0 +1,57 @@
+/**
+  ******************************************************************************
+  * @file fixedpt.h
+  * @brief Compile-time fixed-point scaling
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef FIXEDPT_H
+#define FIXEDPT_H
+
+/*
+ * Scaling constants are written as integer ratios and Q-format integers so
+ * that no floating-point expression is reachable from a runtime argument
+ * (the STM8 has no FPU, a float expression that is not folded by the compiler
+ * pulls in the software float library).
+ */
+
+/* Includes ------------------------------------------------------------------*/
+
+/* defines -------------------------------------------------------------------*/
+
+#define FXP_CAT_( _A_, _B_ )  _A_##_B_
+#define FXP_CAT( _A_, _B_ )   FXP_CAT_( _A_, _B_ )
+
+/**
+ * @brief Compile-time assertion, at file scope
+ * @details Fails the build with a negative array size if the condition is
+ *  false.
+ */
+#define STATIC_ASSERT( _COND_ ) \
+    typedef char FXP_CAT( static_assert_, __LINE__ )[ (_COND_) ? 1 : -1 ]
+
+/**
+ * @brief Scale by the ratio _NUM_ / _DEN_ (truncated), 32-bit intermediate
+ */
+#define FXP_RATIO( _X_, _NUM_, _DEN_ ) \
+    ( ( (uint32_t)(_X_) * (_NUM_) ) / (_DEN_) )
+
+/**
+ * @brief Q-format constant of the ratio _NUM_ / _DEN_ (truncated)
+ */
+#define FXP_Q( _NUM_, _DEN_, _Q_ ) \
+    FXP_RATIO( (uint32_t)1 << (_Q_), _NUM_, _DEN_ )
+
+/**
+ * @brief Multiply by a Q-format constant (truncated to 16 bits)
+ */
+#define FXP_MUL( _X_, _K_, _Q_ ) \
+    (uint16_t)( ( (uint32_t)(_X_) * (_K_) ) >> (_Q_) )
+
+/* types ---------------------------------------------------------------------*/
+
+/* prototypes ----------------------------------------------------------------*/
+
+#endif // FIXEDPT_H
@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file hall.h
+  * @brief Hall-effect sensor rotor position and speed
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef HALL_H
+#define HALL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Hall state is 3 bits: sensor A (bit 0), B (bit 1), C (bit 2)
+ */
+#define HALL_STATE_MASK      0x07
+
+/**
+ * @brief Sector of an invalid Hall state (000 or 111, sensor fault)
+ */
+#define HALL_SECTOR_INVALID  0xFF
+
+/**
+ * @brief Sensor alignment: sector offset of the Hall state sequence relative
+ *  to the commutation sequence (0:5), rotates the lookup table
+ */
+#define HALL_SECTOR_OFS      0
+
+/**
+ * @brief Timestamp counts per control frame (0.5 us counts, ~1 ms)
+ */
+#define HALL_CT_PER_FRAME    2000
+
+/**
+ * @brief Control frames without an edge until the 16-bit timestamp may have
+ *  wrapped, a longer edge interval is not measured
+ */
+#define HALL_WRAP_FRAMES     30
+
+/**
+ * @brief Control frames without an edge while driving to detect a stalled
+ *  rotor (~0.5 s)
+ */
+#define HALL_STALL_FRAMES    500
+
+/**
+ * @brief Consecutive invalid Hall states to detect a sensor fault
+ */
+#define HALL_INVALID_MAX     4
+
+/**
+ * @brief Sector period reported if not measured (same as stopped motor)
+ */
+#define HALL_PERIOD_MAX      0xFFFF
+
+/* types ---------------------------------------------------------------------*/
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Hall_reset(void);
+
+uint8_t Hall_on_edge(uint8_t hall_state, uint16_t tm);
+uint8_t Hall_on_frame(uint8_t hall_state);
+
+uint8_t Hall_get_sector(void);
+uint16_t Hall_get_period(void);
+uint8_t Hall_get_status(void);
+
+#endif // HALL_H
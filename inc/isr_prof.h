@@ -0,0 +1,79 @@
+/**
+  ******************************************************************************
+  * @file isr_prof.h
+  * @brief ISR latency and execution-time profiling (optional instrumentation)
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef ISR_PROF_H
+#define ISR_PROF_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "mcu_stm8s.h" // MCU_get_timestamp
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Number of bins in each histogram
+ * @details Bin N (N > 0) counts durations in the range (2^(N-1) : 2^N - 1),
+ *  bin 0 counts durations of 0, the last bin counts everything above.
+ */
+#define PROF_NR_BINS  16
+
+/**
+ * @brief Instrumentation macros
+ * @details Placed in the ISR body: ISR_PROF_DECL in the declarations (no
+ *  semicolon), ISR_PROF_START() on entry and ISR_PROF_STOP() on exit.
+ *  Latency is the count of the interrupting timer at entry, i.e. the time since
+ *  the update event. Expand to nothing unless ISR_PROFILE is defined.
+ */
+#if defined( ISR_PROFILE )
+  #define ISR_PROF_DECL                   uint16_t isr_prof_t0;
+  #define ISR_PROF_START( )               isr_prof_t0 = MCU_get_timestamp()
+  #define ISR_PROF_STOP( _ID_ )           Prof_record( (_ID_), MCU_get_timestamp() - isr_prof_t0 )
+  #define ISR_PROF_LATENCY( _ID_, _CT_ )  Prof_record( (_ID_), (_CT_) )
+#else
+  #define ISR_PROF_DECL
+  #define ISR_PROF_START( )
+  #define ISR_PROF_STOP( _ID_ )
+  #define ISR_PROF_LATENCY( _ID_, _CT_ )
+#endif
+
+/* types ---------------------------------------------------------------------*/
+
+/**
+ * @brief Histogram IDs
+ */
+typedef enum
+{
+    PROF_PWM_EXEC = 0,  /**< PWM timer ISR execution (0.5 us) */
+    PROF_PWM_LAT,       /**< PWM timer ISR latency (PWM timer counts) */
+    PROF_COMM_EXEC,     /**< commutation timer ISR execution (0.5 us) */
+    PROF_COMM_LAT,      /**< commutation timer ISR latency (comm. timer counts) */
+    PROF_ADC_EXEC,      /**< ADC EOC ISR execution (0.5 us) */
+    PROF_CS_EXEC,       /**< background task critical section (0.5 us) */
+    PROF_SRV_EXEC,      /**< servo capture ISR execution, DShot frame and reply (0.5 us) */
+    PROF_NR_HIST
+}
+prof_id_t;
+
+/**
+ * @brief Histogram
+ */
+typedef struct
+{
+    uint16_t bins[ PROF_NR_BINS ]; /**< counts, saturating */
+    uint16_t max;                  /**< worst case */
+}
+prof_hist_t;
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Prof_record(prof_id_t, uint16_t);
+void Prof_reset(void);
+void Prof_println(void);
+
+#endif // ISR_PROF_H
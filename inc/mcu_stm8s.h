@@ -23,5 +23,26 @@ void MCU_Init(void);
 
 void MCU_set_comm_timer(uint16_t);
 
+void MCU_adc_select_curr(void);
+void MCU_adc_select_scan(void);
+
+uint16_t MCU_get_comm_timer_count(void);
+void MCU_set_comm_timer_count(uint16_t);
+uint16_t MCU_get_timestamp(void);
+uint8_t MCU_get_hall_state(void);
+
+void MCU_zcp_select(uint8_t, uint8_t);
+void MCU_zcp_disable(void);
+uint16_t MCU_get_zcp_capture(void);
+
+uint8_t MCU_servo_capture_frame(uint16_t *, uint16_t *, uint8_t, uint16_t);
+void MCU_servo_pin_send(uint32_t, uint8_t, uint16_t, uint16_t);
+
+void MCU_wdg_init(void);
+void MCU_wdg_kick(void);
+
+void MCU_eeprom_read(uint16_t, uint8_t *, uint8_t);
+uint8_t MCU_eeprom_write(uint16_t, const uint8_t *, uint8_t);
+
 
 #endif // MCU_STM8S
@@ -11,11 +11,38 @@
 #define MDATA_H
 
 #include "system.h" // platform specific declarations
+#include "pwm_stm8s.h" // PWM_PERIOD_COUNTS
 
 /*
  * defines
  */
 
+/**
+ * @brief Supply voltage (mV) to ADC counts, rounded
+ * @details Vbatt measured on the phase A divider (33k/10k, ADCref 3.3v)
+ *   counts = mV * 10 / 43 / 3300 mV * 1024  ->  ~72.2 counts per volt
+ */
+#define MDATA_VBATT_COUNTS( _MV_ ) \
+  (uint16_t)( ( (uint32_t)(_MV_) * 10 * 1024 + ( 43UL * 3300 / 2 ) ) / ( 43UL * 3300 ) )
+
+/**
+ * @brief Supply voltage at which the timing table was fit (12.4v)
+ * @details 12.4v * 10 / 43 = 2.88v  ->  2.88v / 3.3v * 1024 = 895 counts
+ */
+#define MDATA_VCAL_COUNTS    MDATA_VBATT_COUNTS( 12400 )
+
+/**
+ * @brief Breakpoints of the calibrated open-loop timing curve
+ * @details The commutation period is calibrated (olcal.c) at duty-cycles of
+ *  12.5% to 43.75% in steps of 6.25% of the nominal PWM period, normalized to
+ *  the calibration voltage. The step is a power of 2 of the PWM period so the
+ *  interpolation divide is a shift.
+ */
+#define MDATA_OL_NR_BP       6
+#define MDATA_OL_BP_DC0      ( PWM_PERIOD_COUNTS / 8 )
+#define MDATA_OL_BP_DC_STEP  ( PWM_PERIOD_COUNTS / 16 )
+
+#define MDATA_OL_BP_DC( _N_ )  ( MDATA_OL_BP_DC0 + (_N_) * MDATA_OL_BP_DC_STEP )
 
 
 /*
@@ -30,6 +57,8 @@
  * prototypes
  */
 uint16_t Get_OL_Timing(uint16_t);
+uint16_t Get_OL_Timing_Vcomp(uint16_t, uint16_t);
+uint16_t Get_OL_Dutycycle_Vcomp(uint16_t, uint16_t);
 
 
 #endif // MDATA_H
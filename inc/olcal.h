@@ -0,0 +1,46 @@
+/**
+  ******************************************************************************
+  * @file olcal.h
+  * @brief Calibration of the open-loop commutation timing
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef OLCAL_H
+#define OLCAL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "mdata.h" // MDATA_OL_NR_BP
+
+/* defines -------------------------------------------------------------------*/
+
+/* types ---------------------------------------------------------------------*/
+
+/**
+ * @brief Calibration status
+ */
+typedef enum
+{
+    OLCAL_IDLE = 0,
+    OLCAL_PENDING,  /**< requested, starts when the motor is in open-loop */
+    OLCAL_RUN,      /**< sweep in progress */
+    OLCAL_DONE,     /**< breakpoints available to Olcal_apply */
+    OLCAL_FAILED    /**< timed out or aborted, no result */
+}
+olcal_status_t;
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Olcal_start(void);
+void Olcal_abort(void);
+
+uint8_t Olcal_update(uint16_t * pdutycycle, uint16_t * pcomm_period,
+                     int16_t timing_err, uint16_t vbatt);
+
+olcal_status_t Olcal_get_status(void);
+const uint16_t * Olcal_get_breakpoints(void);
+void Olcal_apply(void);
+
+#endif // OLCAL_H
@@ -18,7 +18,7 @@
 
 /* Public function prototypes -----------------------------------------------*/
 
-void Periodic_Task_Wake(void);
+void Periodic_Task(void);
 
 uint8_t Task_Ready(void);
 
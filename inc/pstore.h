@@ -0,0 +1,69 @@
+/**
+  ******************************************************************************
+  * @file pstore.h
+  * @brief Persistent parameter store (data EEPROM)
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef PSTORE_H
+#define PSTORE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "mdata.h" // MDATA_OL_NR_BP
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Version of the parameter block layout
+ * @details Must be incremented when pstore_params_t is changed, a record of a
+ *  different version is not loaded (defaults are used).
+ */
+#define PSTORE_VERSION      3
+
+/**
+ * @brief Wear-levelling slots, each holds one complete record
+ * @details 4 slots of 32 bytes fit the 128 byte data EEPROM of the S003.
+ */
+#define PSTORE_NR_SLOTS     4
+#define PSTORE_REC_SIZE     32
+#define PSTORE_EEPROM_OFFS  0   // offset of the first slot in data EEPROM
+
+/**
+ * @brief Return status of Pstore_save
+ */
+#define PSTORE_OK           0
+#define PSTORE_ERR_WRITE    1  // EEPROM write or read-back verify failed
+
+/* types ---------------------------------------------------------------------*/
+
+/**
+ * @brief Tuning parameters
+ */
+typedef struct
+{
+    uint16_t pd_align;    /**< alignment duty-cycle, PWM counts */
+    uint16_t pd_rampup;   /**< duty-cycle of the open-loop ramp, PWM counts */
+    uint16_t pd_startup;  /**< ramp-to duty-cycle (end of ramp), PWM counts */
+    uint16_t time_align;  /**< length of alignment, control frames */
+    uint16_t v_shutdown;  /**< undervoltage fault threshold, ADC counts */
+    uint16_t ol_bp[ MDATA_OL_NR_BP ]; /**< calibrated open-loop timing, 0 if none */
+    uint16_t thr_lo;      /**< servo zero throttle pulse, capture timer counts */
+    uint16_t thr_hi;      /**< servo full throttle pulse, capture timer counts */
+}
+pstore_params_t;
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Pstore_init(void);
+
+const pstore_params_t * Pstore_get(void);
+void Pstore_set(const pstore_params_t *);
+void Pstore_set_defaults(void);
+
+uint8_t Pstore_save(void);
+uint8_t Pstore_is_loaded(void);
+
+#endif // PSTORE_H
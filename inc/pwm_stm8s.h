@@ -15,6 +15,7 @@
 // stm8s header is provided by the tool chain and is needed for typedefs of uint etc.
 #include <stm8s.h>
 #include "system.h" // system/build configuration
+#include "fixedpt.h"
 
 /* Public defines -----------------------------------------------------------*/
 
@@ -39,18 +40,52 @@
 
 #ifdef PWM_8K
   #define PWM_PERIOD_COUNTS   250 // 1/16 Mhz * PS * 2500 = 0.000125 sec
+  #define PWM_TIMER_PS          8
 #else // 
   #define PWM_PERIOD_COUNTS  1024
+  #define PWM_TIMER_PS          2
 #endif
 
+/*
+ * Nominal PWM period in timestamp counts (0.5 us i.e. 16 Mhz / 8)
+ */
+#define PWM_TS_PS             8
+#define PWM_PERIOD_TS_COUNTS  ( PWM_PERIOD_COUNTS * PWM_TIMER_PS / PWM_TS_PS )
+
+/**
+ * @brief PWM period bands selectable at run-time
+ * @details At low motor speed the PWM period is halved (doubled PWM frequency)
+ *  to reduce current ripple. At high speed the nominal period reduces switching
+ *  loss and allows more ADC samples per sector.
+ *  The duty-cycle is always expressed in counts of the nominal period i.e.
+ *  (0:PWM_PERIOD_COUNTS) and is rescaled by the PWM module to the active period.
+ */
+#define PWM_BAND_NOMINAL   0  // PWM_PERIOD_COUNTS
+#define PWM_BAND_HI_FREQ   1  // PWM_PERIOD_COUNTS / 2
+
+/*
+ * Band switching is by commutation period (i.e. slower speed is greater period)
+ * with hysteresis. Thresholds are set above the ramp-to speed so that the
+ * switch back to the nominal period happens early in the open-loop range.
+ */
+#define PWM_BAND_HF_ENTER_CT  0x0800 // commutation period > thr -> high freq.
+#define PWM_BAND_HF_EXIT_CT   0x0700 // commutation period < thr -> nominal
+
+/**
+ * @brief Number of PWM update events per system tick at the nominal period
+ * @details The system tick is derived from the PWM timer so the divider is
+ *  scaled with the PWM frequency to keep the tick rate constant.
+ */
+#define PWM_NOMINAL_FRAMES_PER_TICK  1
+
 
 /**
  * @brief Compute PWM timer counts from percent duty-cycle
- * @param Percent duty-cycle, range (0:100.0)
+ * @param Duty-cycle in 0.1 % units, range (0:1000)
  * @return PWM timer counts 
  */
-#define PWM_GET_PULSE_COUNTS( _PCNT_ ) \
-    (uint16_t)( ( _PCNT_ * (PWM_PERIOD_COUNTS / 4.0) ) / (100.0 / 4.0) )
+#define PWM_GET_PULSE_COUNTS( _PCNT_X10_ ) \
+    (uint16_t)FXP_RATIO( _PCNT_X10_, PWM_PERIOD_COUNTS, 1000 )
 
 
 /*
@@ -80,9 +115,9 @@
  *  Full Stick: 1940s
  */
 
-#define TCC_TICK_TIME_MSEC   (0.5)
-#define TCC_TIME_ARMING      (uint16_t)(1100.0 * (1.0 / TCC_TICK_TIME_MSEC))
-#define TCC_TIME_MAX_THRUST  (uint16_t)(1900.0 * (1.0 / TCC_TICK_TIME_MSEC))
+#define TCC_CT_PER_US        2 // 0.5 us per tick
+#define TCC_TIME_ARMING      (uint16_t)(1100 * TCC_CT_PER_US)
+#define TCC_TIME_MAX_THRUST  (uint16_t)(1900 * TCC_CT_PER_US)
 
 /*
  * With throttle proportional to pulse width, and the motor speed range (0%:100%)
@@ -105,16 +140,18 @@
 /**
  * @brief integer scale factor for pwm percent
  * @details speed percent is not used for setting PWM but rather for 
- *  calculations involving percent motor speed (0.5%/bit precision)
- * e.g. 
- *  %DC = (PWM_DC_SCALE * PWM_PULSE_CNT) / PWM_PULSE_100_PCNT
+ *  calculations involving percent motor speed. The scale is Q16 percent per
+ *  servo position count, precomputed for the throttle range (which is
+ *  calibrated, see rccal.c) i.e.
  *
- * As u16, and using 1600 for 100% pulse time (period)
- *   65535 / 1600 = 40 
+ *   100 * 2^16 / SERVO_RANGE
  *
- * Therefore use p-o-2 scale of 2^5
+ * As u16 the range must be at least 100 counts (50 us).
+ *
+ * @param  _RANGE_  servo throttle range, timer counts
  */
-#define PWM_MSPEED_PCNT_SCALE  2.0
+#define PWM_MSPEED_SCALE( _RANGE_ )  \
+  (uint16_t)FXP_Q( 100, _RANGE_, 16 )
 
 /**
  * @brief convert raw servo position counts to integer percent
@@ -122,14 +159,11 @@
  * @details 
  *   100% * SERVO_POSN / SERVO_RANGE
  *
- *  factor of 2 is factored out of num. and denomnator terms to avoid overflow of 16-bits
- *
- *
- * @param  SERVO_POSITION_COUNTS, range (0:3600)
- * 
+ * @param  _SERVO_POSITION_COUNTS_  range (0:SERVO_RANGE)
+ * @param  _SCALE_  PWM_MSPEED_SCALE of the throttle range
  */
-#define PWM_MSPEED_PERCENT( _SERVO_POSITION_COUNTS_ )  \
-  ( (100.0 / 2 ) * ( _SERVO_POSITION_COUNTS_ ) / ( TCC_THRTTLE_RANGE / 2 ) )
+#define PWM_MSPEED_PERCENT( _SERVO_POSITION_COUNTS_, _SCALE_ )  \
+  FXP_MUL( _SERVO_POSITION_COUNTS_, _SCALE_, 16 )
 
 /**
  * The MCU drives 3 GPIO as output to IR2104 /SD pins. There is no significance 
@@ -194,15 +228,15 @@
 
 // PD4 set LO
 #define PWM_PhA_OUTP_LO( )                              \
-    SDc_PWM_PORT->ODR &= (uint8_t) ( ~SDa_PWM_PIN );    \
-    SDc_PWM_PORT->DDR |=  SDa_PWM_PIN;                   \
-    SDc_PWM_PORT->CR1 |=  SDa_PWM_PIN;
+    SDa_PWM_PORT->ODR &= (uint8_t) ( ~SDa_PWM_PIN );    \
+    SDa_PWM_PORT->DDR |=  SDa_PWM_PIN;                   \
+    SDa_PWM_PORT->CR1 |=  SDa_PWM_PIN;
 
 // PD3 set LO
 #define PWM_PhB_OUTP_LO( )                              \
-    SDc_PWM_PORT->ODR &= (uint8_t) ( ~SDb_PWM_PIN );    \
-    SDc_PWM_PORT->DDR |=  SDb_PWM_PIN;                   \
-    SDc_PWM_PORT->CR1 |=  SDb_PWM_PIN;
+    SDb_PWM_PORT->ODR &= (uint8_t) ( ~SDb_PWM_PIN );    \
+    SDb_PWM_PORT->DDR |=  SDb_PWM_PIN;                   \
+    SDb_PWM_PORT->CR1 |=  SDb_PWM_PIN;
 
 // PA3 set LO
 #define PWM_PhC_OUTP_LO( )                              \
@@ -237,18 +271,160 @@
     SDc_SD_PORT->ODR &=  (uint8_t) ( ~SDc_SD_PIN );
 
 
+/**
+ * Register-level mapping of the phase PWM channels to the timer: capture/
+ * compare enable register and bit (CCxE), and compare register (CCRxH/L).
+ * Polarity and complementary output bits are configured once by PWM_setup()
+ * and are not touched by commutation.
+ */
+#if defined( S105_DISCOVERY ) || defined( S003_DEV )
+  #define PWM_TIMER  TIM2
+
+  #define PWM_PhA_CCER   CCER1  // CH1
+  #define PWM_PhA_CCxE   TIM2_CCER1_CC1E
+  #define PWM_PhA_CCRH   CCR1H
+  #define PWM_PhA_CCRL   CCR1L
+
+  #define PWM_PhB_CCER   CCER1  // CH2
+  #define PWM_PhB_CCxE   TIM2_CCER1_CC2E
+  #define PWM_PhB_CCRH   CCR2H
+  #define PWM_PhB_CCRL   CCR2L
+
+  #define PWM_PhC_CCER   CCER2  // CH3
+  #define PWM_PhC_CCxE   TIM2_CCER2_CC3E
+  #define PWM_PhC_CCRH   CCR3H
+  #define PWM_PhC_CCRL   CCR3L
+
+  // enable bits by register, for the commutation sector images
+  #define PWM_PhA_CCER1_EN  PWM_PhA_CCxE
+  #define PWM_PhA_CCER2_EN  0
+  #define PWM_PhB_CCER1_EN  PWM_PhB_CCxE
+  #define PWM_PhB_CCER2_EN  0
+  #define PWM_PhC_CCER1_EN  0
+  #define PWM_PhC_CCER2_EN  PWM_PhC_CCxE
+
+#elif defined( S105_DEV )
+  #define PWM_TIMER  TIM1
+
+  #define PWM_PhA_CCER   CCER1  // CH2
+  #define PWM_PhA_CCxE   TIM1_CCER1_CC2E
+  #define PWM_PhA_CCRH   CCR2H
+  #define PWM_PhA_CCRL   CCR2L
+
+  #define PWM_PhB_CCER   CCER2  // CH3
+  #define PWM_PhB_CCxE   TIM1_CCER2_CC3E
+  #define PWM_PhB_CCRH   CCR3H
+  #define PWM_PhB_CCRL   CCR3L
+
+  #define PWM_PhC_CCER   CCER2  // CH4
+  #define PWM_PhC_CCxE   TIM1_CCER2_CC4E
+  #define PWM_PhC_CCRH   CCR4H
+  #define PWM_PhC_CCRL   CCR4L
+
+  // enable bits by register, for the commutation sector images
+  #define PWM_PhA_CCER1_EN  PWM_PhA_CCxE
+  #define PWM_PhA_CCER2_EN  0
+  #define PWM_PhB_CCER1_EN  0
+  #define PWM_PhB_CCER2_EN  PWM_PhB_CCxE
+  #define PWM_PhC_CCER1_EN  0
+  #define PWM_PhC_CCER2_EN  PWM_PhC_CCxE
+#endif
+
+/**
+ * Phase PWM channel output enable/disable (register-direct, replaces the SPL
+ * TIMx_CCxCmd). Each is a single bit set/clear of a constant address.
+ */
+#define PWM_PhA_CC_ENABLE( ) \
+    PWM_TIMER->PWM_PhA_CCER |=  PWM_PhA_CCxE;
+
+#define PWM_PhB_CC_ENABLE( ) \
+    PWM_TIMER->PWM_PhB_CCER |=  PWM_PhB_CCxE;
+
+#define PWM_PhC_CC_ENABLE( ) \
+    PWM_TIMER->PWM_PhC_CCER |=  PWM_PhC_CCxE;
+
+#define PWM_PhA_CC_DISABLE( ) \
+    PWM_TIMER->PWM_PhA_CCER &=  (uint8_t) ( ~PWM_PhA_CCxE );
+
+#define PWM_PhB_CC_DISABLE( ) \
+    PWM_TIMER->PWM_PhB_CCER &=  (uint8_t) ( ~PWM_PhB_CCxE );
+
+#define PWM_PhC_CC_DISABLE( ) \
+    PWM_TIMER->PWM_PhC_CCER &=  (uint8_t) ( ~PWM_PhC_CCxE );
+
+/**
+ * Phase PWM compare load (register-direct, replaces the SPL TIMx_SetCompareN).
+ * High byte must be written first (RM0016).
+ */
+#define PWM_PhA_CC_LOAD( _DC_ )                            \
+    PWM_TIMER->PWM_PhA_CCRH = (uint8_t)( (_DC_) >> 8 );    \
+    PWM_TIMER->PWM_PhA_CCRL = (uint8_t)( _DC_ );
+
+#define PWM_PhB_CC_LOAD( _DC_ )                            \
+    PWM_TIMER->PWM_PhB_CCRH = (uint8_t)( (_DC_) >> 8 );    \
+    PWM_TIMER->PWM_PhB_CCRL = (uint8_t)( _DC_ );
+
+#define PWM_PhC_CC_LOAD( _DC_ )                            \
+    PWM_TIMER->PWM_PhC_CCRH = (uint8_t)( (_DC_) >> 8 );    \
+    PWM_TIMER->PWM_PhC_CCRL = (uint8_t)( _DC_ );
+
+#define PWM_CCER1_EN_MASK \
+    ( PWM_PhA_CCER1_EN | PWM_PhB_CCER1_EN | PWM_PhC_CCER1_EN )
+
+#define PWM_CCER2_EN_MASK \
+    ( PWM_PhA_CCER2_EN | PWM_PhB_CCER2_EN | PWM_PhC_CCER2_EN )
+
+/**
+ * @brief Load a commutation sector image to the PWM timer and /SD outputs
+ *
+ * @details Only the masked bits are modified, so each register is a single
+ *  read-modify-write with a precomputed value. The timer channels are loaded
+ *  first so that the outgoing PWM phase is turned off before its half-bridge
+ *  is disabled (same order as the original step handlers).
+ *
+ * @param _PIMG_  Pointer to PWM_sector_image_t
+ */
+#define PWM_SECTOR_IMAGE_LOAD( _PIMG_ )                                       \
+    PWM_TIMER->CCER1 =                                                        \
+      (uint8_t)( ( PWM_TIMER->CCER1 & (uint8_t)~PWM_CCER1_EN_MASK ) | (_PIMG_)->ccer1 ); \
+    PWM_TIMER->CCER2 =                                                        \
+      (uint8_t)( ( PWM_TIMER->CCER2 & (uint8_t)~PWM_CCER2_EN_MASK ) | (_PIMG_)->ccer2 ); \
+    SDa_SD_PORT->ODR =                                                        \
+      (uint8_t)( ( SDa_SD_PORT->ODR & (uint8_t)~SDa_SD_PIN ) | (_PIMG_)->sd_a );  \
+    SDb_SD_PORT->ODR =                                                        \
+      (uint8_t)( ( SDb_SD_PORT->ODR & (uint8_t)~SDb_SD_PIN ) | (_PIMG_)->sd_b );  \
+    SDc_SD_PORT->ODR =                                                        \
+      (uint8_t)( ( SDc_SD_PORT->ODR & (uint8_t)~SDc_SD_PIN ) | (_PIMG_)->sd_c );
+
+
 /* Public types -------------------------------------------------------------*/
 /**
  * @brief  Generic PWM channel type.
  */
 typedef  TIM2_Channel_TypeDef PWM_Channel_Typedef ;
 
+/**
+ * @brief  Register image of one commutation sector
+ * @details Precomputed timer output enable (CCxE) bits and /SD output levels,
+ *  see PWM_SECTOR_IMAGE_LOAD().
+ */
+typedef struct
+{
+    uint8_t ccer1;  /**< CCxE bits of CCER1 (PWM_CCER1_EN_MASK) */
+    uint8_t ccer2;  /**< CCxE bits of CCER2 (PWM_CCER2_EN_MASK) */
+    uint8_t sd_a;   /**< phase A /SD port ODR bit (SDa_SD_PIN or 0) */
+    uint8_t sd_b;   /**< phase B /SD port ODR bit (SDb_SD_PIN or 0) */
+    uint8_t sd_c;   /**< phase C /SD port ODR bit (SDc_SD_PIN or 0) */
+}
+PWM_sector_image_t;
+
 
 /* Public variables ---------------------------------------------------------*/
 
 /* Public function prototypes -----------------------------------------------*/
 
 void All_phase_stop(void);
+void All_phase_brake(void);
 
 void PWM_PhA_Disable(void);
 void PWM_PhB_Disable(void);
@@ -259,9 +435,16 @@ void PWM_PhB_Enable(void);
 void PWM_PhC_Enable(void);
 
 void PWM_set_dutycycle(uint16_t);
+void PWM_set_dc_trim(uint16_t);
+
+void PWM_set_band(uint16_t);
+void PWM_on_update(void);
+uint8_t PWM_get_frames_per_tick(void);
+uint16_t PWM_get_counter(void);
 
 void PWM_setup(void);
 
+void PWM_set_servo_range(uint16_t, uint16_t);
 uint16_t PWM_get_motor_spd_pcnt(uint16_t, uint16_t);
 uint16_t PWM_get_servo_position_counts( uint16_t );
 
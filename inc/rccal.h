@@ -0,0 +1,69 @@
+/**
+  ******************************************************************************
+  * @file rccal.h
+  * @brief RC throttle range calibration
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef RCCAL_H
+#define RCCAL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "rcin.h" // rcin_protocol_t
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Control frames (~1 ms) after power-up to enter the calibration
+ */
+#define RCCAL_START_FRAMES   2000
+
+/**
+ * @brief Stick position is measured as the average over 2^RCCAL_AVG_SH
+ *  control frames (~1 s) with the pulse stable within RCCAL_TOL
+ */
+#define RCCAL_AVG_SH         10
+#define RCCAL_TOL            ( 10 * RCIN_CT_PER_US )
+
+/**
+ * @brief Full stick (enters the calibration) and low stick thresholds, timer
+ *  counts, the range is at least 400 us
+ */
+#define RCCAL_HI_MIN         ( 1700 * RCIN_CT_PER_US )
+#define RCCAL_LO_MAX         ( 1300 * RCIN_CT_PER_US )
+
+/**
+ * @brief Control frames to complete the calibration (~20 s)
+ */
+#define RCCAL_TIMEOUT_FRAMES 20000
+
+/* types ---------------------------------------------------------------------*/
+
+/**
+ * @brief Calibration status
+ */
+typedef enum
+{
+    RCCAL_IDLE = 0,  /**< power-up, waiting for full stick */
+    RCCAL_HI,        /**< measuring full stick */
+    RCCAL_LO,        /**< waiting for and measuring low stick */
+    RCCAL_DONE,      /**< range available to Rccal_apply */
+    RCCAL_FAILED,    /**< timeout or signal lost, the throttle is held at 0 */
+    RCCAL_OFF        /**< not entered at power-up, or applied */
+}
+rccal_status_t;
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Rccal_init(void);
+
+uint8_t Rccal_update(rcin_protocol_t protocol, uint16_t pulse_dur);
+
+rccal_status_t Rccal_get_status(void);
+void Rccal_get_range(uint16_t * plo, uint16_t * phi);
+void Rccal_apply(void);
+
+#endif // RCCAL_H
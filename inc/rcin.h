@@ -0,0 +1,64 @@
+/**
+  ******************************************************************************
+  * @file rcin.h
+  * @brief RC throttle pulse input, protocol detection and scaling
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef RCIN_H
+#define RCIN_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Servo capture timer counts per microsecond (0.5 us)
+ */
+#define RCIN_CT_PER_US     2
+
+/**
+ * @brief Consecutive pulses of one protocol to lock the protocol
+ */
+#define RCIN_DETECT_CT     8
+
+/**
+ * @brief Control frames (~1 ms) without a plausible pulse to signal loss
+ * @details 5 pulses of the slowest (50 Hz) servo signal.
+ */
+#define RCIN_LOSS_FRAMES   100
+
+/* types ---------------------------------------------------------------------*/
+
+/**
+ * @brief Throttle pulse protocols, in order of the descriptor table (rcin.c)
+ */
+typedef enum
+{
+    RCIN_NONE = 0,     /**< not (yet) detected */
+    RCIN_PWM,          /**< standard servo pulse 1100-1900 us, 50-400 Hz */
+    RCIN_ONESHOT125,   /**< 125-250 us, up to 4 kHz */
+    RCIN_ONESHOT42,    /**< 42-84 us, up to 12 kHz */
+    RCIN_MULTISHOT,    /**< 5-25 us, up to 32 kHz */
+    RCIN_NR_PROTOCOLS
+}
+rcin_protocol_t;
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Rcin_reset(void);
+void Rcin_set_range(uint16_t lo, uint16_t hi);
+
+void Rcin_on_pulse(uint16_t pulse_dur, uint16_t pulse_perd);
+void Rcin_on_frame(void);
+
+uint8_t Rcin_get_throttle(uint16_t * pthrottle);
+rcin_protocol_t Rcin_get_protocol(void);
+uint16_t Rcin_get_errors(void);
+uint8_t Rcin_get_loss(void);
+uint16_t Rcin_get_pulse_dur(void);
+
+#endif // RCIN_H
@@ -0,0 +1,78 @@
+/**
+  ******************************************************************************
+  * @file sched.h
+  * @brief Table-driven cooperative task scheduler
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef SCHED_H
+#define SCHED_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "pwm_stm8s.h"
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Task execution context
+ */
+#define SCHED_CTX_ISR  0  // run from the tick, in the PWM timer ISR
+#define SCHED_CTX_BG   1  // flagged by the tick, run from the background loop
+
+/**
+ * @brief Length of the system tick in timestamp counts (0.5 us)
+ * @details One nominal PWM period i.e. 1024 counts @ 8 Mhz -> 128 us, or 250
+ *  counts @ 2 Mhz (PWM_8K) -> 125 us. In the high frequency band the tick is
+ *  two PWM periods, so its length does not depend on the band.
+ */
+#define SCHED_TICK_TS_COUNTS \
+  ( PWM_NOMINAL_FRAMES_PER_TICK * PWM_PERIOD_TS_COUNTS )
+
+/* types ---------------------------------------------------------------------*/
+
+/**
+ * @brief Data type for the task function.
+ */
+typedef void (*sched_task_fp_t)( void );
+
+/**
+ * @brief Data type for the task table.
+ */
+typedef struct
+{
+    uint8_t period;          /**< period in system ticks */
+    uint8_t phase;           /**< tick offset within the period, < period */
+    uint8_t context;         /**< SCHED_CTX_ISR or SCHED_CTX_BG */
+    sched_task_fp_t ptask;   /**< pointer to task function */
+}
+sched_task_t;
+
+/**
+ * @brief Task statistics.
+ * @details Execution time is in timestamp counts (0.5 us). A deadline miss is
+ *  counted if a task runs longer than its period, or if a background task is
+ *  still pending when it is due again.
+ */
+typedef struct
+{
+    uint16_t runs;       /**< number of activations (wraps) */
+    uint16_t misses;     /**< deadline misses (saturates) */
+    uint16_t exec_last;  /**< execution time of latest activation */
+    uint16_t exec_max;   /**< greatest execution time */
+}
+sched_stats_t;
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Sched_init(void);
+void Sched_on_PWM_frame(void);
+void Sched_set_hold(uint8_t);
+uint8_t Sched_run_background(void);
+
+uint8_t Sched_get_nr_tasks(void);
+const sched_stats_t * Sched_get_stats(uint8_t);
+
+#endif // SCHED_H
@@ -26,7 +26,9 @@ uint16_t Seq_Get_bemfF(void);
 uint16_t Seq_Get_Vbatt(void);
 int16_t Seq_get_timing_error(void);
 int8_t Seq_get_timing_error_p(void);
+int16_t Seq_get_zcp_error(void);
 void Sequence_Step(void);
+void Sequence_Set_Sector(uint8_t sector);
 
 void Sequence_Step_0(void);
 void Sequence_Step_1(void);
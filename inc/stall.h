@@ -0,0 +1,29 @@
+/**
+  ******************************************************************************
+  * @file stall.h
+  * @brief Stall and blocked-rotor detection
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef STALL_H
+#define STALL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* defines -------------------------------------------------------------------*/
+
+/* types ---------------------------------------------------------------------*/
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Stall_reset(void);
+void Stall_arm(void);
+
+void Stall_on_sector(uint16_t bemf_dv, uint16_t dt, int16_t zcp_err);
+
+uint8_t Stall_get_status(void);
+
+#endif // STALL_H
@@ -0,0 +1,50 @@
+/**
+  ******************************************************************************
+  * @file superv.h
+  * @brief Run-time supervisor - ISR overrun and background starvation, watchdog
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef SUPERV_H
+#define SUPERV_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Maximum commutation timer events per control frame (~1 ms)
+ * @details The commutation timer runs at 4x the sector rate, 100k eRPM is
+ *  10k sectors/s i.e. 40 events per ms. A shorter period is the runaway of the
+ *  commutation timing.
+ */
+#define SUPERV_COMM_ISR_MAX        64
+
+/**
+ * @brief Control frames without a pass of the background loop (~200 ms)
+ * @details Allows for the blocking printf of the background task.
+ */
+#define SUPERV_BG_TIMEOUT_FRAMES  200
+
+/**
+ * @brief Supervisor status bits
+ */
+#define SUPERV_ISR_OVERRUN  0x01
+#define SUPERV_BG_STARVED   0x02
+
+/* types ---------------------------------------------------------------------*/
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Superv_init(void);
+
+void Superv_on_comm_isr(void);
+void Superv_on_control_frame(void);
+void Superv_on_background(void);
+
+uint8_t Superv_get_status(void);
+
+#endif // SUPERV_H
@@ -15,11 +15,9 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
-// horrors of unit testing
-#ifndef UNIT_TEST
 // stm8s header is provided by the tool chain and is needed for typedefs of uint etc.
+// horrors of unit testing ... host build gets the stand-in from stm_mcp_utest/inc
 #include <stm8s.h>
-#endif // UNIT_TEST
 
 
 // List of supported SPI configurations
@@ -51,16 +49,40 @@
   #define PH0_BEMF_IN_PORT   GPIOB
   #define PH0_BEMF_IN_PIN    GPIO_PIN_0
 
+// AIN1, B1 and AIN2, B2 (phase B and C dividers)
+  #define PH1_BEMF_IN_PORT   GPIOB
+  #define PH1_BEMF_IN_PIN    GPIO_PIN_1
+  #define PH2_BEMF_IN_PORT   GPIOB
+  #define PH2_BEMF_IN_PIN    GPIO_PIN_2
+
   #define LED_GPIO_PORT      GPIOE
   #define LED_GPIO_PIN       GPIO_PIN_5
 
   #define SERVO_GPIO_PORT    GPIOD
   #define SERVO_GPIO_PIN     GPIO_PIN_4
 
+// AIN4, B4 current-sense amplifier
+  #define CURR_SENSE_IN_PORT GPIOB
+  #define CURR_SENSE_IN_PIN  GPIO_PIN_4
+
+// B5, B6, B7 Hall-effect sensors A, B, C (AIN5-7 unused), EXTI port B
+  #define HALL_GPIO_PORT     GPIOB
+  #define HALL_GPIO_SH       5
+  #define HALL_EXTI_PORT     EXTI_PORT_GPIOB
+
+// A3 (TIM2 CH3) back-EMF comparator output, A2 and D7 comparator mux select
+  #define CMP_SEL0_PORT      GPIOA
+  #define CMP_SEL0_PIN       GPIO_PIN_2
+  #define CMP_SEL1_PORT      GPIOD
+  #define CMP_SEL1_PIN       GPIO_PIN_7
+
   #define HAS_SERVO_INPUT
+  #define HAS_CURRENT_SENSE
   #define SPI_ENABLED        SPI_STM8_MASTER
 
   #define UNDERVOLTAGE_FAULT_ENABLED
+  #define OVERCURRENT_FAULT_ENABLED
+  #define STALL_FAULT_ENABLED
 
 #elif defined ( S105_DISCOVERY )
 /*
@@ -76,16 +98,40 @@
   #define PH0_BEMF_IN_PORT   GPIOB
   #define PH0_BEMF_IN_PIN    GPIO_PIN_0
 
+// AIN1, B1 and AIN2, B2 (phase B and C dividers)
+  #define PH1_BEMF_IN_PORT   GPIOB
+  #define PH1_BEMF_IN_PIN    GPIO_PIN_1
+  #define PH2_BEMF_IN_PORT   GPIOB
+  #define PH2_BEMF_IN_PIN    GPIO_PIN_2
+
   #define LED_GPIO_PORT      GPIOD
   #define LED_GPIO_PIN       GPIO_PIN_0
 
   #define SERVO_GPIO_PORT    GPIOC
   #define SERVO_GPIO_PIN     GPIO_PIN_4
 
+// AIN4, B4 current-sense amplifier
+  #define CURR_SENSE_IN_PORT GPIOB
+  #define CURR_SENSE_IN_PIN  GPIO_PIN_4
+
+// B5, B6, B7 Hall-effect sensors A, B, C (AIN5-7 unused), EXTI port B
+  #define HALL_GPIO_PORT     GPIOB
+  #define HALL_GPIO_SH       5
+  #define HALL_EXTI_PORT     EXTI_PORT_GPIOB
+
+// C1 (TIM1 CH1) back-EMF comparator output, E6 and E7 comparator mux select
+  #define CMP_SEL0_PORT      GPIOE
+  #define CMP_SEL0_PIN       GPIO_PIN_6
+  #define CMP_SEL1_PORT      GPIOE
+  #define CMP_SEL1_PIN       GPIO_PIN_7
+
   #define SPI_ENABLED        SPI_STM8_MASTER
   #define HAS_SERVO_INPUT
+  #define HAS_CURRENT_SENSE
 
   #define UNDERVOLTAGE_FAULT_ENABLED
+  #define OVERCURRENT_FAULT_ENABLED
+  #define STALL_FAULT_ENABLED
 
 #elif defined ( S003_DEV )
 /*
@@ -119,6 +165,46 @@
 #define SPI_RX_BUF_SZ  16 // 256 // tmp
 
 
+/*
+ * (un)comment macro to enable ISR latency/execution-time histograms (isr_prof.c)
+ */
+//#define ISR_PROFILE
+
+/*
+ * (un)comment macro to decode DShot150/300 (dshot.c) on the servo capture input
+ * in place of the servo pulse, boards with HAS_SERVO_INPUT only
+ */
+//#define DSHOT_INPUT
+
+/*
+ * (un)comment macro for bidirectional DShot (inverted input), the eRPM
+ * telemetry (telem.c) is returned on the same pin, DSHOT_INPUT only
+ */
+//#define DSHOT_TELEM
+
+/*
+ * (un)comment macro to commutate from Hall-effect sensors (hall.c) in place of
+ * the open-loop ramp and back-EMF timing, boards with HALL_GPIO_PORT only
+ */
+//#define HALL_SENSOR
+
+#if defined( HALL_SENSOR ) && !defined( HALL_GPIO_PORT )
+#error "HALL_SENSOR: no Hall sensor inputs on this board"
+#endif
+
+/*
+ * (un)comment macro to time the commutation from an external back-EMF
+ * comparator (zcp.c): the comparator of the floating phase (against the
+ * neutral) is selected through an analog mux and captured on a spare channel
+ * of the timestamp timer, boards with CMP_SEL0_PORT only
+ */
+//#define BEMF_COMPARATOR
+
+#if defined( BEMF_COMPARATOR ) && \
+    ( !defined( CMP_SEL0_PORT ) || !defined( HAS_SERVO_INPUT ) || defined( HALL_SENSOR ) )
+#error "BEMF_COMPARATOR: no comparator capture on this board, or HALL_SENSOR"
+#endif
+
 /*
  * (un)comment macro to set stm8 clock from 8Mhz or 16Mhz
  */
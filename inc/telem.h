@@ -0,0 +1,48 @@
+/**
+  ******************************************************************************
+  * @file telem.h
+  * @brief eRPM telemetry encoder (bidirectional DShot)
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef TELEM_H
+#define TELEM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Reply word: start bit and 20 GCR bits
+ */
+#define TELEM_NR_BITS        21
+
+/**
+ * @brief Reply is sent after a gap following the throttle frame, timestamp
+ *  counts (0.5 us)
+ */
+#define TELEM_GAP_T          ( 30 * 2 )
+
+/**
+ * @brief Reply bit period at 5/4 of the DShot bit rate, timestamp counts Q4
+ */
+#define TELEM_BIT_T_Q4_150   171 // 5.33 us
+#define TELEM_BIT_T_Q4_300   85  // 2.67 us
+
+/**
+ * @brief Longest encoded electrical period (us), reported for a stopped motor
+ */
+#define TELEM_EPERIOD_MAX    0xFF80 // 511 << 7
+
+/* types ---------------------------------------------------------------------*/
+
+/* prototypes ----------------------------------------------------------------*/
+
+uint16_t Telem_eperiod_us(uint16_t comm_period);
+uint16_t Telem_frame(uint16_t eperiod_us);
+uint32_t Telem_gcr(uint16_t frame);
+
+#endif // TELEM_H
@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file thr_shape.h
+  * @brief Throttle shaping - deadband, expo curve and slew-rate limit
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef THR_SHAPE_H
+#define THR_SHAPE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "pwm_stm8s.h" // PWM_PERIOD_COUNTS
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Throttle input/output full scale (motor speed in PWM counts)
+ */
+#define THR_FULL_SCALE  PWM_PERIOD_COUNTS
+
+/**
+ * @brief Fixed-point format of the normalized throttle (Q10 i.e. 1.0 == 1024)
+ */
+#define THR_Q_SH    10
+#define THR_Q_ONE   ( 1 << THR_Q_SH )
+
+/**
+ * @brief Number of points in the throttle curve, evenly spaced over (0:1.0)
+ * @details Segment count must be a power of 2 (segment index is a shift).
+ */
+#define THR_CURVE_SEG_SH  3
+#define THR_CURVE_NPTS    ( ( 1 << THR_CURVE_SEG_SH ) + 1 )
+
+/* types ---------------------------------------------------------------------*/
+
+/**
+ * @brief Throttle shaping configuration
+ */
+typedef struct
+{
+    uint16_t deadband;        /**< input below deadband is zero throttle (counts) */
+    uint16_t slew_up;         /**< max output increase per control frame (counts) */
+    uint16_t slew_dn;         /**< max output decrease per control frame (counts) */
+    const uint16_t * pcurve;  /**< curve table, THR_CURVE_NPTS points (Q10) */
+}
+thr_shape_cfg_t;
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Thr_shape_init(void);
+void Thr_shape_config(const thr_shape_cfg_t *);
+void Thr_shape_reset(void);
+
+void Thr_shape_set_input(uint16_t);
+uint16_t Thr_shape_update(void);
+uint16_t Thr_shape_track(void);
+void Thr_shape_set_output(uint16_t);
+uint16_t Thr_shape_get_output(void);
+
+#endif // THR_SHAPE_H
@@ -0,0 +1,54 @@
+/**
+  ******************************************************************************
+  * @file zcp.h
+  * @brief Comparator zero-crossing capture
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef ZCP_H
+#define ZCP_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+/* defines -------------------------------------------------------------------*/
+
+/**
+ * @brief Blanking window after the commutation, 2^-ZCP_BLANK_SH of the sector
+ *  (15 degrees) but at least ZCP_BLANK_MIN timestamp counts - the comparator
+ *  chatters with the commutation spike and the demagnetization of the phase
+ */
+#define ZCP_BLANK_SH     2
+#define ZCP_BLANK_MIN    20
+
+/**
+ * @brief Timing advance, 2^-ZCP_ADV_SH of the sector (7.5 degrees)
+ */
+#define ZCP_ADV_SH       3
+
+/**
+ * @brief Consecutive sectors with a ZCP to lock (two electrical revolutions)
+ */
+#define ZCP_LOCK_CT      12
+
+/**
+ * @brief Consecutive sectors without a ZCP to lose the lock
+ */
+#define ZCP_MISS_MAX     6
+
+/* types ---------------------------------------------------------------------*/
+
+/* prototypes ----------------------------------------------------------------*/
+
+void Zcp_reset(void);
+
+void Zcp_on_commutation(uint16_t tm, uint16_t sector_perd);
+uint8_t Zcp_on_capture(uint16_t t_zcp, uint16_t t_now, uint16_t * pdelay);
+
+uint8_t Zcp_is_locked(void);
+uint16_t Zcp_get_period(void);
+uint8_t Zcp_get_status(void);
+
+#endif // ZCP_H
@@ -18,7 +18,12 @@
 #include "mdata.h"
 #include "pwm_stm8s.h" // motor phase control
 #include "faultm.h"
+#include "stall.h"
+#include "pstore.h"
+#include "olcal.h"
 #include "sequence.h"
+#include "hall.h"
+#include "zcp.h"
 
 /* Private defines -----------------------------------------------------------*/
 
@@ -27,22 +32,17 @@
 
 
 /*
- * precision is 1/TIM2_PWM_PD = 0.4% per count
+ * 0.1 % units, precision is 1/TIM2_PWM_PD = 0.4% per count
  */
-#define PWM_DC_ALIGN     25.0
-#define PWM_DC_RAMPUP    15.0
-#define PWM_DC_STARTUP   14.4
-#define PWM_DC_SHUTOFF    7.2 // stalls if slower
+#define PWM_DC_SHUTOFF    72 // 7.2 %, stalls if slower
 
 // define pwm pulse times for operation states 
-#define PWM_PD_ALIGN     PWM_GET_PULSE_COUNTS( PWM_DC_ALIGN )
-#define PWM_PD_RAMPUP    PWM_GET_PULSE_COUNTS( PWM_DC_RAMPUP )
-#define PWM_PD_STARTUP   PWM_GET_PULSE_COUNTS( PWM_DC_STARTUP )
+// duty-cycles of the alignment and ramp are tuning parameters (pstore)
 #define PWM_PD_SHUTOFF   PWM_GET_PULSE_COUNTS( PWM_DC_SHUTOFF )
 
  
  // commutation period at start of ramp (est. @ 12v) - exp. det.
-#define BL_CT_RAMP_START  (5632.0 * CTIME_SCALAR) // $1600
+#define BL_CT_RAMP_START  (5632 * CTIME_SCALAR) // $1600
 
 /**
  * @brief Control rate scalar
@@ -51,11 +51,15 @@
  */
 #define CTRL_RATEM  4
 
-// The control-frame rate becomes factored into the integer ramp-step
-#define BL_ONE_RAMP_UNIT  (1.5 * CTRL_RATEM * CTIME_SCALAR)
+// The control-frame rate becomes factored into the integer ramp-step (1.5
+// counts per control-rate unit)
+#define BL_ONE_RAMP_UNIT  FXP_RATIO( CTRL_RATEM * CTIME_SCALAR, 3, 2 )
 
-// length of alignment step (experimentally determined w/ 1100kv @12.5v)
-#define BL_TIME_ALIGN  (200 * 1) // N frames @ 1 ms / frame
+STATIC_ASSERT( 0 == ( 3 * CTRL_RATEM * CTIME_SCALAR ) % 2 ); // no fraction lost
+STATIC_ASSERT( BL_CT_RAMP_START <= U16_MAX );
+STATIC_ASSERT( PWM_PD_SHUTOFF > 0 );
+
+// length of alignment step is a tuning parameter (pstore)
 
 
 /* Private types -----------------------------------------------------------*/
@@ -82,6 +86,7 @@ BL_State_T;
 
 static uint16_t BL_comm_period; // persistent value of ramp timing
 static uint16_t BL_motor_speed; // persistent value of motor speed
+static uint16_t BL_speed_cmd;   // latest commanded speed (BL_set_speed)
 static uint16_t BL_optimer; // allows for timed op state (e.g. alignment)
 static BL_State_T BL_opstate; // BL operation state
 
@@ -163,6 +168,18 @@ void BL_reset(void)
 
   Faultm_init();
 
+  Stall_reset();
+
+#if defined( HALL_SENSOR )
+  Hall_reset();
+#endif
+
+#if defined( BEMF_COMPARATOR )
+  Zcp_reset();
+#endif
+
+  Olcal_abort();
+
   BL_set_opstate( BL_STOPPED );  // set the initial control-state
 }
 
@@ -173,8 +190,8 @@ void BL_reset(void)
  * @details
  *  The motor is started once reaching the ramp speed threshold, and allowed to
  *  slow down to the low shutoff threshold.
- *  UI Speed is shared with background task so this function should
- *  be invoked only from within a CS.
+ *  Called at every control frame (ISR): the machine is reset only on the
+ *  transition of the command to the shutoff level, not while it stays there.
  *
  * @param ui_mspeed_counts The desired motor output in tetms of timer counts
  */
@@ -183,16 +200,18 @@ void BL_set_speed(uint16_t ui_mspeed_counts)
   if( ui_mspeed_counts > PWM_PD_SHUTOFF )
   {
     // Update the dc if speed input greater than ramp start, OR if system already running
-    if( ui_mspeed_counts > PWM_PD_STARTUP || 0 != BL_motor_speed  /* if Control_mode != STOPPED */ )
+    if( ui_mspeed_counts > Pstore_get()->pd_startup || 0 != BL_motor_speed  /* if Control_mode != STOPPED */ )
     {
       BL_motor_speed = ui_mspeed_counts;
     }
   }
-  else
+  else if( BL_speed_cmd > PWM_PD_SHUTOFF )
   {
     // commanded speed less than low limit so reset - has to ramp again to get started.
     BL_reset();
   }
+
+  BL_speed_cmd = ui_mspeed_counts;
 }
 
 /**
@@ -308,18 +327,25 @@ void BL_State_Ctrl(void)
     {
       if (inp_dutycycle > 0)
       {
+#if defined( HALL_SENSOR )
+        // rotor position is known from the sensors: no alignment or ramp, the
+        // sector is driven at once with the commanded duty-cycle
+        BL_set_opstate( BL_CLS_LOOP ); // state-transition
+        Sequence_Set_Sector( Hall_get_sector() );
+#else
         BL_set_opstate( BL_ALIGN ); // state-transition
-        BL_optimer = BL_TIME_ALIGN;
+        BL_optimer = Pstore_get()->time_align;
 
         // Set initial commutation timing period upon state transition.
         BL_set_timing( (uint16_t)BL_CT_RAMP_START );
+#endif
       }
     }
     else if( BL_ALIGN == BL_get_opstate() )
     {
       if (BL_optimer > 0)
       {
-        inp_dutycycle = PWM_PD_ALIGN;
+        inp_dutycycle = Pstore_get()->pd_align;
         BL_optimer -=1;
       }
       else
@@ -338,10 +364,10 @@ void BL_State_Ctrl(void)
         uint16_t comm_perd_sp; // = BL_get_timing();
 
         // table-lookup for the target commutation timing period for the PWM duty-cycle (low speed-startup) 
-        uint16_t olt = Get_OL_Timing( PWM_PD_STARTUP );
+        uint16_t olt = Get_OL_Timing_Vcomp( Pstore_get()->pd_startup, Seq_Get_Vbatt() );
 
         // Set duty-cycle for rampup somewhere between 10-25% (tbd)
-        inp_dutycycle = PWM_PD_RAMPUP;
+        inp_dutycycle = Pstore_get()->pd_rampup;
 
         // PWM period ramped down by fixed rate of increment (decrement) ... linear ramp
 
@@ -356,17 +382,38 @@ void BL_State_Ctrl(void)
       if( comm_perd_sp > olt )
       {
         BL_set_opstate( BL_OPN_LOOP ); // state-transition
+
+        Stall_arm(); // back-EMF is usable from the ramp-to speed
       }
     }
     else if( BL_OPN_LOOP == BL_get_opstate() )
     {
-      uint16_t olt = Get_OL_Timing( inp_dutycycle );
       // grab the current commutation period setpoint to handoff to ramp control
       uint16_t comm_perd_sp = BL_get_timing();
 
-      // update the commutation time period
-      uint16_t temp16 = timing_ramp_control(comm_perd_sp, olt);
-      BL_set_timing(temp16);
+      if ( FALSE != Olcal_update( &inp_dutycycle, &comm_perd_sp,
+                                  Seq_get_timing_error(), Seq_Get_Vbatt() ) )
+      {
+        // calibration sweep in progress sets the duty-cycle and the timing
+        BL_set_timing(comm_perd_sp);
+      }
+      else
+      {
+        // timing table lookup, compensated for supply voltage
+        uint16_t olt = Get_OL_Timing_Vcomp( inp_dutycycle, Seq_Get_Vbatt() );
+
+        // update the commutation time period
+        uint16_t temp16 = timing_ramp_control(comm_perd_sp, olt);
+        BL_set_timing(temp16);
+
+#if defined( BEMF_COMPARATOR )
+        if (FALSE != Zcp_is_locked())
+        {
+          // comparator ZCP in every sector of the latest two revolutions
+          BL_set_opstate( BL_CLS_LOOP ); // state-transition
+        }
+#endif
+      }
 
       // check plausibility condition for transition to closed-loop
       // if ( Seq_get_timing_error_p() )
@@ -374,6 +421,15 @@ void BL_State_Ctrl(void)
     }
     else if( BL_CLS_LOOP == BL_get_opstate() )
     {
+#if defined( HALL_SENSOR )
+      // commutation follows the sensor edges, the commutation period is the
+      // measured sector period (telemetry, PWM band, back-EMF sample timing)
+      BL_set_timing( Hall_get_period() );
+#elif defined( BEMF_COMPARATOR )
+      // commutation is phased from the ZCP captures (Driver_on_zcp_capture),
+      // the commutation period follows the measured sector period
+      BL_set_timing( Zcp_get_period() );
+#endif
 #if 0 // test code
       // the control gain is macro'd together with the unscaling of the error term and also /2 of the sma
       uint16_t t16 = BLDC_OL_comm_tm ;
@@ -389,7 +445,7 @@ void BL_State_Ctrl(void)
     // else ...check for conditions if necessary to unlatch CL control mode? (too slow, lost sync)
   }
 
-  // pwm duty-cycle will be upated to the timer peripheral at next commutation step.
+  // pwm duty-cycle is loaded to the timer compare registers (effective next PWM cycle)
   PWM_set_dutycycle( inp_dutycycle );
 }
 
@@ -412,8 +468,12 @@ void BL_Commutation_Step(void)
   case BL_RAMPUP:
   case BL_OPN_LOOP:
   case BL_CLS_LOOP:
-
+#if defined( HALL_SENSOR )
+    // on a sensor edge (not the timer), load the sector of the Hall state
+    Sequence_Set_Sector( Hall_get_sector() );
+#else
     Sequence_Step();
+#endif
     break;
 
   case BL_STOPPED:
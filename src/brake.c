@@ -0,0 +1,205 @@
+/**
+  ******************************************************************************
+  * @file brake.c
+  * @brief Active braking and regen-limited deceleration
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup brake Braking
+ * @brief Active braking and regen-limited deceleration
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "brake.h"
+#include "bldc_sm.h"
+#include "faultm.h"
+#include "sequence.h"
+#include "mdata.h" // MDATA_VBATT_COUNTS
+#include "thr_shape.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+/*
+ * Default brake level, 50% of PWM frames with the low-sides shorted
+ */
+#define BRK_LEVEL_DEF  ( BRK_LEVEL_FULL / 2 )
+
+/*
+ * Bus voltage limit for regenerative deceleration, 13.8v - above a charged 3S
+ * pack (12.6v), on the same scale as the timing calibration voltage. The
+ * phase A divider reads up to ~14.2v (10-bit ADC).
+ */
+#define BRK_VBATT_REGEN_LIM  MDATA_VBATT_COUNTS( 13800 )
+
+STATIC_ASSERT( BRK_VBATT_REGEN_LIM < 0x03FF );
+
+/*
+ * Max reduction of the speed command per control frame (~1 ms) while the bus
+ * voltage is above the regen limit, at least 1 count (PWM_8K period is 250).
+ */
+#define BRK_REGEN_SLEW  ( ( PWM_PERIOD_COUNTS >= 1024 ) ? ( PWM_PERIOD_COUNTS / 1024 ) : 1 )
+
+STATIC_ASSERT( BRK_REGEN_SLEW > 0 );
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static brake_mode_t Brk_mode;
+static uint16_t Brk_level = BRK_LEVEL_DEF;
+
+static uint8_t Brk_engaged;     // low-side chopping active (read in PWM ISR)
+static uint16_t Brk_accum;      // sigma-delta accumulator for chopping
+static uint16_t Brk_speed_prev; // speed command of previous control frame
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Set the deceleration mode
+ *
+ * @details Expect to be called from non-ISR context with interrupts disabled.
+ */
+void Brake_set_mode(brake_mode_t mode)
+{
+    if (mode < BRAKE_NR_MODES)
+    {
+        Brk_mode = mode;
+    }
+}
+
+/**
+ * @brief Accessor for the deceleration mode
+ */
+brake_mode_t Brake_get_mode(void)
+{
+    return Brk_mode;
+}
+
+/**
+ * @brief Set the brake level
+ * @param level  Proportion of PWM frames with low-sides shorted, range
+ *  (0:BRK_LEVEL_FULL)
+ */
+void Brake_set_level(uint16_t level)
+{
+    if (level > BRK_LEVEL_FULL)
+    {
+        level = BRK_LEVEL_FULL;
+    }
+    Brk_level = level;
+}
+
+/**
+ * @brief Accessor for the brake level
+ */
+uint16_t Brake_get_level(void)
+{
+    return Brk_level;
+}
+
+/**
+ * @brief Limit the rate of speed reduction by bus voltage (control frame)
+ *
+ * @details While the motor is driven, the off-time of the PWM cycle has the
+ *  low-side switch on, so when the duty-cycle is reduced below the back-EMF
+ *  the motor current reverses and is returned to the bus. In regen mode, if
+ *  the bus voltage measured in the sequencer exceeds the limit then the speed
+ *  command is backed off to a slow rate of decrease. The held speed is fed
+ *  back to the throttle shaping stage, which slews down from there once the
+ *  bus voltage is below the limit.
+ *
+ * @param speed  Commanded speed (PWM counts)
+ * @return Speed command to apply to the BL controller
+ */
+uint16_t Brake_regen_limit(uint16_t speed)
+{
+    if ( BRAKE_REGEN == Brk_mode && BL_IS_RUNNING == BL_get_state() )
+    {
+        if ( speed < Brk_speed_prev && Seq_Get_Vbatt() > BRK_VBATT_REGEN_LIM )
+        {
+            if ( (Brk_speed_prev - speed) > BRK_REGEN_SLEW )
+            {
+                speed = Brk_speed_prev - BRK_REGEN_SLEW;
+
+                Thr_shape_set_output( speed );
+            }
+        }
+    }
+
+    Brk_speed_prev = speed;
+
+    return speed;
+}
+
+/**
+ * @brief Engage or release the brake (control frame)
+ *
+ * @details The brake is engaged when the motor has been switched off, i.e. in
+ *  place of letting it windmill. Not engaged in a fault condition. On release,
+ *  all phases are stopped so that the commutation sequence starts from the same
+ *  condition as following BL_reset().
+ */
+void Brake_Ctrl(void)
+{
+    uint8_t engage = FALSE;
+
+    if ( BRAKE_OFF != Brk_mode &&
+         BL_NOT_RUNNING == BL_get_state() && 0 == Faultm_get_status() )
+    {
+        engage = TRUE;
+    }
+
+    if (engage != Brk_engaged)
+    {
+        All_phase_stop(); // PWM off and half-bridges disabled in either case
+
+        if (FALSE != engage)
+        {
+            All_phase_brake(); // PWM inputs low, low-side on if /SD is enabled
+            Brk_accum = 0;
+        }
+        Brk_engaged = engage;
+    }
+}
+
+/**
+ * @brief Brake chopping at the PWM boundary (PWM timer ISR)
+ *
+ * @details The half-bridge /SD inputs of all 3 phases are switched together at
+ *  the PWM rate with a first-order sigma-delta accumulator so that the fraction
+ *  of PWM frames with low-sides shorted is proportional to the brake level.
+ */
+void Brake_on_PWM_edge(void)
+{
+    if (FALSE == Brk_engaged)
+    {
+        return;
+    }
+
+    Brk_accum += Brk_level;
+
+    if (Brk_accum >= BRK_LEVEL_FULL)
+    {
+        Brk_accum -= BRK_LEVEL_FULL;
+
+        PWM_PhA_HB_ENABLE();
+        PWM_PhB_HB_ENABLE();
+        PWM_PhC_HB_ENABLE();
+    }
+    else
+    {
+        PWM_PhA_HB_DISABLE();
+        PWM_PhB_HB_DISABLE();
+        PWM_PhC_HB_DISABLE();
+    }
+}
+
+/**@}*/ // defgroup
@@ -0,0 +1,114 @@
+/**
+  ******************************************************************************
+  * @file curr_sense.c
+  * @brief Motor current sensing and cycle-by-cycle current limit
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup curr_sense Current Sense
+ * @brief Motor current sensing and cycle-by-cycle current limit
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "curr_sense.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+STATIC_ASSERT( CURR_PEAK_LIMIT < 1024 && CURR_AVG_LIMIT < CURR_PEAK_LIMIT ); // 10-bit ADC
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint16_t Curr_sample;  // latest sample, ADC counts less offset
+static uint32_t Curr_avg_acc; // filter accumulator, average * 2^CURR_AVG_SH
+static uint16_t Curr_dc_trim; // duty-cycle reduction, PWM counts
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Reset the current limit and the average
+ */
+void Curr_reset(void)
+{
+    Curr_sample = 0;
+    Curr_avg_acc = 0;
+    Curr_dc_trim = 0;
+}
+
+/**
+ * @brief Process a current sample (ADC ISR)
+ *
+ * @details The sample is taken once per PWM cycle, at the start of the PWM on
+ *  window. If over the peak limit, the duty-cycle trim is stepped up so that
+ *  the on-time of the next PWM cycle is shortened, otherwise the trim bleeds
+ *  off slowly. The average current is a first-order IIR filter of the samples.
+ *
+ * @param adc_counts  Raw ADC reading of the current-sense amplifier
+ * @return Duty-cycle trim in PWM counts
+ */
+uint16_t Curr_on_sample(uint16_t adc_counts)
+{
+    uint16_t sample = 0;
+
+    if (adc_counts > CURR_ADC_OFFSET)
+    {
+        sample = adc_counts - CURR_ADC_OFFSET;
+    }
+    Curr_sample = sample;
+
+    if (sample > CURR_PEAK_LIMIT)
+    {
+        if (Curr_dc_trim < (PWM_PERIOD_COUNTS - CURR_TRIM_STEP))
+        {
+            Curr_dc_trim += CURR_TRIM_STEP;
+        }
+        else
+        {
+            Curr_dc_trim = PWM_PERIOD_COUNTS;
+        }
+    }
+    else if (Curr_dc_trim > 0)
+    {
+        Curr_dc_trim -= 1;
+    }
+
+    // avg += (sample - avg) / 2^N
+    Curr_avg_acc = Curr_avg_acc - (Curr_avg_acc >> CURR_AVG_SH) + sample;
+
+    return Curr_dc_trim;
+}
+
+/**
+ * @brief Accessor for latest current sample (ADC counts)
+ */
+uint16_t Curr_get_sample(void)
+{
+    return Curr_sample;
+}
+
+/**
+ * @brief Accessor for average current (ADC counts)
+ */
+uint16_t Curr_get_avg(void)
+{
+    return (uint16_t)(Curr_avg_acc >> CURR_AVG_SH);
+}
+
+/**
+ * @brief Accessor for present duty-cycle trim (PWM counts)
+ */
+uint16_t Curr_get_dc_trim(void)
+{
+    return Curr_dc_trim;
+}
+
+/**@}*/ // defgroup
@@ -16,9 +16,19 @@
 /* Includes ------------------------------------------------------------------*/
 #include "mcu_stm8s.h"
 #include "bldc_sm.h"
-#include "per_task.h"
 #include "pwm_stm8s.h"
+#include "thr_shape.h"
+#include "brake.h"
+#include "curr_sense.h"
 #include "driver.h"
+#include "superv.h"
+#include "sched.h"
+#include "dshot.h"
+#include "rcin.h"
+#include "rccal.h"
+#include "telem.h"
+#include "hall.h"
+#include "zcp.h"
 
 /* Private defines -----------------------------------------------------------*/
 
@@ -36,7 +46,19 @@
 #define DC_HALF_REF         0 // 0x01FD
 
 #define GET_BACK_EMF_ADC( ) \
-    ( ADC_Global - DC_HALF_REF )
+    ( Adc_scan[ Adc_scan_front ].phase[ DRIVER_PHASE_A ] - DC_HALF_REF )
+
+/*
+ * DShot throttle (48:2047) scaled to PWM counts, Q16 scale factor
+ */
+#define DSHOT_THR_SCALE  \
+  FXP_Q( PWM_PERIOD_COUNTS, DSHOT_THR_MAX - DSHOT_THR_MIN + 1, 16 )
+
+#define DSHOT_THR_TO_PWM( _V_ ) \
+  FXP_MUL( (_V_) - DSHOT_THR_MIN, DSHOT_THR_SCALE, 16 )
+
+STATIC_ASSERT( DSHOT_THR_SCALE <= U16_MAX );
+STATIC_ASSERT( MSPEED_PCNT_INCREM_STEP > 0 ); // UI speed step
 
 /* Private types -----------------------------------------------------------*/
 
@@ -44,7 +66,18 @@
 
 /* Private variables ---------------------------------------------------------*/
 
-static uint16_t ADC_Global;
+/*
+ * ADC scan snapshots, double-buffered: the EOC handler fills the back buffer
+ * and flips, a reader of the front buffer is safe across one flip
+ */
+static driver_adc_scan_t Adc_scan[2];
+static uint8_t Adc_scan_front;         // index of the latest complete snapshot
+static volatile uint8_t Adc_scan_seq;  // count of flips
+
+#if defined( HAS_CURRENT_SENSE )
+static uint8_t Adc_curr_conv;  // current-sense conversion in progress (ahead of the scan)
+static uint16_t Adc_curr;      // latest current-sense conversion
+#endif
 
 // Accummulates a string of 10-bit ADC samples for averaging - could reduce
 // to 8 bits as possibly the 2 lsb's are not that significant anyway.
@@ -60,10 +93,114 @@ static uint16_t Pulse_dur;
 
 static uint8_t rxReceive[RX_BUFFER_SIZE];
 
+#if defined( DSHOT_INPUT )
+// edge timestamps of the DShot frame
+static uint16_t Dshot_t_start[DSHOT_FRAME_BITS];
+static uint16_t Dshot_t_end[DSHOT_FRAME_BITS];
+static uint8_t Dshot_rx_busy;  // frame capture in progress (capture ISR)
+static uint8_t Dshot_thr_held; // throttle held for one PWM frame
+#endif
+
+// back-EMF samples (ADC counts) and timestamps at the 15 and 45 degree ticks
+static uint16_t Bemf_smp_adc[DRIVER_BEMF_NR_SMP];
+static uint16_t Bemf_smp_tm[DRIVER_BEMF_NR_SMP];
+static uint8_t Bemf_smp_arm; // slot + 1 requested at the tick, 0 if none
+static uint8_t Bemf_smp_req; // slot + 1 of the scan in progress, 0 if none
+static uint8_t Bemf_phase;   // floating phase of the present sector
+static uint8_t Pwm_phase;    // PWM driven phase of the present sector
+
+static uint8_t Comm_tick;    // quarter-sector tick of the commutation timer (0:3)
+
 /* Private function prototypes -----------------------------------------------*/
 
 /* Private functions ---------------------------------------------------------*/
 
+/*
+ * Request a back-EMF sample at a quarter-sector tick. The sample is taken from
+ * the scan started at the next PWM edge, i.e. at the same point of the PWM
+ * cycle for every sample and without a conversion of its own colliding with
+ * the scan. The timestamp is taken at that PWM edge, the result is stored by
+ * the ADC EOC handler.
+ */
+static void bemf_sample_request(uint8_t slot)
+{
+  Bemf_smp_arm = slot + 1;
+}
+
+#if defined( BEMF_COMPARATOR )
+/*
+ * Phase the commutation timer so that the commutation tick is due after the
+ * delay (timestamp counts). The timer counts 4x the timestamp rate and its
+ * period is a quarter of the sector, the whole quarters of the delay are
+ * counted as ticks and the remainder is loaded to the counter.
+ */
+static void comm_timer_sync(uint16_t delay)
+{
+  uint16_t quarter = BL_get_timing();
+  uint32_t t = (uint32_t)delay * 4;
+  uint8_t ticks = 0;
+
+  while (t > quarter && ticks < 3)
+  {
+    t -= quarter;
+    ticks += 1;
+  }
+  if (t > quarter)
+  {
+    t = quarter;
+  }
+  MCU_set_comm_timer_count( quarter - (uint16_t)t );
+
+  Comm_tick = (uint8_t)( ( 3 - ticks ) & 3 ); // tick before the update event
+}
+#endif
+
+#if defined( DSHOT_INPUT )
+/*
+ * Pass the digital throttle of a new DShot frame to the shaping stage and
+ * apply it at once (PWM edge, i.e. within a PWM period of the end of the
+ * frame), within the slew limit of the present control frame. A command frame
+ * (or disarmed) is zero throttle.
+ */
+static void dshot_throttle(void)
+{
+  uint16_t value;
+
+  if (FALSE != Dshot_get_value( &value ))
+  {
+    Thr_shape_set_input( (value >= DSHOT_THR_MIN) ? DSHOT_THR_TO_PWM( value ) : 0 );
+
+    BL_set_speed( Brake_regen_limit( Thr_shape_track() ) );
+  }
+}
+#elif defined( HAS_SERVO_INPUT )
+/*
+ * Pass the throttle of the latest RC pulse to the shaping stage once the
+ * pulse protocol is detected (until then the throttle is set by the UI).
+ * On signal loss the throttle is cut, the fault is set by the background task.
+ * The throttle is also held at zero during the range calibration.
+ */
+static void rc_throttle(void)
+{
+  uint16_t throttle;
+  uint8_t loss;
+
+  Rcin_on_frame();
+
+  loss = Rcin_get_loss();
+
+  if (FALSE != Rccal_update( (FALSE != loss) ? RCIN_NONE : Rcin_get_protocol(),
+                             Rcin_get_pulse_dur() ) || FALSE != loss)
+  {
+    Thr_shape_set_input( 0 );
+  }
+  else if (FALSE != Rcin_get_throttle( &throttle ))
+  {
+    Thr_shape_set_input( throttle );
+  }
+}
+#endif
+
 #if 0 // BUFFER_ADC_BEMF
 /*
  * averag 8 samples .. could be inline or macro
@@ -200,14 +337,67 @@ uint16_t Driver_Get_Back_EMF_Avg(void)
 #endif
 
 /**
- * @brief Accessor for system voltage measurement.
- * @details Phase voltage measurement from ADC Channel 0 is to be used as
- * back-EMF sensing or system voltage.
- * @return  Most recent captured ADC conversion value from Channel 0
+ * @brief Accessor for back-EMF sample taken at a quarter-sector tick.
+ * @param slot  DRIVER_BEMF_SMP_15 or DRIVER_BEMF_SMP_45
+ * @return  ADC conversion value of the floating phase of the sector
+ */
+uint16_t Driver_get_bemf_sample(uint8_t slot)
+{
+  return Bemf_smp_adc[slot];
+}
+
+/**
+ * @brief Accessor for timestamp of back-EMF sample.
+ * @param slot  DRIVER_BEMF_SMP_15 or DRIVER_BEMF_SMP_45
+ * @return  Timestamp (0.5 us) of the PWM edge that started the scan
  */
-uint16_t Driver_Get_ADC(void)
+uint16_t Driver_get_bemf_sample_tm(uint8_t slot)
 {
-  return ADC_Global;
+  return Bemf_smp_tm[slot];
+}
+
+/**
+ * @brief Set the phases of the sector for the ADC scan.
+ * @details Called by the sequencer at the sector transition (commutation ISR),
+ *  ahead of the back-EMF sample requests at the 15 and 45 degree ticks.
+ * @param pwm_phase  PWM driven phase (system voltage while phase A)
+ * @param float_phase  Floating phase (back-EMF samples)
+ * @param rising  TRUE if the floating phase voltage rises in the sector
+ */
+void Driver_set_sector_phases(uint8_t pwm_phase, uint8_t float_phase, uint8_t rising)
+{
+  Pwm_phase = pwm_phase;
+  Bemf_phase = float_phase;
+
+  // a request not yet taken at a PWM edge would sample the next sector
+  Bemf_smp_arm = 0;
+
+#if defined( BEMF_COMPARATOR )
+  Zcp_on_commutation( MCU_get_timestamp(), BL_get_timing() );
+  MCU_zcp_select( float_phase, rising );
+#else
+  (void)rising;
+#endif
+}
+
+/**
+ * @brief Copy the latest ADC scan snapshot.
+ * @details All channels of the snapshot are from the same scan (PWM cycle).
+ *  The copy is repeated if the front buffer could have been refilled while
+ *  copying (two flips), so it may be called from the background task as well
+ *  as the ISRs, without extra conversions.
+ * @param pscan  Destination
+ */
+void Driver_get_adc_scan(driver_adc_scan_t * pscan)
+{
+  uint8_t seq;
+
+  do
+  {
+    seq = Adc_scan_seq;
+    *pscan = Adc_scan[ Adc_scan_front ];
+  }
+  while ( (uint8_t)( Adc_scan_seq - seq ) > 1 );
 }
 
 /**
@@ -270,6 +460,7 @@ void Driver_Clear_Rx_Buffer_Element(uint8_t Location)
  * event handlers ********************************
  */
  
+#if defined( HAS_SERVO_INPUT )
 /**
  * @brief Call from timer/capture ISR on capture of rising edge of servo pulse
  *
@@ -290,23 +481,110 @@ void Driver_on_capture_rise(void)
  */
 void Driver_on_capture_fall(void)
 {
-
-// noise on this signal when motor running?
-
   uint16_t t16 = get_pulse_end() - curr_pulse_start_tm /* get_pulse_start() */;
 
-// apply exponential filter (simple moving average) to smoothe the signal
-  Pulse_dur = (Pulse_dur + t16) >> 1; // sma
+// noise on the signal (motor running) is rejected by the range and period
+// check and a median filter at the pulse rate (up to 32 kHz for Multishot), the
+// scaling to throttle is done once per control frame (rc_throttle)
+  Rcin_on_pulse( t16, Pulse_perd );
+
+  Pulse_dur = Rcin_get_pulse_dur();
 
 // clear test pin
 //    GPIO_WriteLow(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
 }
+#endif // HAS_SERVO_INPUT
+
+#if defined( DSHOT_INPUT )
+/**
+ * @brief Call from timer/capture ISR on capture of the first edge of a DShot
+ *  frame
+ *
+ * @details The edges of the frame are captured and it is decoded, the throttle
+ *  is applied at the next PWM edge. Bidirectional DShot is inverted: the bit
+ *  is the low time, and the eRPM of the latest commutation period is returned
+ *  after a valid frame.
+ */
+void Driver_on_capture_frame(void)
+{
+  uint8_t nr_bits;
+
+  // the control frame and the throttle update in the PWM ISR would preempt
+  // the capture for longer than a bit period, they run at the following PWM
+  // frame instead
+  Dshot_rx_busy = TRUE;
+  Sched_set_hold( TRUE );
+
+  nr_bits =
+    MCU_servo_capture_frame( Dshot_t_start, Dshot_t_end, DSHOT_FRAME_BITS, DSHOT_EDGE_TMO );
+
+  Sched_set_hold( FALSE );
+  Dshot_rx_busy = FALSE;
+
+#if defined( DSHOT_TELEM )
+  if (FALSE != Dshot_on_frame( Dshot_t_start, Dshot_t_end, nr_bits ))
+  {
+    MCU_servo_pin_send(
+      Telem_gcr( Telem_frame( Telem_eperiod_us( BL_get_timing() ) ) ),
+      TELEM_NR_BITS, Dshot_t_end[ DSHOT_FRAME_BITS - 1 ] + TELEM_GAP_T,
+      (150 == Dshot_get_rate()) ? TELEM_BIT_T_Q4_150 : TELEM_BIT_T_Q4_300 );
+  }
+#else
+  (void)Dshot_on_frame( Dshot_t_start, Dshot_t_end, nr_bits );
+#endif
+}
+#endif // DSHOT_INPUT
+
+#if defined( HALL_SENSOR )
+/**
+ * @brief Call from external interrupt ISR on an edge of a Hall sensor
+ *
+ * @details The sector of the new Hall state is loaded at once, the edge
+ *  interval is the speed measurement. Edges count toward the commutation ISR
+ *  overrun check (noise on the sensor lines).
+ */
+void Driver_on_hall_edge(void)
+{
+  Superv_on_comm_isr();
+
+  if ( HALL_SECTOR_INVALID != Hall_on_edge( MCU_get_hall_state(), MCU_get_timestamp() ) &&
+       0 == Superv_get_status() )
+  {
+    BL_Commutation_Step();
+  }
+}
+#endif
+
+#if defined( BEMF_COMPARATOR )
+/**
+ * @brief Call from timer capture ISR on an edge of the back-EMF comparator
+ *
+ * @details The capture is disabled at the ZCP until the next sector. Once
+ *  locked the commutation timer is re-phased so that the commutation falls at
+ *  30 degrees after the ZCP less the advance.
+ */
+void Driver_on_zcp_capture(void)
+{
+  uint16_t delay;
+
+  if (FALSE != Zcp_on_capture( MCU_get_zcp_capture(), MCU_get_timestamp(), &delay ))
+  {
+    MCU_zcp_disable();
+
+    if (FALSE != Zcp_is_locked())
+    {
+      comm_timer_sync( delay );
+    }
+  }
+}
+#endif
 
 /**
  * @brief  Hook for synchronizing to the PWM pulse.
  *
  * @details  Invoked from timer ISR.
- * Phase voltage measurements must be synchronized to PWM.
+ * Phase voltage measurements must be synchronized to PWM. A change of PWM
+ * period is also applied here so that it occurs at a PWM boundary.
  * Initiates ADC sample sequence on start of PWM pulse.
  */
 void Driver_on_PWM_edge(void)
@@ -317,85 +595,169 @@ void Driver_on_PWM_edge(void)
 #if 0 // BUFFER_ADC_BEMF
   ph0_adc_tbct += 1 ; // advance the buffer index
 #endif
+// PWM boundary: load new period band if one has been requested
+  PWM_on_update();
+
+// brake chopping of the half-bridge enables if the brake is engaged
+  Brake_on_PWM_edge();
+
+// back-EMF sample requested at a quarter-sector tick is taken in this scan
+  if (0 != Bemf_smp_arm)
+  {
+    Bemf_smp_tm[ Bemf_smp_arm - 1 ] = MCU_get_timestamp();
+    Bemf_smp_req = Bemf_smp_arm;
+    Bemf_smp_arm = 0;
+  }
+
+#if defined( HAS_CURRENT_SENSE )
+// current first, as a single conversion at the start of the on window - the
+// scan is started from its EOC
+  MCU_adc_select_curr();
+  Adc_curr_conv = TRUE;
+#endif
+
 // Enable the ADC: 1 -> ADON for the first time it just wakes the ADC up
   ADC1_Cmd(ENABLE);
 
 // ADON = 1 for the 2nd time => starts the ADC conversion
   ADC1_StartConversion();
+
+#if defined( DSHOT_INPUT )
+// throttle of a DShot frame completed since the previous PWM edge, held for
+// one PWM frame (at most) while the next frame is captured
+  if (FALSE == Dshot_rx_busy || FALSE != Dshot_thr_held)
+  {
+    Dshot_thr_held = FALSE;
+    dshot_throttle();
+  }
+  else
+  {
+    Dshot_thr_held = TRUE;
+  }
+#endif
 }
 
 /**
- * @brief  Capture ADC conversion channel 0 to buffer
+ * @brief  Capture the ADC scan to the snapshot buffer
  *
- * @details  Captures phase voltage measurement from ADC Channel 0, to be
- * used as back-EMF sensing or system voltage.
+ * @details  The motor current (Channel 4) is converted on its own at the PWM
+ * edge, ~3.5 us into the on window, and passed to the cycle-by-cycle current
+ * limit at once; its EOC starts the scan. The scan stores each channel in its
+ * data buffer register, all are read in the one EOC interrupt: phase voltages
+ * from Channels 0, 1 and 2, to be used as back-EMF sensing (floating phase) or
+ * system voltage (phase A while PWM driven, the first conversion of the scan),
+ * and the analog slider from Channel 3. The snapshot is flipped to the front
+ * when complete.
  * Called from ADC1 ISR.
  */
 void Driver_on_ADC_conv(void)
 {
-  ADC_Global = ADC1_GetBufferValue( ADC1_CHANNEL_0 );
+  driver_adc_scan_t * pscan = &Adc_scan[ Adc_scan_front ^ 1 ];
+
+#if defined( HAS_CURRENT_SENSE )
+  if (FALSE != Adc_curr_conv)
+  {
+    Adc_curr_conv = FALSE;
+    Adc_curr = ADC1_GetConversionValue();
+
+    MCU_adc_select_scan();
+    ADC1_StartConversion();
+
+// current sampled in the PWM on window, limit applied on next PWM cycle
+    PWM_set_dc_trim( Curr_on_sample( Adc_curr ) );
+    return;
+  }
+#endif
+
+#if defined( PH1_BEMF_IN_PORT )
+  pscan->phase[DRIVER_PHASE_A] = ADC1_GetBufferValue( ADC1_CHANNEL_0 );
+  pscan->phase[DRIVER_PHASE_B] = ADC1_GetBufferValue( ADC1_CHANNEL_1 );
+  pscan->phase[DRIVER_PHASE_C] = ADC1_GetBufferValue( ADC1_CHANNEL_2 );
+#else
+// phase A divider only (AIN2), phase B and C stay 0 and are not evaluated
+  pscan->phase[DRIVER_PHASE_A] = ADC1_GetBufferValue( ADC1_CHANNEL_2 );
+#endif
+  pscan->slider = ADC1_GetBufferValue( ADC1_CHANNEL_3 );
+
+  pscan->vbatt = (DRIVER_PHASE_A == Pwm_phase) ?
+    pscan->phase[DRIVER_PHASE_A] : Adc_scan[ Adc_scan_front ].vbatt;
+
+#if defined( HAS_CURRENT_SENSE )
+  pscan->curr = Adc_curr;
+#else
+  pscan->curr = 0;
+#endif
+
+  Adc_scan_front ^= 1;
+  Adc_scan_seq += 1;
+
+// sample requested at a quarter-sector tick, on the floating phase
+  if (0 != Bemf_smp_req)
+  {
+    Bemf_smp_adc[ Bemf_smp_req - 1 ] = pscan->phase[ Bemf_phase ];
+    Bemf_smp_req = 0;
+  }
 
 #if 0 // BUFFER_ADC_BEMF
   if (ph0_adc_tbct < PH0_ADC_TBUF_SZ)
   {
-    ph0_adc_fbuf[ph0_adc_tbct] = ADC_Global ;
+    ph0_adc_fbuf[ph0_adc_tbct] = pscan->phase[DRIVER_PHASE_A];
   }
 #endif
 }
 
 /**
- * @brief  System Timer event handler
+ * @brief  BL Control task
  *
  * @details
- *   Event handler for System Timer ISR. The event handler multiplexes the
- *   BL Control Task and the Periodic Task which occur at different rates.
+ *   Scheduled from the system tick (see sched.c) at ~1 ms in ISR context.
  *   Responsible for updating the Commutation Timer period - invokes accessors
  *   from both MCU and BL classes.
  *
- *   System Timer period = fMaster * PS * 100%DC
- *                                   = (1/16 Mhz) * 8 * 250 counts -> 0.000125 S
- *
- *
- *    BL Control Timer frequency                            =
- *      timer period * ISR frame count * CT_FRAME       =
- *      0.000125 sec * 4 ISRs          * 2 timer events = 0.001 seconds (1000 Hz)
- *
- *    Periodic Task Timer frequency                     =
- *      timer period * ISR frame count * UI_FRAME       =
- *      0.000125     * 4 ISRs          * 32 timer events = 0.0167 seconds (60 Hz)
+ *   System tick period = PWM period * frames per tick
+ *                      = (1/16 Mhz) * 2 * 1024 counts * 1 -> 0.000128 S
  *
+ *    BL Control Timer frequency = 0.000128 sec * 8 ticks = 0.001 seconds (1000 Hz)
  */
 void Driver_Update(void)
 {
-  static const uint8_t UI_FRAME = 0x20; // UI task every 32 steps (even) i.e. 32 * 0.5 ms
-  static const uint8_t CT_FRAME = 0x01; // control task on odd steps i.e. @ 1 ms
-
-  static uint8_t trate = 0;
-  trate += 1;
+#if defined( DSHOT_INPUT )
+  // digital throttle is applied at the PWM edge following the frame
+#elif defined( HAS_SERVO_INPUT )
+  // latest RC pulse throttle, independent of the background task rate
+  rc_throttle();
+#endif
 
-  // the controller and the UI are updated on alternate frames (doubled the
-  // timer rate) presently ths update done every 1.024mS so the controller rate ~1Khz
-  if ( 0 != (trate & CT_FRAME))
+#if defined( HALL_SENSOR )
+  // time since the last edge, and commutate the sector of a missed edge
+  if ( HALL_SECTOR_INVALID != Hall_on_frame( MCU_get_hall_state() ) &&
+       0 == Superv_get_status() )
   {
-    BL_State_Ctrl();  // update commutation timing controller
+    BL_Commutation_Step();
+  }
+#endif
 
-    // refresh the timer with the updated commutation time period
-    MCU_set_comm_timer( BL_get_timing() );
+  // throttle shaping evaluated once per control frame, deceleration limited
+  // by bus voltage in regen mode
+  BL_set_speed( Brake_regen_limit( Thr_shape_update() ) );
 
-#if 0
-    /* Toggles LED to verify task timing */
-    GPIO_WriteReverse(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
-#endif
-  }
-  else if (0 == (trate % UI_FRAME))
-  {
-    Periodic_Task_Wake();
+  BL_State_Ctrl();  // update commutation timing controller
+
+  Brake_Ctrl(); // engage/release brake according to motor state
+
+  // refresh the timer with the updated commutation time period
+  MCU_set_comm_timer( BL_get_timing() );
+
+  // select PWM period band by speed (applied at next PWM update event)
+  PWM_set_band( BL_get_timing() );
+
+  // overrun/starvation checks last, so that a shutdown can not be undone
+  Superv_on_control_frame();
 
 #if 0
-    /* Toggles LED to verify task timing */
-    GPIO_WriteReverse(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
+  /* Toggles LED to verify task timing */
+  GPIO_WriteReverse(LED_GPIO_PORT, (GPIO_Pin_TypeDef)LED_GPIO_PIN);
 #endif
-  }
 }
 
 /**
@@ -405,31 +767,58 @@ void Driver_Update(void)
  *
  *   Every 4th timer event constitutes a 60-degree commutation "sector" at which
  *   time _Commutation_Step() is invoked.
- *   The timer was set up 4x faster than the commutation rate as a provision to
- *   coordinate PWM sampling for zero-crossing detection (still TBD).
+ *   The timer is set up 4x faster than the commutation rate, the ticks at 15
+ *   and 45 degrees into the sector trigger back-EMF conversions for the
+ *   two-point zero-crossing estimate (see sequence.c).
  */
 void Driver_Step(void)
 {
   static const uint8_t Modulus = 4;
-  static int index = 0;
 
 // Since the modulus being used (4) is a power of 2, then a bitwise & can be used
 // instead of a MOD (%) to save a few instructions, which is actually significant
 // as this is a very high frequency ISR!
-  index = (index + 1) & (Modulus - 1);
+  Comm_tick = (Comm_tick + 1) & (Modulus - 1);
+
+  Superv_on_comm_isr();
+
+  if (0 != Superv_get_status())
+  {
+    return; // phases are held off by the supervisor
+  }
 
-  switch(index)
+  switch(Comm_tick)
   {
   case 0:
 #if 0 // BUFFER_ADC_BEMF
     udpate_phase_average(); // average 8 samples from frame buffer
 #endif
-    BL_Commutation_Step();
+#if !defined( HALL_SENSOR )
+    BL_Commutation_Step(); // Hall mode commutates on the sensor edges
+#endif
     break;
 
   case 1:
-  case 2:
+#if defined( BEMF_COMPARATOR )
+    if (FALSE != Zcp_is_locked())
+    {
+      break; // timed from the comparator
+    }
+#endif
+    bemf_sample_request( DRIVER_BEMF_SMP_15 ); // 15 degrees
+    break;
+
   case 3:
+#if defined( BEMF_COMPARATOR )
+    if (FALSE != Zcp_is_locked())
+    {
+      break;
+    }
+#endif
+    bemf_sample_request( DRIVER_BEMF_SMP_45 ); // 45 degrees
+    break;
+
+  case 2:
   default:
     break;
   }
@@ -0,0 +1,269 @@
+/**
+  ******************************************************************************
+  * @file dshot.c
+  * @brief DShot digital throttle protocol decoder
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup dshot DShot Decoder
+ * @brief DShot digital throttle protocol decoder
+ *
+ * @details A DShot frame is 16 bits, MSB first: 11-bit value, telemetry
+ *  request bit and 4-bit CRC. Each bit starts with a rising edge, the high
+ *  time is 3/8 of the bit period for a 0 and 3/4 for a 1. Frames are separated
+ *  by a gap with the line low.
+ *
+ *  The servo capture timer captures the rising and falling edge of each bit on
+ *  two channels. The capture ISR is entered at the first edge of a frame and
+ *  polls the captures of all the bits (a bit period of a few us is too short
+ *  for an interrupt per bit), so the decoder is called once per frame with
+ *  the timestamps of the edges.
+ *  A bit is classified by comparing its high time to 9/16 of its period (midway
+ *  between 3/8 and 3/4), so the decoder is independent of the bit rate
+ *  (DShot150/300). At the 0.5 us resolution of the capture timer this leaves
+ *  a margin of about 1 count of the high time at DShot300.
+ *
+ *  Bidirectional DShot (DSHOT_TELEM) is inverted i.e. idle high and the bit
+ *  is the low time, and the CRC is inverted. The driver passes the edges of
+ *  the low time, so the decoder only differs by the CRC.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "dshot.h"
+
+#if defined( DSHOT_INPUT )
+
+/* Private defines -----------------------------------------------------------*/
+
+/*
+ * Plausible bit period, capture timer counts (DShot300 to DShot150 with
+ * margin), bits within a frame must be within 1/4 of the period of the first
+ * (plus 1 count for the resolution of the capture)
+ */
+#define DSHOT_BIT_T_MIN    5
+#define DSHOT_BIT_T_MAX    16
+#define DSHOT_BIT_T_TOL_SH 2
+
+/*
+ * CRC of bidirectional DShot is inverted
+ */
+#if defined( DSHOT_TELEM )
+  #define DSHOT_CRC_INV    0x0F
+#else
+  #define DSHOT_CRC_INV    0
+#endif
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint16_t Dshot_value;      // 11-bit value of the last valid frame
+static uint8_t Dshot_new;         // valid frame since the last read
+static uint8_t Dshot_cmd;         // last command value
+static uint8_t Dshot_cmd_ct;      // consecutive frames of the command
+static uint16_t Dshot_frames;     // frames received (wraps)
+static uint16_t Dshot_errors;     // frames dropped (timing or CRC)
+static uint16_t Dshot_frame_t;    // bit period of the last valid frame
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * 1 if the high time is more than 9/16 of the bit period
+ */
+#define DSHOT_BIT( _HIGH_, _T_ )  (uint16_t)( ( (_HIGH_) << 4 ) > (_T_) * 9 )
+
+/*
+ * Check the CRC of a completed frame and post the value, returns TRUE if valid
+ */
+static uint8_t frame_decode(uint16_t frame, uint16_t bit_t)
+{
+    uint16_t v = frame >> 4;
+    uint8_t crc = (uint8_t)( ( v ^ ( v >> 4 ) ^ ( v >> 8 ) ^ DSHOT_CRC_INV ) & 0x0F );
+
+    if ( crc != (uint8_t)( frame & 0x0F ) )
+    {
+        Dshot_errors += 1;
+        return FALSE;
+    }
+
+    v >>= 1; // telemetry request bit is not used
+
+    if (v > DSHOT_CMD_MOTOR_STOP && v <= DSHOT_CMD_MAX)
+    {
+        if ( (uint8_t)v == Dshot_cmd )
+        {
+            if (Dshot_cmd_ct < DSHOT_CMD_REPEAT)
+            {
+                Dshot_cmd_ct += 1;
+            }
+        }
+        else
+        {
+            Dshot_cmd = (uint8_t)v;
+            Dshot_cmd_ct = 1;
+        }
+    }
+    else
+    {
+        Dshot_cmd_ct = 0;
+    }
+
+    // the reader (PWM edge ISR) preempts the capture ISR, the value is not new
+    // while it is written
+    Dshot_new = FALSE;
+    Dshot_value = v;
+    Dshot_frame_t = bit_t;
+    Dshot_new = TRUE;
+
+    return TRUE;
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Reset the decoder
+ */
+void Dshot_reset(void)
+{
+    Dshot_new = FALSE;
+    Dshot_value = DSHOT_CMD_MOTOR_STOP;
+    Dshot_cmd = 0;
+    Dshot_cmd_ct = 0;
+    Dshot_frames = 0;
+    Dshot_errors = 0;
+    Dshot_frame_t = 0;
+}
+
+/**
+ * @brief Decode a frame (capture ISR context)
+ *
+ * @details The frame period is set by the first bit, a frame that is
+ *  incomplete or has a bit period outside of the tolerance (glitch or missed
+ *  edge) is dropped. A bit is classified with the period to the start of the
+ *  next bit, the last bit with the period of the frame.
+ *
+ * @param pstart  Capture timestamps of the start (rising edge) of each bit
+ * @param pend    Capture timestamps of the end (falling edge) of each bit
+ * @param nr_bits Number of bits captured
+ *
+ * @return TRUE if the frame is valid
+ */
+uint8_t Dshot_on_frame(const uint16_t * pstart, const uint16_t * pend, uint8_t nr_bits)
+{
+    uint16_t shift = 0;
+    uint16_t bit_t;
+    uint16_t period;
+    uint16_t high;
+    uint8_t n;
+
+    Dshot_frames += 1;
+
+    if (DSHOT_FRAME_BITS != nr_bits)
+    {
+        Dshot_errors += 1; // incomplete frame
+        return FALSE;
+    }
+
+    // 16-bit counter wraps so no concern for sign of result
+    bit_t = pstart[ 1 ] - pstart[ 0 ];
+
+    if (bit_t < DSHOT_BIT_T_MIN || bit_t > DSHOT_BIT_T_MAX)
+    {
+        Dshot_errors += 1;
+        return FALSE;
+    }
+
+    for (n = 0; n < DSHOT_FRAME_BITS; n++)
+    {
+        period = bit_t;
+
+        if (n < DSHOT_FRAME_BITS - 1)
+        {
+            period = pstart[ n + 1 ] - pstart[ n ];
+
+            if ( period > bit_t + ( bit_t >> DSHOT_BIT_T_TOL_SH ) + 1 ||
+                 period < bit_t - ( bit_t >> DSHOT_BIT_T_TOL_SH ) - 1 )
+            {
+                Dshot_errors += 1; // glitch or missed edge
+                return FALSE;
+            }
+        }
+        high = pend[ n ] - pstart[ n ];
+        shift = ( shift << 1 ) | DSHOT_BIT( high, period );
+    }
+
+    return frame_decode( shift, bit_t );
+}
+
+/**
+ * @brief Read the value of the last valid frame
+ *
+ * @param pvalue  11-bit frame value
+ *
+ * @return TRUE if a new frame was received since the last call
+ */
+uint8_t Dshot_get_value(uint16_t * pvalue)
+{
+    uint8_t new_frame = Dshot_new;
+
+    Dshot_new = FALSE;
+    *pvalue = Dshot_value;
+
+    return new_frame;
+}
+
+/**
+ * @brief Read a command received in DSHOT_CMD_REPEAT consecutive frames
+ *
+ * @return The command, or 0 if none (a command is returned only once)
+ */
+uint8_t Dshot_get_command(void)
+{
+    if (Dshot_cmd_ct >= DSHOT_CMD_REPEAT)
+    {
+        Dshot_cmd_ct = 0;
+        return Dshot_cmd;
+    }
+    return 0;
+}
+
+/**
+ * @brief Detected bit rate (for display)
+ *
+ * @return 150 or 300 (kbit/s) from the bit period of the last valid frame, 0
+ *  if none
+ */
+uint16_t Dshot_get_rate(void)
+{
+    if (0 == Dshot_frame_t)
+    {
+        return 0;
+    }
+    return (Dshot_frame_t > ( DSHOT_BIT_T_150 + DSHOT_BIT_T_300 ) / 2) ? 150 : 300;
+}
+
+/**
+ * @brief Accessor for the count of received frames, valid or dropped
+ */
+uint16_t Dshot_get_frames(void)
+{
+    return Dshot_frames;
+}
+
+/**
+ * @brief Accessor for the count of dropped frames
+ */
+uint16_t Dshot_get_errors(void)
+{
+    return Dshot_errors;
+}
+
+#endif // DSHOT_INPUT
+
+/**@}*/ // defgroup
@@ -14,76 +14,28 @@
  */
 
 /* Includes ------------------------------------------------------------------*/
+#include <stddef.h> // NULL
 #include <string.h> // memset
 #include "faultm.h" // public types used internally
+#include "bldc_sm.h" // freeze-frame data
+#include "sequence.h"
 
 
 /* Private defines -----------------------------------------------------------*/
 
-/**
- * @brief  Initialization value for fault counter bucket.
- *
- * @details  The fault matrix defines the bucket as a 6-bits unsigned integer bit-field.
- *
- * @note  This value should be derived from the faultm update rate somehow - it is
- * expected that faulm_upd() would be called for all fault codes from within
- * the background task. Therefore the bucket counts and/or increment rates should
- * share a timing factor with the background task.
+/*
+ * The bucket rates are in counts per call of Faultm_upd(), which is expected
+ * to be called for all fault codes from within the background task (~60 Hz).
+ * A trip threshold of 48 counts with unit increment is about 0.8 seconds of
+ * continuously asserted fault condition.
  */
-#define  FAULT_BUCKET_BITS   6 // power of 2 ...  2^6==64
-
-// size limit of bucket - the fault is latched if the fault count reaches the limit
-#define  FAULT_BUCKET_MASK   ( ( 1 << FAULT_BUCKET_BITS ) - 1)  // 63 // 6-bits bit-field
-#define  FAULT_BUCKET_LIM     FAULT_BUCKET_MASK
-
-// INI must be <= Limit
-#define  FAULT_BUCKET_INI    (48 - 1)
+#define  FAULT_THRESH_DEF    48
 
-
-/**
- * @brief The fault status word is 8-bits wide.
- */
-#define NR_DEFINED_FAULTS  8
+#define  FAULT_BUCKET_MAX    U8_MAX
 
 
 /* Private types -----------------------------------------------------------*/
 
-/**
- * @brief Fault state - 1 bit
- *
- * Indicates that the fault condition has been detected frequently enough to
- * fill the bucket.
- */
-typedef enum
-{
-    FCLR = 0,
-    FSET = !FCLR
-} faultm_state_t;
-
-/**
- * @brief Indicate the fault is enabled - 1 bit
- */
-typedef enum
-{
-    DISABLED = 0,
-    ENABLED = !DISABLED
-} faultm_enable_t;
-
-/**
- * @brief Fault tracking table.
- *
- * @details  Compact table for tracking faults with leaky-bucket algorithm.
- *
- * @note  Fault matrix instantiated as an array of 8-bit words to save RAM.
- */
-typedef struct fault_matrix
-{
-    unsigned char bucket: FAULT_BUCKET_BITS; /**< bucket counter (6 bits). */
-    faultm_enable_t enabled: 1; /**< Enable bit. */
-    faultm_state_t state:  1; /**< Fault activation state. */
-
-} faultm_mat_t;
-
 
 /* Public variables  ---------------------------------------------------------*/
 
@@ -95,13 +47,63 @@ fault_status_reg_t fault_status_reg;
 
 /* Private variables ---------------------------------------------------------*/
 
-static faultm_mat_t fault_matrix[ NR_DEFINED_FAULTS ];
+/**
+ * @brief Fault descriptor table, indexed by faultm_ID_t
+ */
+static const faultm_desc_t Faultm_desc_table[ FAULTM_NR_FAULTS ] =
+{
+//   incr  decr  thresh            enabled
+    {  1,    1,  FAULT_THRESH_DEF, TRUE },  // FAULT_0
+    {  1,    1,  FAULT_THRESH_DEF, TRUE },  // FAULT_1
+    {  1,    1,  FAULT_THRESH_DEF, TRUE },  // VOLTAGE_NG
+    {  1,    1,  FAULT_THRESH_DEF, TRUE },  // THROTTLE_HI
+    {  4,    1,  FAULT_THRESH_DEF, TRUE },  // OVERCURRENT ... ~0.2 sec
+    { FAULT_THRESH_DEF,                     // STALL ... debounced by the
+             1,  FAULT_THRESH_DEF, TRUE },  // detector, trips at first update
+    { FAULT_THRESH_DEF,                     // SUPERVISOR ... latched by the
+             1,  FAULT_THRESH_DEF, TRUE },  // supervisor, trips at first update
+    { FAULT_THRESH_DEF,                     // SIGNAL_LOSS ... timed out in the
+             1,  FAULT_THRESH_DEF, TRUE }   // control frame, trips at first update
+};
+
+static uint8_t Faultm_bucket[ FAULTM_NR_FAULTS ];
+
+static fault_status_reg_t Faultm_enable_mask;
+
+/*
+ * History ring of freeze-frames, not cleared by Faultm_init() so that the
+ * record of the last trips survives a restart of the motor.
+ */
+static faultm_frame_t Faultm_history[ FAULTM_HIST_LEN ];
+static uint8_t Faultm_hist_head; // index of next record to write
+static uint8_t Faultm_hist_count;
 
 
 /* Private function prototypes -----------------------------------------------*/
 
 /* Private functions ---------------------------------------------------------*/
 
+/*
+ * Write a freeze-frame of the system state to the history ring
+ */
+static void freeze_frame(faultm_ID_t faultm_ID)
+{
+    faultm_frame_t * pframe = &Faultm_history[ Faultm_hist_head ];
+
+    pframe->fault_ID = (uint8_t)faultm_ID;
+    pframe->opstate = BL_get_opstate();
+    pframe->comm_period = BL_get_timing();
+    pframe->duty = BL_get_speed();
+    pframe->vbatt = Seq_Get_Vbatt();
+
+    Faultm_hist_head = (uint8_t)( ( Faultm_hist_head + 1 ) % FAULTM_HIST_LEN );
+
+    if (Faultm_hist_count < FAULTM_HIST_LEN)
+    {
+        Faultm_hist_count += 1;
+    }
+}
+
 
 /* Public functions ---------------------------------------------------------*/
 
@@ -112,17 +114,19 @@ static faultm_mat_t fault_matrix[ NR_DEFINED_FAULTS ];
  */
 void Faultm_init(void)
 {
-    int nnn;
+    uint8_t nnn;
 
-    // intialize fault matrix
-    memset(fault_matrix, 0, sizeof(fault_matrix) /* size in bytes */ );
+    // intialize fault buckets and enables
+    memset(Faultm_bucket, 0, sizeof(Faultm_bucket) /* size in bytes */ );
 
-//fault_matrix[VOLTAGE_NG ].enabled = 1;
-//fault_matrix[THROTTLE_HI ].enabled = 1;
+    Faultm_enable_mask = 0;
 
-    for (nnn= 0; nnn < NR_DEFINED_FAULTS; nnn++)
+    for (nnn = 0; nnn < FAULTM_NR_FAULTS; nnn++)
     {
-        fault_matrix[nnn].enabled = TRUE;
+        if (FALSE != Faultm_desc_table[nnn].enabled)
+        {
+            Faultm_enable_mask |= FAULTM_STATUS_BIT( nnn );
+        }
     }
 
 // reset the fault status bitmap
@@ -144,48 +148,54 @@ fault_status_reg_t Faultm_get_status(void)
 /**
  * @brief  Enable or disable triggering of specified fault.
  *
+ * @details The enable is reset to the default of the descriptor table by
+ *  Faultm_init().
+ *
  * @param  faultm_ID  Numerical ID of the fault to be configured.
  * @param  enable_b  boolean for the configured state - TRUE == fault enabled.
  */
 void Faultm_enable(faultm_ID_t faultm_ID, int enable_b)
 {
-// assert (fault_ID < MAX)
-
-// use a pointer to cleanup (and optimize away the array-access?)
-    faultm_mat_t * pfaultm  = &fault_matrix[ faultm_ID ];
-
-    pfaultm->enabled = enable_b;
+    if (faultm_ID < FAULTM_NR_FAULTS)
+    {
+        if (FALSE != enable_b)
+        {
+            Faultm_enable_mask |= FAULTM_STATUS_BIT( faultm_ID );
+        }
+        else
+        {
+            Faultm_enable_mask &= (fault_status_reg_t)~FAULTM_STATUS_BIT( faultm_ID );
+        }
+    }
 }
 
 /**
- * @brief Set the fault matrix bit and status word.
+ * @brief Set the fault status bit and record the freeze-frame.
  *
- * @note  A single fault shuts down the system, i.e. no need to flag/mask
- * multiple fault conditions.
+ * @details The freeze-frame is written only on the transition of the fault to
+ *  set. Faults are latched (cleared only by Faultm_init). Not reentrant, the
+ *  caller must not call from both ISR and background context.
  *
  * @param faultm_ID  Numerical ID of the fault to be set.
  */
 void Faultm_set(faultm_ID_t faultm_ID)
 {
-// assert (fault_ID < MAX)
-
-// use a pointer to cleanup (and optimize away the array-access?)
-    faultm_mat_t * pfaultm  = &fault_matrix[ faultm_ID ];
-
-//    fault_status_reg_t  mask = (1 << faultm_ID); // maybe ... not necessary for now
-    uint8_t  mask = (uint8_t) faultm_ID;
+    fault_status_reg_t  mask = FAULTM_STATUS_BIT( faultm_ID );
 
-    pfaultm->state =  (FALSE != pfaultm->enabled);
+    if (faultm_ID >= FAULTM_NR_FAULTS || 0 == (Faultm_enable_mask & mask))
+    {
+        return;
+    }
 
-// set bucket full ... wouldn't really need the "state" varaible
-    pfaultm->bucket = FAULT_BUCKET_INI;
+    if (0 == (fault_status_reg & mask))
+    {
+        freeze_frame(faultm_ID);
+    }
 
-    // note: OR allows multiple faults to be indicated in the status-word not that it
-    // makes much difference
-    fault_status_reg = mask; // |= mask;
+    // OR allows multiple faults to be indicated in the status-word
+    fault_status_reg |= mask;
 }
 
-
 /**
  * @brief Manage fault status with leaky bucket.
  * @param faultm_ID  Numerical ID of the fault to be set.
@@ -193,24 +203,29 @@ void Faultm_set(faultm_ID_t faultm_ID)
  */
 void Faultm_upd(faultm_ID_t faultm_ID, faultm_assert_t tcondition)
 {
-    // suspect that compiler clips the intermediate macro term out of range of 6-bit bitfield??
-    const uint8_t const_lmt_term = FAULT_BUCKET_INI; // FixMyMacro
+    const faultm_desc_t * pdesc;
+    uint8_t bucket;
 
-// assert (fault_ID < MAX)
-//    fault_status_reg_t  mask = (1 << faultm_ID); // maybe ... not necessary for now
-    fault_status_reg_t  mask = (fault_status_reg_t) faultm_ID;
+    if (faultm_ID >= FAULTM_NR_FAULTS)
+    {
+        return;
+    }
 
-// use a pointer to cleanup (and optimize away the array-access?)
-    faultm_mat_t * pfaultm  = &fault_matrix[ faultm_ID ];
+    pdesc = &Faultm_desc_table[ faultm_ID ];
+    bucket = Faultm_bucket[ faultm_ID ];
 
     if (tcondition)
     {
-        // if bucket < thr, then increment it else latch the fault
-        if ( pfaultm->bucket < const_lmt_term )
+        if ( bucket < (FAULT_BUCKET_MAX - pdesc->incr) )
         {
-            pfaultm->bucket += 1;
+            bucket += pdesc->incr;
         }
         else
+        {
+            bucket = FAULT_BUCKET_MAX;
+        }
+
+        if ( bucket >= pdesc->thresh )
         {
             // if the fault is enabled, then set it
             Faultm_set(faultm_ID);
@@ -218,15 +233,41 @@ void Faultm_upd(faultm_ID_t faultm_ID, faultm_assert_t tcondition)
     }
     else
     {
-        if ( pfaultm->bucket > 0 )
+        if ( bucket > pdesc->decr )
         {
-            pfaultm->bucket -= 1; // leaky bucket
+            bucket -= pdesc->decr; // leaky bucket
         }
         else
         {
-// shouldnt need to do anything here ... we don't clear faults (requires system reset)
+            bucket = 0; // we don't clear faults (requires system reset)
         }
     }
+
+    Faultm_bucket[ faultm_ID ] = bucket;
+}
+
+/**
+ * @brief Number of records in the fault history
+ */
+uint8_t Faultm_get_nr_history(void)
+{
+    return Faultm_hist_count;
+}
+
+/**
+ * @brief Accessor for the fault history
+ *
+ * @param  n  Record number, 0 is the most recent trip
+ * @return Pointer to the freeze-frame, NULL if there is no such record
+ */
+const faultm_frame_t * Faultm_get_history(uint8_t n)
+{
+    if (n >= Faultm_hist_count)
+    {
+        return NULL;
+    }
+    return &Faultm_history[
+        ( Faultm_hist_head + FAULTM_HIST_LEN - 1 - n ) % FAULTM_HIST_LEN ];
 }
 
 /**@}*/ // defgroup
@@ -0,0 +1,279 @@
+/**
+  ******************************************************************************
+  * @file hall.c
+  * @brief Hall-effect sensor rotor position and speed
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup hall Hall Sensor
+ * @brief Hall-effect sensor rotor position and speed
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "hall.h"
+#include "fixedpt.h" // STATIC_ASSERT
+
+#if defined( HALL_SENSOR )
+
+/* Private defines -----------------------------------------------------------*/
+
+#define HALL_NR_SECTORS  6
+
+/*
+ * Sector of the commutation sequence (sequence.c) with the sensor offset
+ */
+#define HALL_SECT( _N_ )  (uint8_t)( ( (_N_) + HALL_SECTOR_OFS ) % HALL_NR_SECTORS )
+
+STATIC_ASSERT( HALL_SECTOR_OFS < HALL_NR_SECTORS );
+STATIC_ASSERT( (uint32_t)HALL_WRAP_FRAMES * HALL_CT_PER_FRAME < HALL_PERIOD_MAX );
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+/*
+ * Hall state to sector lookup. With the sensors at 120 electrical degrees the
+ * states in the forward direction are 001, 011, 010, 110, 100, 101 - each
+ * state spans one 60 degree sector.
+ */
+static const uint8_t Hall_sector_table[ HALL_STATE_MASK + 1 ] =
+{
+    HALL_SECTOR_INVALID, // 000
+    HALL_SECT( 0 ),      // 001
+    HALL_SECT( 2 ),      // 010
+    HALL_SECT( 1 ),      // 011
+    HALL_SECT( 4 ),      // 100
+    HALL_SECT( 5 ),      // 101
+    HALL_SECT( 3 ),      // 110
+    HALL_SECTOR_INVALID  // 111
+};
+
+static uint8_t Hall_sector = HALL_SECTOR_INVALID;  // sector of the latest valid state
+static uint8_t Hall_invalid_ct;   // consecutive invalid states
+static uint8_t Hall_tm_valid;     // TRUE if Hall_edge_tm is the time of the last edge
+static uint16_t Hall_edge_tm;     // timestamp of the last edge
+static uint16_t Hall_idle_frames; // control frames since the last edge
+static uint8_t Hall_poll_sector = HALL_SECTOR_INVALID; // seen by the last poll only
+
+/*
+ * Edge intervals of the latest electrical revolution: the average over all
+ * six sectors cancels the placement error of the individual sensors.
+ */
+static uint16_t Hall_dt[ HALL_NR_SECTORS ];
+static uint32_t Hall_dt_sum;
+static uint16_t Hall_dt_last;
+static uint8_t Hall_dt_idx;
+static uint8_t Hall_nr_dt;        // intervals in the average (0:6)
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Discard the edge intervals, the next edge restarts the measurement
+ */
+static void restart(void)
+{
+    uint8_t n;
+
+    for (n = 0; n < HALL_NR_SECTORS; n++)
+    {
+        Hall_dt[n] = 0;
+    }
+    Hall_dt_sum = 0;
+    Hall_dt_idx = 0;
+    Hall_nr_dt = 0;
+    Hall_tm_valid = FALSE;
+}
+
+/*
+ * Validate a Hall state, returns the sector or HALL_SECTOR_INVALID
+ */
+static uint8_t lookup(uint8_t hall_state)
+{
+    uint8_t sector = Hall_sector_table[ hall_state & HALL_STATE_MASK ];
+
+    if (HALL_SECTOR_INVALID == sector)
+    {
+        if (Hall_invalid_ct < HALL_INVALID_MAX)
+        {
+            Hall_invalid_ct += 1;
+        }
+    }
+    else
+    {
+        Hall_invalid_ct = 0;
+    }
+    return sector;
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Clear the speed measurement and the fault conditions
+ *
+ * @details Called at motor reset (BL_reset). The sector is retained, the
+ *  position is known at any time from the sensors.
+ */
+void Hall_reset(void)
+{
+    restart();
+    Hall_invalid_ct = 0;
+    Hall_idle_frames = 0;
+    Hall_poll_sector = HALL_SECTOR_INVALID;
+}
+
+/**
+ * @brief Update from an edge of a sensor (ISR context)
+ *
+ * @details An edge to a different sector is the end of an edge interval, an
+ *  edge back to the same sector (noise, bounce) is ignored. The first edge
+ *  after a restart or after a sector found by the poll is not an interval.
+ *
+ * @param hall_state  Sensor inputs (HALL_STATE_MASK)
+ * @param tm          Timestamp of the edge, 0.5 us counts
+ *
+ * @return sector (0:5) to commutate, or HALL_SECTOR_INVALID
+ */
+uint8_t Hall_on_edge(uint8_t hall_state, uint16_t tm)
+{
+    uint8_t sector = lookup( hall_state );
+
+    if (HALL_SECTOR_INVALID != sector && sector != Hall_sector)
+    {
+        if (Hall_idle_frames >= HALL_WRAP_FRAMES)
+        {
+            restart(); // timestamp may have wrapped
+        }
+        else if (FALSE != Hall_tm_valid)
+        {
+            Hall_dt_last = tm - Hall_edge_tm;
+
+            Hall_dt_sum -= Hall_dt[ Hall_dt_idx ];
+            Hall_dt_sum += Hall_dt_last;
+            Hall_dt[ Hall_dt_idx ] = Hall_dt_last;
+            Hall_dt_idx = (uint8_t)( ( Hall_dt_idx + 1 ) % HALL_NR_SECTORS );
+
+            if (Hall_nr_dt < HALL_NR_SECTORS)
+            {
+                Hall_nr_dt += 1;
+            }
+        }
+
+        Hall_sector = sector;
+        Hall_edge_tm = tm;
+        Hall_tm_valid = TRUE;
+        Hall_idle_frames = 0;
+    }
+    return sector;
+}
+
+/**
+ * @brief Update at the control frame (~1 ms)
+ *
+ * @details Counts the time since the last edge and polls the sensors, so the
+ *  sector is known at power-up and after a missed edge. The edge interrupt
+ *  does not preempt the control frame, so a sector that differs from the
+ *  latest edge may be an edge still pending: it is taken as a missed edge
+ *  only if it is seen by 2 consecutive polls. The speed measurement is kept,
+ *  only the interval of the next edge (spanning the missed one) is skipped.
+ *
+ * @param hall_state  Sensor inputs (HALL_STATE_MASK)
+ *
+ * @return sector (0:5) to commutate if the poll found a missed edge, or
+ *  HALL_SECTOR_INVALID
+ */
+uint8_t Hall_on_frame(uint8_t hall_state)
+{
+    uint8_t sector = lookup( hall_state );
+
+    if (Hall_idle_frames < HALL_STALL_FRAMES)
+    {
+        Hall_idle_frames += 1;
+    }
+
+    if (HALL_SECTOR_INVALID == sector || sector == Hall_sector)
+    {
+        Hall_poll_sector = HALL_SECTOR_INVALID;
+        return HALL_SECTOR_INVALID;
+    }
+
+    // the sector at power-up is taken at once
+    if (sector != Hall_poll_sector && HALL_SECTOR_INVALID != Hall_sector)
+    {
+        Hall_poll_sector = sector;
+        return HALL_SECTOR_INVALID;
+    }
+
+    Hall_poll_sector = HALL_SECTOR_INVALID;
+    Hall_sector = sector;
+    Hall_tm_valid = FALSE;
+
+    return sector;
+}
+
+/**
+ * @brief Accessor for the rotor position
+ *
+ * @return sector (0:5) of the latest valid Hall state, HALL_SECTOR_INVALID if
+ *  none yet
+ */
+uint8_t Hall_get_sector(void)
+{
+    return Hall_sector;
+}
+
+/**
+ * @brief Sector period from the edge intervals
+ *
+ * @details Average over the latest electrical revolution, or the latest
+ *  interval until a revolution is measured. The time since the last edge is
+ *  the lower bound, so the period follows a motor slowing down or stalled.
+ *  The 0.5 us timestamp of the sector period is the unit of the commutation
+ *  timer period (BL_set_timing).
+ *
+ * @return sector period, 0.5 us counts, HALL_PERIOD_MAX if not measured
+ */
+uint16_t Hall_get_period(void)
+{
+    uint32_t perd;
+    uint32_t elapsed = (uint32_t)Hall_idle_frames * HALL_CT_PER_FRAME;
+
+    if (0 == Hall_nr_dt)
+    {
+        return HALL_PERIOD_MAX;
+    }
+
+    perd = (HALL_NR_SECTORS == Hall_nr_dt) ?
+           Hall_dt_sum / HALL_NR_SECTORS : Hall_dt_last;
+
+    if (elapsed > perd)
+    {
+        perd = elapsed;
+    }
+    if (perd > HALL_PERIOD_MAX)
+    {
+        perd = HALL_PERIOD_MAX;
+    }
+    return (uint16_t)perd;
+}
+
+/**
+ * @brief Accessor for the sensor status
+ *
+ * @return TRUE if the sensors are faulted (invalid states) or the rotor did
+ *  not move for HALL_STALL_FRAMES since the reset
+ */
+uint8_t Hall_get_status(void)
+{
+    return (uint8_t)( Hall_invalid_ct >= HALL_INVALID_MAX ||
+                      Hall_idle_frames >= HALL_STALL_FRAMES );
+}
+
+#endif // HALL_SENSOR
+
+/**@}*/ // defgroup
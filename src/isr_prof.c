@@ -0,0 +1,149 @@
+/**
+  ******************************************************************************
+  * @file isr_prof.c
+  * @brief ISR latency and execution-time profiling (optional instrumentation)
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup isr_prof ISR Profiling
+ * @brief ISR latency and execution-time profiling (optional instrumentation)
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h> // memset
+#include "isr_prof.h"
+
+#if defined( ISR_PROFILE )
+
+/* Private defines -----------------------------------------------------------*/
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static prof_hist_t Prof_hist[ PROF_NR_HIST ];
+
+static const char * const Prof_names[ PROF_NR_HIST ] =
+{
+    "PWM exec",
+    "PWM lat ",
+    "COMM exec",
+    "COMM lat ",
+    "ADC exec",
+    "CS exec ",
+    "SRV exec"
+};
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Duration at or below which 99% of the samples fall, i.e. the upper bound of
+ * the bin where the cumulative count reaches 99%.
+ */
+static uint16_t get_p99(const prof_hist_t * phist)
+{
+    uint32_t total = 0;
+    uint32_t cumulative = 0;
+    uint8_t n;
+
+    for (n = 0; n < PROF_NR_BINS; n++)
+    {
+        total += phist->bins[ n ];
+    }
+
+    for (n = 0; n < (PROF_NR_BINS - 1); n++)
+    {
+        cumulative += phist->bins[ n ];
+
+        if ( (cumulative * 100) >= (total * 99) )
+        {
+            return (uint16_t)( ( 1u << n ) - 1 );
+        }
+    }
+    return phist->max; // in the last (open) bin
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Add a duration to a histogram
+ *
+ * @details Called from ISR context, or with interrupts disabled.
+ *
+ * @param id  Histogram ID
+ * @param duration  Duration in the units of the histogram
+ */
+void Prof_record(prof_id_t id, uint16_t duration)
+{
+    prof_hist_t * phist = &Prof_hist[ id ];
+    uint16_t u16 = duration;
+    uint8_t bin = 0;
+
+    // bin is the bit-length of the duration
+    while (u16 > 0 && bin < (PROF_NR_BINS - 1))
+    {
+        u16 >>= 1;
+        bin += 1;
+    }
+
+    if (phist->bins[ bin ] < U16_MAX)
+    {
+        phist->bins[ bin ] += 1;
+    }
+
+    if (duration > phist->max)
+    {
+        phist->max = duration;
+    }
+}
+
+/**
+ * @brief Clear all histograms
+ *
+ * @details Expect to be called from non-ISR context with interrupts disabled.
+ */
+void Prof_reset(void)
+{
+    memset( Prof_hist, 0, sizeof(Prof_hist) );
+}
+
+/**
+ * @brief Print the histograms to the serial terminal and clear them
+ *
+ * @note NOT appropriate in either an ISR or critical section because printf to
+ *  serial terminal is blocking. Each histogram is copied in a short CS.
+ */
+void Prof_println(void)
+{
+    uint8_t id;
+    uint8_t n;
+
+    for (id = 0; id < PROF_NR_HIST; id++)
+    {
+        prof_hist_t hist;
+
+        disableInterrupts();
+        hist = Prof_hist[ id ];
+        memset( &Prof_hist[ id ], 0, sizeof(prof_hist_t) );
+        enableInterrupts();
+
+        printf("%s max=%04X p99<=%04X :", Prof_names[ id ], hist.max, get_p99( &hist ));
+
+        for (n = 0; n < PROF_NR_BINS; n++)
+        {
+            printf(" %X", hist.bins[ n ]);
+        }
+        printf("\r\n");
+    }
+}
+
+#endif // ISR_PROFILE
+
+/**@}*/ // defgroup
@@ -20,6 +20,11 @@
 #include "mcu_stm8s.h"
 #include "bldc_sm.h"
 #include "per_task.h"
+#include "thr_shape.h"
+#include "sched.h"
+#include "superv.h"
+#include "pstore.h"
+#include "rccal.h"
 
 
 #ifdef _SDCC_
@@ -51,7 +56,18 @@ void main(int argc, char **argv)
 
   BL_reset();
 
+#if defined( HAS_SERVO_INPUT )
+  Rccal_init(); // servo throttle range (parameter store is loaded by MCU_Init)
+
+  Thr_shape_init();
+#endif
+
+  Sched_init();
+
+  Superv_init(); // starts the watchdog
+
   printf("\n\rProgram Startup.......\n\r");
+  printf("Params: %s\n\r", (FALSE != Pstore_is_loaded()) ? "EEPROM" : "defaults");
 
   enableInterrupts(); // interrupts are globally disabled by default
 
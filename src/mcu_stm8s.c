@@ -17,6 +17,7 @@
 
 // app headers
 #include "pwm_stm8s.h" // pwm timer channels
+#include "pstore.h"
 
 /* Private defines -----------------------------------------------------------*/
 /**
@@ -33,6 +34,63 @@
 #define SDC_PORT  SDc_SD_PORT
 #define SDC_PIN   SDc_SD_PIN
 
+#if defined( HALL_SENSOR )
+// Hall sensors A, B, C on 3 consecutive pins from HALL_GPIO_SH
+#define HALL_GPIO_PINS  (uint8_t)( 0x07 << HALL_GPIO_SH )
+#endif
+
+#if defined( BEMF_COMPARATOR )
+// Input capture filter of the comparator output, 4 samples at fMASTER/2
+#define ZCP_IC_FILTER   3
+#endif
+
+#if defined( HAS_SERVO_INPUT ) && defined( DSHOT_INPUT )
+// Servo capture channels of the rising (direct) and falling (indirect) edge
+#if defined( S105_DEV )
+  #define SRV_TIM        TIM2
+  #define SRV_RISE_IF    TIM2_SR1_CC1IF
+  #define SRV_RISE_OF    TIM2_SR2_CC1OF
+  #define SRV_RISE_CCRH  CCR1H
+  #define SRV_RISE_CCRL  CCR1L
+  #define SRV_FALL_IF    TIM2_SR1_CC2IF
+  #define SRV_FALL_OF    TIM2_SR2_CC2OF
+  #define SRV_FALL_CCRH  CCR2H
+  #define SRV_FALL_CCRL  CCR2L
+#elif defined( S105_DISCOVERY )
+  #define SRV_TIM        TIM1
+  #define SRV_RISE_IF    TIM1_SR1_CC4IF
+  #define SRV_RISE_OF    TIM1_SR2_CC4OF
+  #define SRV_RISE_CCRH  CCR4H
+  #define SRV_RISE_CCRL  CCR4L
+  #define SRV_FALL_IF    TIM1_SR1_CC3IF
+  #define SRV_FALL_OF    TIM1_SR2_CC3OF
+  #define SRV_FALL_CCRH  CCR3H
+  #define SRV_FALL_CCRL  CCR3L
+#endif
+
+// a DShot bit starts at the rising edge, inverted (bidirectional) at the falling
+#if defined( DSHOT_TELEM )
+  #define SRV_START_IF    SRV_FALL_IF
+  #define SRV_START_CCRH  SRV_FALL_CCRH
+  #define SRV_START_CCRL  SRV_FALL_CCRL
+  #define SRV_END_IF      SRV_RISE_IF
+  #define SRV_END_CCRH    SRV_RISE_CCRH
+  #define SRV_END_CCRL    SRV_RISE_CCRL
+#else
+  #define SRV_START_IF    SRV_RISE_IF
+  #define SRV_START_CCRH  SRV_RISE_CCRH
+  #define SRV_START_CCRL  SRV_RISE_CCRL
+  #define SRV_END_IF      SRV_FALL_IF
+  #define SRV_END_CCRH    SRV_FALL_CCRH
+  #define SRV_END_CCRL    SRV_FALL_CCRL
+#endif
+
+// read a capture, high byte first (reading the low byte clears the flag)
+#define SRV_GET_CAPTURE( _V_, _CCRH_, _CCRL_ )   \
+  _V_ = (uint16_t)SRV_TIM->_CCRH_ << 8;          \
+  _V_ |= SRV_TIM->_CCRL_;
+#endif
+
 /**
  * @brief Forward declarations of low-level term IO functions 
  * Low-level access to support terminal IO on an available stm8s UART. Based on
@@ -224,6 +282,17 @@ static void GPIO_Config(void)
 // AIN0 (back-EMF sensor): Input floating, no external interrupt
   GPIO_Init(PH0_BEMF_IN_PORT, (GPIO_Pin_TypeDef)PH0_BEMF_IN_PIN, GPIO_MODE_IN_FL_NO_IT);
 
+#if defined( PH1_BEMF_IN_PORT )
+// AIN1, AIN2 (back-EMF sensor phase B, C): Input floating, no external interrupt
+  GPIO_Init(PH1_BEMF_IN_PORT, (GPIO_Pin_TypeDef)PH1_BEMF_IN_PIN, GPIO_MODE_IN_FL_NO_IT);
+  GPIO_Init(PH2_BEMF_IN_PORT, (GPIO_Pin_TypeDef)PH2_BEMF_IN_PIN, GPIO_MODE_IN_FL_NO_IT);
+#endif
+
+#if defined( HAS_CURRENT_SENSE )
+// AIN4 (current-sense amplifier): Input floating, no external interrupt
+  GPIO_Init(CURR_SENSE_IN_PORT, (GPIO_Pin_TypeDef)CURR_SENSE_IN_PIN, GPIO_MODE_IN_FL_NO_IT);
+#endif
+
 #if defined( HAS_SERVO_INPUT )
 // Input pull-up, no external interrupt
   GPIO_Init(SERVO_GPIO_PORT, (GPIO_Pin_TypeDef)SERVO_GPIO_PIN, GPIO_MODE_IN_PU_NO_IT);
@@ -232,6 +301,18 @@ static void GPIO_Config(void)
 // Input pull-up, no external interrupt
   GPIO_Init(PH0_BEMF_IN_PORT, (GPIO_Pin_TypeDef)PH0_BEMF_IN_PIN, GPIO_MODE_IN_PU_NO_IT);
 
+#if defined( HALL_SENSOR )
+// Hall sensors (open-collector): Input pull-up, external interrupt on both edges
+  GPIO_Init(HALL_GPIO_PORT, (GPIO_Pin_TypeDef)HALL_GPIO_PINS, GPIO_MODE_IN_PU_IT);
+  EXTI_SetExtIntSensitivity(HALL_EXTI_PORT, EXTI_SENSITIVITY_RISE_FALL);
+#endif
+
+#if defined( BEMF_COMPARATOR )
+// back-EMF comparator mux select: Output push-pull
+  GPIO_Init(CMP_SEL0_PORT, (GPIO_Pin_TypeDef)CMP_SEL0_PIN, GPIO_MODE_OUT_PP_LOW_FAST);
+  GPIO_Init(CMP_SEL1_PORT, (GPIO_Pin_TypeDef)CMP_SEL1_PIN, GPIO_MODE_OUT_PP_LOW_FAST);
+#endif
+
 #if defined ( S105_DEV )
 
 #elif defined( S105_DISCOVERY )
@@ -301,6 +382,13 @@ static void UART_setup(void)
 #else
 #define ADC_DIVIDER ADC1_PRESSEL_FCPU_D2  // 4 ->  8/2 = 4
 #endif
+/*
+ * Scan of AIN0, AIN1, AIN2 (phase A, B, C dividers) and AIN3, 4 conversions
+ * take ~14 us. The scan always starts from channel 0, so the current-sense
+ * channel (AIN4) is not in the scan but converted on its own ahead of it at
+ * the PWM edge, which keeps it in the PWM on window down to ~6% duty-cycle.
+ */
+#define ADC_SCAN_LAST  ADC1_CHANNEL_3  // i.e. Ch 0, 1, 2, and 3 are enabled
 /*
  * https://community.st.com/s/question/0D50X00009XkbA1SAJ/multichannel-adc
  */
@@ -311,7 +399,7 @@ static void ADC1_setup(void)
   ADC1_DeInit();
 
   ADC1_Init(ADC1_CONVERSIONMODE_SINGLE, // don't care, see ConversionConfig below ..
-            ADC1_CHANNEL_3,        // i.e. Ch 0, 1, 2, and 3 are enabled
+            ADC_SCAN_LAST,
             ADC_DIVIDER,
             ADC1_EXTTRIG_TIM,      //  ADC1_EXTTRIG_GPIO ... not presently using any ex triggern
             DISABLE,               // ExtTriggerState
@@ -321,6 +409,9 @@ static void ADC1_setup(void)
 
   ADC1_ITConfig(ADC1_IT_EOCIE, ENABLE); // grab the sample in the ISR
 
+// The scan stores each channel in its data buffer register, all are read in
+// the EOC ISR. DBUF (buffered continuous mode) is not needed as the scan is
+// started at each PWM edge.
 //ADC1_DataBufferCmd(ENABLE);
   ADC1_ScanModeCmd(ENABLE); // Scan mode from channel 0 to n (as defined in ADC1_Init)
 
@@ -331,6 +422,26 @@ static void ADC1_setup(void)
   ADC1_StartConversion(); // i.e. for scanning mode only has to start once ...
 }
 
+#if defined( HAS_CURRENT_SENSE )
+/**
+ * @brief  Select a single conversion of the current-sense channel (AIN4).
+ */
+void MCU_adc_select_curr(void)
+{
+  ADC1->CR2 &= (uint8_t)~ADC1_CR2_SCAN;
+  ADC1->CSR = (uint8_t)( ADC1_CSR_EOCIE | ADC1_CHANNEL_4 ); // clears EOC
+}
+
+/**
+ * @brief  Select the scan of channels 0 to ADC_SCAN_LAST.
+ */
+void MCU_adc_select_scan(void)
+{
+  ADC1->CSR = (uint8_t)( ADC1_CSR_EOCIE | ADC_SCAN_LAST );
+  ADC1->CR2 |= ADC1_CR2_SCAN;
+}
+#endif
+
 /**
  * S003 did not have available timer for servo input ... 105 boards should have
  * a spare timer available, but not necessarily the same peripheral instance .
@@ -409,12 +520,30 @@ static void Servo_CC_setup(void)
               ICFilter
              );
 
+#if defined( BEMF_COMPARATOR )
+// back-EMF comparator on CH3 (A3), interrupt enabled per sector (MCU_zcp_select)
+  TIM2_ICInit(TIM2_CHANNEL_3,
+              TIM2_ICPOLARITY_RISING,
+              TIM2_ICSELECTION_DIRECTTI,
+              TIM2_ICPSC_DIV1,
+              ZCP_IC_FILTER
+             );
+#endif
+
 // timer update/ovrflow ISR not strictly needed but is handy to confirm timer rate
 //  TIM2_ITConfig(TIM2_IT_UPDATE, ENABLE);
 
 // enable capture channels
+#if defined( DSHOT_INPUT ) && defined( DSHOT_TELEM )
+// one interrupt per DShot frame at the first (falling) edge, inverted DShot
+  TIM2_ITConfig(TIM2_IT_CC2, ENABLE);
+#elif defined( DSHOT_INPUT )
+// one interrupt per DShot frame at the first (rising) edge
+  TIM2_ITConfig(TIM2_IT_CC1, ENABLE);
+#else
   TIM2_ITConfig(TIM2_IT_CC1, ENABLE);
   TIM2_ITConfig(TIM2_IT_CC2, ENABLE);
+#endif
 
   TIM2_Cmd(ENABLE);
 }
@@ -455,18 +584,66 @@ static void Servo_CC_setup(void)
               ICFilter
              );
 
+#if defined( BEMF_COMPARATOR )
+// back-EMF comparator on CH1 (C1), interrupt enabled per sector (MCU_zcp_select)
+  TIM1_ICInit(TIM1_CHANNEL_1,
+              TIM1_ICPOLARITY_RISING,
+              TIM1_ICSELECTION_DIRECTTI,
+              TIM1_ICPSC_DIV1,
+              ZCP_IC_FILTER
+             );
+#endif
+
 // timer update/ovrflow ISR not strictly needed but is handy to confirm timer rate
 //  TIM1_ITConfig(TIM1_IT_UPDATE, ENABLE); // be sure flag is cleared in ISR!
 
 // enable capture channels 3 & 4
+#if defined( DSHOT_INPUT ) && defined( DSHOT_TELEM )
+// one interrupt per DShot frame at the first (falling) edge, inverted DShot
+  TIM1_ITConfig(TIM1_IT_CC3, ENABLE);
+#elif defined( DSHOT_INPUT )
+// one interrupt per DShot frame at the first (rising) edge
+  TIM1_ITConfig(TIM1_IT_CC4, ENABLE);
+#else
   TIM1_ITConfig(TIM1_IT_CC4, ENABLE);
   TIM1_ITConfig(TIM1_IT_CC3, ENABLE);
+#endif
 
   TIM1_Cmd(ENABLE);
 }
 #endif // S105 DISCOVERY
 #endif // HAS_SERVO_INP
 
+#if defined( HAS_SERVO_INPUT ) && defined( DSHOT_INPUT )
+/*
+ * Software priority of an interrupt vector (ITC_SPRx, RM0016): 2 bits per
+ * vector, 4 vectors per register. Writable only with interrupts disabled.
+ */
+static void itc_set_priority(uint8_t irq, uint8_t level)
+{
+  volatile uint8_t * pspr = &ITC->ISPR1 + (irq >> 2);
+  uint8_t sh = (uint8_t)( (irq & 3) << 1 );
+
+  *pspr = (uint8_t)( ( *pspr & (uint8_t)~( 3 << sh ) ) | ( level << sh ) );
+}
+
+/*
+ * The servo capture ISR polls the DShot frame and sends the telemetry reply
+ * (up to ~140 us at DShot150), so it is set to the lowest level and the
+ * commutation, PWM and ADC ISRs (default level 3) preempt it. A preemption
+ * longer than a bit period drops the frame (overcapture) or stretches a bit of
+ * the reply, which the receiver drops by the CRC.
+ */
+static void ITC_setup(void)
+{
+#if defined( S105_DEV )
+  itc_set_priority( ITC_IRQ_TIM2_CAPCOM, ITC_PRIORITYLEVEL_1 );
+#elif defined( S105_DISCOVERY )
+  itc_set_priority( ITC_IRQ_TIM1_CAPCOM, ITC_PRIORITYLEVEL_1 );
+#endif
+}
+#endif // DSHOT_INPUT
+
 /*
  * commutation timer on TIM1 or TIM3 depending on the specific stm8s part
  */
@@ -501,6 +678,25 @@ void MCU_set_comm_timer(uint16_t period)
   TIM3->CR1 |= TIM3_CR1_CEN; // Enable TIM3
 }
 
+/**
+ * @brief  Count of the commutation timer i.e. time since the update event.
+ */
+uint16_t MCU_get_comm_timer_count(void)
+{
+  return TIM3_GetCounter();
+}
+
+/**
+ * @brief  Load the count of the commutation timer i.e. phase the next update
+ *  event to (period - count) from now.
+ * @param  count  Value written to the counter register
+ */
+void MCU_set_comm_timer_count(uint16_t count)
+{
+  TIM3->CNTRH = (uint8_t)(count >> 8); // be sure to set byte CNTRH first
+  TIM3->CNTRL = (uint8_t)(count & 0xff);
+}
+
 #elif defined( S003_DEV ) // uses TIM1 which is not preferred
 
 /**
@@ -528,7 +724,367 @@ void MCU_set_comm_timer(uint16_t period)
   TIM1->CR1 = TIM1_CR1_ARPE; // auto (re)loading the count
   TIM1->CR1 |= TIM1_CR1_CEN; // Enable timer
 }
+
+/**
+ * @brief  Count of the commutation timer i.e. time since the update event.
+ */
+uint16_t MCU_get_comm_timer_count(void)
+{
+  return TIM1_GetCounter();
+}
+
+void MCU_set_comm_timer_count(uint16_t count)
+{
+  TIM1->CNTRH = (uint8_t)(count >> 8);
+  TIM1->CNTRL = (uint8_t)(count & 0xff);
+}
+#endif
+
+/*
+ * Independent watchdog timeout: 2 * Tlsi * P * R = 2 / 128kHz * 128 * 255, about
+ * 0.5 seconds (RM0016). Long enough for the blocking printf in the background
+ * task.
+ */
+#define IWDG_PRESCALER  IWDG_Prescaler_128
+#define IWDG_RELOAD     0xFF
+
+/**
+ * @brief  Start the independent watchdog.
+ * @details  Once started the IWDG can not be stopped (except by reset).
+ */
+void MCU_wdg_init(void)
+{
+  IWDG->KR = IWDG_KEY_ENABLE; // start the watchdog (LSI is enabled by hardware)
+
+  IWDG->KR = (uint8_t)IWDG_WriteAccess_Enable; // unlock PR and RLR
+  IWDG->PR = (uint8_t)IWDG_PRESCALER;
+  IWDG->RLR = IWDG_RELOAD;
+
+  IWDG->KR = IWDG_KEY_REFRESH; // load the counter, also locks PR/RLR again
+}
+
+/**
+ * @brief  Reload the independent watchdog counter.
+ */
+void MCU_wdg_kick(void)
+{
+  IWDG->KR = IWDG_KEY_REFRESH;
+}
+
+/*
+ * Data EEPROM: word programming time is ~6 ms (tPROG), the timeout of the wait
+ * for end of programming is a generous loop count.
+ */
+#define EEPROM_BASE_ADDR     FLASH_DATA_START_PHYSICAL_ADDRESS
+#define EEPROM_WAIT_LOOPS    0xFFFF
+
+/*
+ * Wait for a flag in FLASH_IAPSR, returns 0 if set within the timeout
+ */
+static uint8_t eeprom_wait(uint8_t flag)
+{
+  uint16_t timeout = EEPROM_WAIT_LOOPS;
+
+  while ( 0 == (FLASH->IAPSR & flag) )
+  {
+    if (0 == --timeout)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief  Read from data EEPROM (memory mapped).
+ * @param  offset  Offset into data EEPROM
+ * @param  pbuf  Destination
+ * @param  len  Number of bytes
+ */
+void MCU_eeprom_read(uint16_t offset, uint8_t * pbuf, uint8_t len)
+{
+  const uint8_t * psrc = (const uint8_t *)( EEPROM_BASE_ADDR + offset );
+
+  while (len-- > 0)
+  {
+    *pbuf++ = *psrc++;
+  }
+}
+
+/**
+ * @brief  Write to data EEPROM.
+ * @details  Uses word programming (4 bytes per programming cycle), the offset
+ *  and length must be multiples of 4. Blocks until programming is complete.
+ * @param  offset  Offset into data EEPROM
+ * @param  pbuf  Source
+ * @param  len  Number of bytes
+ * @return  0 if ok, else programming timed out
+ */
+uint8_t MCU_eeprom_write(uint16_t offset, const uint8_t * pbuf, uint8_t len)
+{
+  volatile uint8_t * pdst = (volatile uint8_t *)( EEPROM_BASE_ADDR + offset );
+  uint8_t rc = 0;
+
+  // unlock the data EEPROM (MASS keys in reverse order for DUKR, RM0016)
+  FLASH->DUKR = FLASH_RASS_KEY2;
+  FLASH->DUKR = FLASH_RASS_KEY1;
+
+  if ( 0 != eeprom_wait( FLASH_IAPSR_DUL ) )
+  {
+    return 1;
+  }
+
+  while (len >= 4 && 0 == rc)
+  {
+    FLASH->CR2 |= FLASH_CR2_WPRG;
+    FLASH->NCR2 &= (uint8_t)( ~FLASH_NCR2_NWPRG );
+
+    pdst[0] = pbuf[0];
+    pdst[1] = pbuf[1];
+    pdst[2] = pbuf[2];
+    pdst[3] = pbuf[3];
+
+    rc = eeprom_wait( FLASH_IAPSR_EOP );
+
+    pdst += 4;
+    pbuf += 4;
+    len -= 4;
+  }
+
+  FLASH->IAPSR &= (uint8_t)( ~FLASH_IAPSR_DUL ); // lock
+
+  return rc;
+}
+
+/**
+ * @brief  Free-running timestamp for execution time measurement.
+ * @details  Reads the counter of the servo input capture timer which is left
+ *  free running (period 0xFFFF) at 0.5 us per count. There is no spare timer
+ *  on the S003 so the timestamp is always 0.
+ * @return  Timer count
+ */
+uint16_t MCU_get_timestamp(void)
+{
+#if defined( HAS_SERVO_INPUT ) && defined( S105_DEV )
+  return TIM2_GetCounter();
+#elif defined( HAS_SERVO_INPUT ) && defined( S105_DISCOVERY )
+  return TIM1_GetCounter();
+#else
+  return 0;
+#endif
+}
+
+#if defined( HALL_SENSOR )
+/**
+ * @brief  Read the Hall sensor inputs.
+ * @return  Hall state, sensor A in bit 0, B in bit 1, C in bit 2
+ */
+uint8_t MCU_get_hall_state(void)
+{
+  return (uint8_t)( ( HALL_GPIO_PORT->IDR & HALL_GPIO_PINS ) >> HALL_GPIO_SH );
+}
+#endif
+
+#if defined( BEMF_COMPARATOR )
+/**
+ * @brief  Arm the back-EMF comparator capture for the sector.
+ * @details  Selects the comparator of the floating phase on the mux and the
+ *  edge of the zero-crossing, discards a stale capture and enables the
+ *  capture interrupt.
+ * @param  phase  Floating phase (0:2)
+ * @param  rising  TRUE if the floating phase voltage rises through the neutral
+ */
+void MCU_zcp_select(uint8_t phase, uint8_t rising)
+{
+  if (0 != (phase & 0x01))
+  {
+    CMP_SEL0_PORT->ODR |= CMP_SEL0_PIN;
+  }
+  else
+  {
+    CMP_SEL0_PORT->ODR &= (uint8_t)~CMP_SEL0_PIN;
+  }
+  if (0 != (phase & 0x02))
+  {
+    CMP_SEL1_PORT->ODR |= CMP_SEL1_PIN;
+  }
+  else
+  {
+    CMP_SEL1_PORT->ODR &= (uint8_t)~CMP_SEL1_PIN;
+  }
+
+#if defined( S105_DEV )
+  if (FALSE != rising)
+  {
+    TIM2->CCER2 &= (uint8_t)~TIM2_CCER2_CC3P;
+  }
+  else
+  {
+    TIM2->CCER2 |= TIM2_CCER2_CC3P;
+  }
+  TIM2->SR1 = (uint8_t)~TIM2_SR1_CC3IF;
+  TIM2->IER |= TIM2_IER_CC3IE;
+#elif defined( S105_DISCOVERY )
+  if (FALSE != rising)
+  {
+    TIM1->CCER1 &= (uint8_t)~TIM1_CCER1_CC1P;
+  }
+  else
+  {
+    TIM1->CCER1 |= TIM1_CCER1_CC1P;
+  }
+  TIM1->SR1 = (uint8_t)~TIM1_SR1_CC1IF;
+  TIM1->IER |= TIM1_IER_CC1IE;
+#endif
+}
+
+/**
+ * @brief  Disable the back-EMF comparator capture interrupt until the next
+ *  sector.
+ */
+void MCU_zcp_disable(void)
+{
+#if defined( S105_DEV )
+  TIM2->IER &= (uint8_t)~TIM2_IER_CC3IE;
+#elif defined( S105_DISCOVERY )
+  TIM1->IER &= (uint8_t)~TIM1_IER_CC1IE;
+#endif
+}
+
+/**
+ * @brief  Timestamp of the latest back-EMF comparator edge.
+ * @return  Captured count of the timestamp timer
+ */
+uint16_t MCU_get_zcp_capture(void)
+{
+#if defined( S105_DEV )
+  return TIM2_GetCapture3();
+#else
+  return TIM1_GetCapture1();
+#endif
+}
+#endif // BEMF_COMPARATOR
+
+#if defined( HAS_SERVO_INPUT ) && defined( DSHOT_INPUT )
+/**
+ * @brief  Capture the edges of a DShot frame on the servo input.
+ * @details  Called in the capture ISR at the first edge of the frame, the
+ *  captures of the following bits are polled (the bit period of a few us is
+ *  too short for an interrupt per bit). Each capture is read within one bit
+ *  period of its edge: the start edge before the start of the next bit and the
+ *  end edge before the end of the next bit. The frame ends at nr_bits, or if no
+ *  edge is captured within the timeout. An edge that was overwritten before it
+ *  was read (the ISR was held off by a higher priority interrupt) drops the
+ *  frame. The capture flags are cleared on return.
+ * @param  pstart  Start edge of each bit, timestamp counts
+ * @param  pend  End edge of each bit, timestamp counts
+ * @param  nr_bits  Number of bits in the frame
+ * @param  timeout  Time without an edge that ends the frame, timestamp counts
+ * @return Number of bits captured, 0 if an edge was missed
+ */
+uint8_t MCU_servo_capture_frame(uint16_t * pstart, uint16_t * pend, uint8_t nr_bits, uint16_t timeout)
+{
+  uint16_t t_edge = MCU_get_timestamp();
+  uint8_t n = 0;
+
+  while (n < nr_bits)
+  {
+    while ( 0 == ( SRV_TIM->SR1 & SRV_START_IF ) )
+    {
+      if ( (uint16_t)( MCU_get_timestamp() - t_edge ) > timeout )
+      {
+        nr_bits = n; // gap, end of frame
+        break;
+      }
+    }
+    if (n == nr_bits)
+    {
+      break;
+    }
+    SRV_GET_CAPTURE( pstart[ n ], SRV_START_CCRH, SRV_START_CCRL );
+    t_edge = pstart[ n ];
+
+    while ( 0 == ( SRV_TIM->SR1 & SRV_END_IF ) )
+    {
+      if ( (uint16_t)( MCU_get_timestamp() - t_edge ) > timeout )
+      {
+        nr_bits = n;
+        break;
+      }
+    }
+    if (n == nr_bits)
+    {
+      break;
+    }
+    SRV_GET_CAPTURE( pend[ n ], SRV_END_CCRH, SRV_END_CCRL );
+    n += 1;
+  }
+
+  if ( 0 != ( SRV_TIM->SR2 & ( SRV_RISE_OF | SRV_FALL_OF ) ) )
+  {
+    n = 0; // overcapture
+  }
+  SRV_TIM->SR1 = (uint8_t)~( SRV_RISE_IF | SRV_FALL_IF );
+  SRV_TIM->SR2 = 0;
+
+  return n;
+}
+#endif // DSHOT_INPUT
+
+#if defined( HAS_SERVO_INPUT ) && defined( DSHOT_TELEM )
+/**
+ * @brief  Send a reply on the servo input pin (bidirectional DShot).
+ * @details  Called in the capture ISR at the end of the received frame and
+ *  blocks until the reply is sent (~90 us at DShot300, the GCR bit period of
+ *  2.7 us is too short for a compare interrupt per bit). The capture ISR is at
+ *  the lowest priority (ITC_setup) so the commutation, PWM and ADC ISRs are not
+ *  held off by the reply. The bit boundaries are timed by polling the
+ *  timestamp (0.5 us), the pin is driven push-pull from the idle high level and
+ *  released to the input afterwards. The captures of the own edges are
+ *  discarded.
+ * @param  line  Line levels, right-aligned, sent MSB first
+ * @param  nr_bits  Number of bits
+ * @param  t_start  Timestamp of the first bit
+ * @param  bit_t_q4  Bit period, timestamp counts Q4
+ */
+void MCU_servo_pin_send(uint32_t line, uint8_t nr_bits, uint16_t t_start, uint16_t bit_t_q4)
+{
+  uint32_t mask = (uint32_t)1 << (nr_bits - 1);
+  uint16_t t_q4 = 0;
+
+  while ( (int16_t)( MCU_get_timestamp() - t_start ) < 0 ); // gap after the frame
+
+  SERVO_GPIO_PORT->ODR |= SERVO_GPIO_PIN;
+  SERVO_GPIO_PORT->DDR |= SERVO_GPIO_PIN; // output push-pull (CR1 set as pull-up input)
+
+  while (0 != mask)
+  {
+    if (0 != (line & mask))
+    {
+      SERVO_GPIO_PORT->ODR |= SERVO_GPIO_PIN;
+    }
+    else
+    {
+      SERVO_GPIO_PORT->ODR &= (uint8_t)~SERVO_GPIO_PIN;
+    }
+    mask >>= 1;
+    t_q4 += bit_t_q4;
+
+    while ( (uint16_t)( MCU_get_timestamp() - t_start ) < ( ( t_q4 + 8 ) >> 4 ) );
+  }
+
+  SERVO_GPIO_PORT->ODR |= SERVO_GPIO_PIN; // back to idle before release
+  SERVO_GPIO_PORT->DDR &= (uint8_t)~SERVO_GPIO_PIN;
+
+#if defined( S105_DEV )
+  TIM2->SR1 = (uint8_t)~( TIM2_SR1_CC1IF | TIM2_SR1_CC2IF );
+  TIM2->SR2 = 0; // overcapture
+#elif defined( S105_DISCOVERY )
+  TIM1->SR1 = (uint8_t)~( TIM1_SR1_CC3IF | TIM1_SR1_CC4IF );
+  TIM1->SR2 = 0;
 #endif
+}
+#endif // DSHOT_TELEM
 
 /*
  * http://embedded-lab.com/blog/starting-stm8-microcontrollers/13/
@@ -646,9 +1202,15 @@ void MCU_Init(void)
   Servo_CC_setup();
 #endif
 
+#if defined( HAS_SERVO_INPUT ) && defined( DSHOT_INPUT )
+  ITC_setup(); // interrupts are disabled until the end of init
+#endif
+
 #if SPI_ENABLED
   SPI_setup();
 #endif
+
+  Pstore_init(); // tuning parameters from EEPROM (or defaults)
 }
 
 /**@}*/ // defgroup
@@ -17,6 +17,7 @@
 
 #include "pwm_stm8s.h"
 #include "mdata.h"
+#include "pstore.h" // calibrated timing breakpoints
 
 
 // table size originated from 250 step PWM confiugration
@@ -35,6 +36,21 @@
 #define MDATA_TBL_INDEX_PCNT_SCALE( _index_ ) \
                                      ( _index_ / PWM_PERIOD_SCALAR )
 
+/**
+ * @brief Reciprocal of the calibration voltage (Q20), computed by the compiler
+ * @details duty-cycle (10 bits) * Vbatt (10 bits) * reciprocal (11 bits) fits
+ *  in 32 bits.
+ */
+#define MDATA_VCAL_RECIP_SH  20
+#define MDATA_VCAL_RECIP     (uint32_t)( ( 1UL << MDATA_VCAL_RECIP_SH ) / MDATA_VCAL_COUNTS )
+
+/*
+ * Limits of plausible Vbatt measurement for compensation (1/2 to 2x the
+ * calibration voltage). Outside the range, the timing is not compensated.
+ */
+#define MDATA_VCOMP_MIN      ( MDATA_VCAL_COUNTS / 2 )
+#define MDATA_VCOMP_MAX      ( MDATA_VCAL_COUNTS * 2 )
+
 /*
  * The table is indexed by PWM duty cycle counts (i.e. [0:1:250)
  * The function generates the data in Scilab and imported from csv.
@@ -122,6 +138,45 @@ static const uint16_t OL_Timing[ /* TABLE_SIZE */ ] =
 
 #define OL_TIMING_TBL_SIZE    ( sizeof(OL_Timing) / sizeof(uint16_t) )
 
+// greatest duty-cycle (nominal PWM counts) that indexes the table
+#define OL_TIMING_DC_MAX      ( OL_TIMING_TBL_SIZE * PWM_PERIOD_SCALAR - 1 )
+
+
+/*
+ * Interpolate the calibrated breakpoints. Outside of the calibrated range the
+ * end segments are extrapolated, the result is limited to half the period of
+ * the last breakpoint (not reachable by the table index in practice).
+ */
+static uint16_t ol_timing_bp(const uint16_t * pbp, uint16_t dutycycle)
+{
+    uint8_t n = 0;
+    int32_t t32;
+
+    if (dutycycle > MDATA_OL_BP_DC0)
+    {
+        n = (uint8_t)( ( dutycycle - MDATA_OL_BP_DC0 ) / MDATA_OL_BP_DC_STEP );
+
+        if (n > MDATA_OL_NR_BP - 2)
+        {
+            n = MDATA_OL_NR_BP - 2;
+        }
+    }
+
+    t32 = (int32_t)pbp[ n ] +
+          ( ( (int32_t)pbp[ n + 1 ] - pbp[ n ] ) *
+            ( (int32_t)dutycycle - MDATA_OL_BP_DC( n ) ) ) / MDATA_OL_BP_DC_STEP;
+
+    if (t32 < (int32_t)( pbp[ MDATA_OL_NR_BP - 1 ] >> 1 ))
+    {
+        t32 = pbp[ MDATA_OL_NR_BP - 1 ] >> 1;
+    }
+    else if (t32 >= U16_MAX)
+    {
+        t32 = U16_MAX - 1;
+    }
+    return (uint16_t)t32;
+}
+
 
 /**
  * @brief Table lookup for open-loop commutation timing
@@ -129,6 +184,12 @@ static const uint16_t OL_Timing[ /* TABLE_SIZE */ ] =
  *   The table definition depends on the PWM duty-cycle being 250 steps.
  *   PWM now had 1024 steps so the macro is used to rescale it to lookup the
  *   commutation timing.
+ *   The index is the duty-cycle in counts of the nominal PWM period, which
+ *   is independent of the PWM period band presently loaded to the timer (the
+ *   PWM module rescales the duty-cycle to the active period).
+ *
+ *   If the motor has been calibrated (olcal.c) the breakpoints from the
+ *   parameter store are interpolated instead of the table.
  *
  * @param table_index Index into the table
  *
@@ -145,9 +206,82 @@ uint16_t Get_OL_Timing(uint16_t table_index)
     // assert index < OL_TIMING_TBL_SIZE
     if ( index < OL_TIMING_TBL_SIZE )
     {
-        t16 = OL_Timing[ index ] * CTIME_SCALAR;
+        const uint16_t * pbp = Pstore_get()->ol_bp;
+
+        if (0 != pbp[ 0 ])
+        {
+            t16 = ol_timing_bp( pbp, table_index );
+        }
+        else
+        {
+            t16 = OL_Timing[ index ] * CTIME_SCALAR;
+        }
     }
     return t16;
 }
 
+/**
+ * @brief Open-loop commutation timing compensated for supply voltage
+ * @details
+ *   Motor speed is proportional to the applied voltage i.e. duty-cycle * Vbatt,
+ *   so the table index is the duty-cycle that would give the same applied
+ *   voltage at the calibration voltage:
+ *
+ *     index = dutycycle * Vbatt / Vcal
+ *
+ *   The divide is by the constant reciprocal of Vcal.
+ *
+ * @param dutycycle  PWM duty-cycle in counts of the nominal period
+ * @param vbatt  Measured supply voltage (ADC counts), 0 if not available
+ *
+ * @return Commutation period expressed in timer counts
+ */
+uint16_t Get_OL_Timing_Vcomp(uint16_t dutycycle, uint16_t vbatt)
+{
+    uint32_t u32;
+
+    if (vbatt > MDATA_VCOMP_MIN && vbatt < MDATA_VCOMP_MAX)
+    {
+        u32 = ( (uint32_t)dutycycle * vbatt * MDATA_VCAL_RECIP ) >> MDATA_VCAL_RECIP_SH;
+
+        // a higher voltage may put the compensated index off the end of the table
+        if (u32 > OL_TIMING_DC_MAX)
+        {
+            u32 = OL_TIMING_DC_MAX;
+        }
+        dutycycle = (uint16_t)u32;
+    }
+    return Get_OL_Timing( dutycycle );
+}
+
+/**
+ * @brief Duty-cycle giving the applied voltage of a duty-cycle at the
+ *  calibration voltage (inverse of the compensation of Get_OL_Timing_Vcomp)
+ *
+ *     dutycycle = dutycycle_cal * Vcal / Vbatt
+ *
+ * @details Used by the calibration once per breakpoint, so the divide is
+ *  acceptable.
+ *
+ * @param dutycycle_cal  PWM duty-cycle at the calibration voltage
+ * @param vbatt  Measured supply voltage (ADC counts), 0 if not available
+ *
+ * @return PWM duty-cycle in counts of the nominal period
+ */
+uint16_t Get_OL_Dutycycle_Vcomp(uint16_t dutycycle_cal, uint16_t vbatt)
+{
+    uint32_t u32 = dutycycle_cal;
+
+    if (vbatt > MDATA_VCOMP_MIN && vbatt < MDATA_VCOMP_MAX)
+    {
+        u32 = ( u32 * MDATA_VCAL_COUNTS ) / vbatt;
+
+        if (u32 > PWM_PERIOD_COUNTS)
+        {
+            u32 = PWM_PERIOD_COUNTS;
+        }
+    }
+    return (uint16_t)u32;
+}
+
 /**@}*/ // defgroup
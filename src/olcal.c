@@ -0,0 +1,303 @@
+/**
+  ******************************************************************************
+  * @file olcal.c
+  * @brief Calibration of the open-loop commutation timing
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup olcal OL Timing Calibration
+ * @brief Calibration of the open-loop commutation timing
+ *
+ * @details The built-in timing table (model.h) was fit for one motor at one
+ *  voltage. The calibration sweeps the duty-cycle over the breakpoints of the
+ *  timing curve (mdata.h) with the motor running open-loop, and at each step
+ *  servos the commutation period on the timing error until it is balanced. The
+ *  balanced period is the breakpoint. The result goes to the parameter store,
+ *  from where it replaces the table in Get_OL_Timing.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "olcal.h"
+#include "pstore.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+/*
+ * The timing error (Seq_get_timing_error, 1/64 units) is limited and filtered
+ * with a 1/8 smoothing factor, in Q4 to keep the precision of small errors.
+ */
+#define OLCAL_ERR_MAX        256
+#define OLCAL_ERR_Q_SH       4
+#define OLCAL_ERR_FILT       8
+
+/*
+ * Servo of the commutation period: the period is stepped by the filtered error
+ * (Q4) / OLCAL_SERVO_DIV per control frame, the remainder is carried so that a
+ * small error still moves the period. The gain is low compared to the update
+ * rate of the error (once per electrical revolution).
+ */
+#define OLCAL_SERVO_DIV      64
+
+/*
+ * The error and the period are averaged over windows of 256 frames. The step
+ * is balanced when the average error of a window is within 1/64, and the
+ * breakpoint is then the average period of the window.
+ */
+#define OLCAL_WIN_SH         8
+#define OLCAL_ERR_BAL        1
+
+/*
+ * Each step must balance within 8 seconds, so the sweep takes under a minute.
+ */
+#define OLCAL_STEP_TIMEOUT   8000
+
+/*
+ * Limits of the commutation period in the servo, the lower limit is well above
+ * the supervisor overrun threshold.
+ */
+#define OLCAL_PERIOD_MIN     0x0100
+#define OLCAL_PERIOD_MAX     ( U16_MAX - 1 )
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static olcal_status_t Olcal_status;
+
+static uint8_t Olcal_step;       // breakpoint index
+static uint16_t Olcal_dc;        // duty-cycle applied in the sweep
+static uint16_t Olcal_dc_tgt;    // duty-cycle of the present breakpoint
+static uint16_t Olcal_frames;    // control frames in the present step
+static uint16_t Olcal_win_ct;    // frames in the averaging window
+static int32_t Olcal_err_sum;    // sum of the error over the window
+static uint32_t Olcal_sum;       // sum of the period over the window
+static int16_t Olcal_err_q;      // filtered timing error, Q4
+static int16_t Olcal_servo_acc;  // servo remainder
+
+static uint16_t Olcal_bp[ MDATA_OL_NR_BP ];
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Start a step, the duty-cycle of the breakpoint is compensated for the supply
+ * voltage so the breakpoints are at the calibration voltage.
+ */
+static void step_start(uint8_t step, uint16_t vbatt)
+{
+    Olcal_step = step;
+    Olcal_dc_tgt = Get_OL_Dutycycle_Vcomp( MDATA_OL_BP_DC( step ), vbatt );
+    Olcal_frames = 0;
+    Olcal_win_ct = 0;
+    Olcal_err_sum = 0;
+    Olcal_sum = 0;
+}
+
+/*
+ * Fit the measured breakpoints: the period must decrease with increasing
+ * duty-cycle, a measured period that is longer than the one of the previous
+ * breakpoint (noise on a flat part of the curve) is taken as equal to it.
+ * Returns FALSE if the sweep did not speed up the motor at all.
+ */
+static uint8_t fit_breakpoints(void)
+{
+    uint8_t n;
+
+    for (n = 1; n < MDATA_OL_NR_BP; n++)
+    {
+        if (Olcal_bp[ n ] > Olcal_bp[ n - 1 ])
+        {
+            Olcal_bp[ n ] = Olcal_bp[ n - 1 ];
+        }
+    }
+    return (uint8_t)( Olcal_bp[ MDATA_OL_NR_BP - 1 ] < Olcal_bp[ 0 ] );
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Request a calibration
+ *
+ * @details The sweep starts at the next control frame with the motor running
+ *  in open-loop. The throttle must stay above the shutoff while the sweep is
+ *  in progress.
+ */
+void Olcal_start(void)
+{
+    if (OLCAL_RUN != Olcal_status)
+    {
+        Olcal_status = OLCAL_PENDING;
+    }
+}
+
+/**
+ * @brief Abort a sweep in progress (motor stopped or reset)
+ *
+ * @details A pending request is kept, it starts with the next motor start.
+ */
+void Olcal_abort(void)
+{
+    if (OLCAL_RUN == Olcal_status)
+    {
+        Olcal_status = OLCAL_FAILED;
+    }
+}
+
+/**
+ * @brief Update the sweep (control frame, ISR context)
+ *
+ * @details Called at each control frame in the open-loop state. While the
+ *  sweep is in progress, the duty-cycle and commutation period are set by the
+ *  calibration.
+ *
+ * @param pdutycycle  Duty-cycle, in: commanded, out: of the sweep
+ * @param pcomm_period  Commutation period, in: present, out: of the sweep
+ * @param timing_err  Timing error, positive if advanced
+ * @param vbatt  Measured supply voltage (ADC counts), 0 if not available
+ *
+ * @return TRUE if the duty-cycle and period are set by the sweep
+ */
+uint8_t Olcal_update(uint16_t * pdutycycle, uint16_t * pcomm_period,
+                     int16_t timing_err, uint16_t vbatt)
+{
+    int32_t t32;
+
+    if (OLCAL_PENDING == Olcal_status)
+    {
+        Olcal_status = OLCAL_RUN;
+        Olcal_dc = *pdutycycle;
+        Olcal_err_q = 0;
+        Olcal_servo_acc = 0;
+        step_start( 0, vbatt );
+    }
+
+    if (OLCAL_RUN != Olcal_status)
+    {
+        return FALSE;
+    }
+
+    if (++Olcal_frames > OLCAL_STEP_TIMEOUT)
+    {
+        Olcal_status = OLCAL_FAILED; // open-loop resumes at the commanded speed
+        return FALSE;
+    }
+
+    // duty-cycle is ramped to the breakpoint so the motor stays in sync
+    if (Olcal_dc < Olcal_dc_tgt)
+    {
+        Olcal_dc += 1;
+    }
+    else if (Olcal_dc > Olcal_dc_tgt)
+    {
+        Olcal_dc -= 1;
+    }
+
+    if (timing_err > OLCAL_ERR_MAX)
+    {
+        timing_err = OLCAL_ERR_MAX;
+    }
+    else if (timing_err < -OLCAL_ERR_MAX)
+    {
+        timing_err = -OLCAL_ERR_MAX;
+    }
+    Olcal_err_q += ( (int16_t)( timing_err * ( 1 << OLCAL_ERR_Q_SH ) ) - Olcal_err_q ) / OLCAL_ERR_FILT;
+
+    // advanced timing (positive error) is corrected by a longer period
+    Olcal_servo_acc += Olcal_err_q;
+    t32 = (int32_t)*pcomm_period + Olcal_servo_acc / OLCAL_SERVO_DIV;
+    Olcal_servo_acc %= OLCAL_SERVO_DIV;
+
+    if (t32 < OLCAL_PERIOD_MIN)
+    {
+        t32 = OLCAL_PERIOD_MIN;
+    }
+    else if (t32 > OLCAL_PERIOD_MAX)
+    {
+        t32 = OLCAL_PERIOD_MAX;
+    }
+
+    *pdutycycle = Olcal_dc;
+    *pcomm_period = (uint16_t)t32;
+
+    if (Olcal_dc != Olcal_dc_tgt)
+    {
+        return TRUE; // duty-cycle still ramping
+    }
+
+    Olcal_err_sum += timing_err;
+    Olcal_sum += (uint16_t)t32;
+
+    if (++Olcal_win_ct >= ( 1 << OLCAL_WIN_SH ))
+    {
+        if ( Olcal_err_sum < ( (int32_t)OLCAL_ERR_BAL << OLCAL_WIN_SH ) &&
+             Olcal_err_sum > -( (int32_t)OLCAL_ERR_BAL << OLCAL_WIN_SH ) )
+        {
+            Olcal_bp[ Olcal_step ] = (uint16_t)( Olcal_sum >> OLCAL_WIN_SH );
+
+            if (Olcal_step < MDATA_OL_NR_BP - 1)
+            {
+                step_start( Olcal_step + 1, vbatt );
+            }
+            else
+            {
+                Olcal_status = ( FALSE != fit_breakpoints() ) ? OLCAL_DONE : OLCAL_FAILED;
+            }
+        }
+        else
+        {
+            // not balanced, start a new window (the step timeout still runs)
+            Olcal_win_ct = 0;
+            Olcal_err_sum = 0;
+            Olcal_sum = 0;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Accessor for calibration status
+ */
+olcal_status_t Olcal_get_status(void)
+{
+    return Olcal_status;
+}
+
+/**
+ * @brief Accessor for the calibrated breakpoints (valid if OLCAL_DONE)
+ */
+const uint16_t * Olcal_get_breakpoints(void)
+{
+    return Olcal_bp;
+}
+
+/**
+ * @brief Copy the calibrated breakpoints to the parameters in RAM
+ *
+ * @details Takes effect immediately in the timing lookup, the parameters are
+ *  written to EEPROM by Pstore_save.
+ */
+void Olcal_apply(void)
+{
+    pstore_params_t params;
+    uint8_t n;
+
+    if (OLCAL_DONE == Olcal_status)
+    {
+        params = *Pstore_get();
+
+        for (n = 0; n < MDATA_OL_NR_BP; n++)
+        {
+            params.ol_bp[ n ] = Olcal_bp[ n ];
+        }
+        Pstore_set( &params );
+
+        Olcal_status = OLCAL_IDLE;
+    }
+}
+
+/**@}*/ // defgroup
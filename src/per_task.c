@@ -25,6 +25,20 @@
 #include "driver.h"
 #include "spi_stm8s.h"
 #include "pdu_manager.h"
+#include "thr_shape.h"
+#include "brake.h"
+#include "curr_sense.h"
+#include "stall.h"
+#include "superv.h"
+#include "pstore.h"
+#include "olcal.h"
+#include "dshot.h"
+#include "rcin.h"
+#include "rccal.h"
+#include "hall.h"
+#include "zcp.h"
+#include "sched.h"
+#include "isr_prof.h"
 
 
 /* Private defines -----------------------------------------------------------*/
@@ -39,21 +53,9 @@
  * The UI motor speed is for now scaled to the range of the PWM period in 
  * clock counts i.e. (0:250) .. this is due to being used as the timing table index.
  */
-#define UI_MSPEED_PCNT_SCALE  512.0  // 0.002% per bit ... note use power of 2 scale factor
+#define UI_MSPEED_PCNT_SCALE  512  // 0.002% per bit ... note use power of 2 scale factor
 
 
-// Threshold is set low enuogh that the machine doesn't stall
-// thru the lower speed transition into closed-loop control.
-// The fault can be tested by letting the spinning prop disc strike a flimsy
-// obstacle like a 3x5 index card.
-#if defined ( S105_DEV )
-//  Vcc==3.3v  33k/10k @ Vbatt==12.4v
-  #define V_SHUTDOWN_THR      0x02C0    // experimentally determined @ 12.4v
-#else
-  // applies presently only to the stm8s-Discovery, at 14.2v and ADCref == 5v
-  #define V_SHUTDOWN_THR      0x02C0    // experimentally determined!
-#endif
-
 
 //#define ANLG_SLIDER
 
@@ -67,6 +69,15 @@ static void spd_plus(void);
 static void spd_minus(void);
 static void m_stop(void);
 static void m_start(void);
+static void brk_mode(void);
+static void brk_level(void);
+static void sched_stats(void);
+static void fault_hist(void);
+static void param_save(void);
+static void ol_calib(void);
+#if defined( ISR_PROFILE )
+static void isr_prof(void);
+#endif
 
 
 /* Public variables  ---------------------------------------------------------*/
@@ -89,6 +100,13 @@ typedef enum
   M_START     = '/', // /
   SPD_PLUS    = '.', // >
   SPD_MINUS   = ',', // <
+  BRK_MODE    = 'b',
+  BRK_LEVEL   = 'B',
+  SCHED_STATS = 'T',
+  FAULT_HIST  = 'F',
+  PARAM_SAVE  = 'W',
+  OL_CALIB    = 'K',
+  ISR_PROF    = 'H',
   K_UNDEFINED = -1
 } 
 ui_keycode_t;
@@ -106,9 +124,18 @@ ui_key_handler_t;
 
 /* Private variables ---------------------------------------------------------*/
 
-static uint8_t TaskRdy; // flag for timer interrupt for BG task timing
 static uint8_t Log_Level;
+static uint8_t Sched_dump; // request to print the scheduler statistics
+static uint8_t Fault_dump; // request to print the fault history
+static uint8_t Param_save; // request to write the parameters to EEPROM
+#if defined( ISR_PROFILE )
+static uint8_t Prof_dump;  // request to print the ISR profile histograms
+#endif
+#ifdef ANLG_SLIDER
+static uint16_t Analog_slider; // slider input (0:255)
+#endif
 static uint16_t Vsystem;
+static uint16_t Isystem; // average motor current
 static uint16_t UI_Speed; // motor percent speed input from servo or remote UI 
 
 /**
@@ -123,7 +150,16 @@ static const ui_key_handler_t ui_keyhandlers_tb[] =
   {SPD_PLUS,   spd_plus},
   {SPD_MINUS,  spd_minus},
   {M_STOP,     m_stop},
-  {M_START,    m_start}	
+  {M_START,    m_start},
+  {BRK_MODE,   brk_mode},
+  {BRK_LEVEL,  brk_level},
+  {SCHED_STATS, sched_stats},
+  {FAULT_HIST, fault_hist},
+  {PARAM_SAVE, param_save},
+  {OL_CALIB,   ol_calib},
+#if defined( ISR_PROFILE )
+  {ISR_PROF,   isr_prof}
+#endif
 };
 
 // macros to help make the LUT slightly more encapsulated
@@ -148,11 +184,14 @@ static void Log_println(int zrof)
   uint16_t ui_speed = UI_Speed;
   uint16_t bl_speed = BL_get_speed(); 
   uint16_t timing_error = Seq_get_timing_error();
+  uint16_t zcp_error = Seq_get_zcp_error();
   uint16_t comm_period = BL_get_timing();
 //  uint16_t servo_pulse_period = Driver_get_pulse_perd();
   uint16_t servo_pulse_duration = Driver_get_pulse_dur();
   uint16_t display_speed_pcnt = (uint16_t)Driver_get_motor_spd_pcnt();
   uint16_t servo_posn_counts = Driver_get_servo_position_counts();
+  int brake_mode = (int)Brake_get_mode();
+  uint16_t brake_level = Brake_get_level();
 
   // if flag is set then reset line counter
   if ( 0 != zrof)
@@ -164,11 +203,11 @@ static void Log_println(int zrof)
   if ( Log_Level > 0)
   {
     printf(
-      "{%04X) UIspd%=%X CtmCt=%04X BLdc=%04X Vs=%04X Sflt=%X RCsigCt=%04X MspdCt=%u Mspd%=%u ERR=%04X \r\n",
+      "{%04X) UIspd%=%X CtmCt=%04X BLdc=%04X Vs=%04X Is=%04X Sflt=%X RCsigCt=%04X MspdCt=%u Mspd%=%u ERR=%04X ZCP=%04X Brk=%X BrkL=%04X \r\n",
       Line_Count++,  // increment line countet
-      ui_speed, comm_period, bl_speed, Vsystem, faults, 
+      ui_speed, comm_period, bl_speed, Vsystem, Isystem, faults, 
       servo_pulse_duration, servo_posn_counts, display_speed_pcnt,
-      timing_error
+      timing_error, zcp_error, brake_mode, brake_level
     );
      Log_Level -= 1;
   }
@@ -188,15 +227,33 @@ static void Log_println(int zrof)
  *
  * The standard RC framerate is 50 Hz or 20 mS. With pertask is updating at 60Hz, 
  * then the timely response of the system should be assured. 
+ *
+ * The commanded speed is passed through the throttle shaping stage which is
+ * evaluated in the control frame (deadband, curve and slew-rate limit).
  */
 static void ui_set_motor_spd(uint16_t ui_motor_speed)
 {	
 #ifdef ANLG_SLIDER
-  uint16_t adc_tmp16 = ADC1_GetBufferValue( ADC1_CHANNEL_3 ); // ISR safe ... hmmmm
-  Analog_slider = adc_tmp16 / 4; // [ 0: 1023 ] -> [ 0: 255 ]
+  driver_adc_scan_t scan;
+
+  Driver_get_adc_scan( &scan ); // consistent copy of the latest scan
+  Analog_slider = scan.slider / 4; // [ 0: 1023 ] -> [ 0: 255 ]
 #endif
 
-    BL_set_speed( ui_motor_speed );
+#if defined( DSHOT_INPUT )
+  // digital throttle is passed to the shaping stage by the control frame
+  (void)ui_motor_speed;
+#elif defined( HAS_SERVO_INPUT )
+  // RC pulse throttle is passed to the shaping stage by the control frame once
+  // the pulse protocol is detected
+  if (RCIN_NONE == Rcin_get_protocol())
+  {
+    // shaping and rate-limiting of the commanded speed is done in the control frame
+    Thr_shape_set_input( ui_motor_speed );
+  }
+#else
+  Thr_shape_set_input( ui_motor_speed );
+#endif
 }
 
 /*
@@ -231,6 +288,7 @@ static void m_stop(void)
   BL_reset();
 
   UI_Speed = 0;
+  Thr_shape_reset(); // no ramp-down, stop now
 
   printf("###\r\n");
 
@@ -263,6 +321,197 @@ static void spd_minus(void)
   Log_Level = 1;
 }
 
+/*
+ * request the scheduler statistics, printed outside of the CS
+ */
+static void sched_stats(void)
+{
+  Sched_dump = TRUE;
+}
+
+/*
+ * request the fault history, printed outside of the CS
+ */
+static void fault_hist(void)
+{
+  Fault_dump = TRUE;
+}
+
+/*
+ * request to save the parameters, written outside of the CS (blocking)
+ */
+static void param_save(void)
+{
+  Param_save = TRUE;
+}
+
+/*
+ * request calibration of the open-loop timing, the sweep starts when the motor
+ * is running open-loop
+ */
+static void ol_calib(void)
+{
+  Olcal_start();
+}
+
+#if defined( ISR_PROFILE )
+/*
+ * request the ISR profile histograms, printed (and cleared) outside of the CS
+ */
+static void isr_prof(void)
+{
+  Prof_dump = TRUE;
+}
+#endif
+
+/*
+ * print the scheduler statistics (not in a CS, printf is blocking)
+ */
+static void Sched_println(void)
+{
+  uint8_t n;
+
+  for (n = 0; n < Sched_get_nr_tasks(); n++)
+  {
+    sched_stats_t stats;
+
+    disableInterrupts();
+    stats = *Sched_get_stats(n); // copy shared with ISR
+    enableInterrupts();
+
+    printf("Task%u runs=%04X miss=%04X exec=%04X max=%04X\r\n",
+           (unsigned int)n, stats.runs, stats.misses, stats.exec_last, stats.exec_max);
+  }
+
+#if defined( DSHOT_INPUT )
+  {
+    uint16_t frames, errors;
+
+    disableInterrupts();
+    frames = Dshot_get_frames(); // shared with the capture ISR
+    errors = Dshot_get_errors();
+    enableInterrupts();
+
+    printf("DShot%u frames=%04X drop=%04X\r\n",
+           Dshot_get_rate(), frames, errors);
+  }
+#endif
+}
+
+/*
+ * print the fault history freeze-frames, most recent first
+ */
+static void Faultm_println(void)
+{
+  uint8_t n;
+
+  for (n = 0; n < Faultm_get_nr_history(); n++)
+  {
+    const faultm_frame_t * pframe = Faultm_get_history(n);
+
+    printf("Flt%u id=%u ops=%u CT=%04X DC=%04X Vs=%04X\r\n",
+           (unsigned int)n, (unsigned int)pframe->fault_ID,
+           (unsigned int)pframe->opstate, pframe->comm_period,
+           pframe->duty, pframe->vbatt);
+  }
+}
+
+/*
+ * report the progress of the timing calibration (not in a CS, printf is
+ * blocking). The result is applied and saved once the motor is stopped.
+ */
+static void Olcal_println(void)
+{
+  static olcal_status_t prev_status = OLCAL_IDLE;
+  olcal_status_t status = Olcal_get_status();
+
+  if (status != prev_status)
+  {
+    prev_status = status;
+
+    printf("OL cal: %u\r\n", (unsigned int)status);
+
+    if (OLCAL_DONE == status)
+    {
+      const uint16_t * pbp = Olcal_get_breakpoints();
+      uint8_t n;
+
+      for (n = 0; n < MDATA_OL_NR_BP; n++)
+      {
+        printf("BP%u DC=%04X CT=%04X\r\n",
+               (unsigned int)n, (unsigned int)MDATA_OL_BP_DC(n), pbp[n]);
+      }
+    }
+  }
+
+  if (OLCAL_DONE == status && BL_NOT_RUNNING == BL_get_state())
+  {
+    Olcal_apply();
+    Param_save = TRUE;
+  }
+}
+
+#if defined( HAS_SERVO_INPUT ) && !defined( DSHOT_INPUT )
+/*
+ * report the progress of the throttle range calibration, the range is
+ * applied and saved once it is measured (the throttle is held at zero)
+ */
+static void Rccal_println(void)
+{
+  static rccal_status_t prev_status = RCCAL_IDLE;
+  rccal_status_t status = Rccal_get_status();
+
+  if (status != prev_status)
+  {
+    prev_status = status;
+
+    printf("RC cal: %u\r\n", (unsigned int)status);
+
+    if (RCCAL_DONE == status)
+    {
+      uint16_t lo, hi;
+
+      Rccal_get_range( &lo, &hi );
+      printf("RC range: %04X %04X\r\n", lo, hi);
+    }
+  }
+
+  if (RCCAL_DONE == status && BL_NOT_RUNNING == BL_get_state())
+  {
+    Rccal_apply();
+    Param_save = TRUE;
+  }
+}
+#endif
+
+/*
+ * select next deceleration mode (off -> active brake -> regen-limited)
+ */
+static void brk_mode(void)
+{
+  brake_mode_t mode = Brake_get_mode() + 1;
+
+  if (mode >= BRAKE_NR_MODES)
+  {
+    mode = BRAKE_OFF;
+  }
+  Brake_set_mode( mode );
+}
+
+/*
+ * step the brake level up by 1/8 of full scale, wraps from full to 1/8
+ */
+static void brk_level(void)
+{
+  uint16_t level = Brake_get_level() + BRK_LEVEL_STEP;
+
+  if (level > BRK_LEVEL_FULL)
+  {
+    level = BRK_LEVEL_STEP;
+  }
+  Brake_set_level( level );
+}
+
 /*
  * handle terminal input - these are simple 1-key inputs for now
  */
@@ -291,25 +540,26 @@ static ui_handlrp_t handle_term_inp(void)
   return fp;
 }
 
-/**
- * @brief  The User Interface task
- *
- * @details   Service the UI and communication handlers. Invoked in the
- *   execution context of 'main()' (background task)
+/*
+ * Service the UI and communication handlers.
  */
-static void Periodic_task(void)
+static void ui_update(void)
 {
   BL_RUNSTATE_t bl_state;
+  ui_handlrp_t fp;
+  ISR_PROF_DECL
 
 // invoke the terminal input and ui speed subs, 
 // If there is a valid key input, a function pointer to the input handler is 
 // returned. This is done prior to entering a Critical Section (DI/EI) in which
 // it will then be safe to invoke the input handler function (e.g. can call 
 // subfunctions that may be messing with global variables e.g. motor speed etc.
-  ui_handlrp_t fp = handle_term_inp();
+  fp = handle_term_inp();
 
   disableInterrupts();  //////////////// DI
 
+  ISR_PROF_START(); // profile time spent with interrupts disabled
+
   if (NULL != fp)
   {
     fp();
@@ -322,65 +572,156 @@ static void Periodic_task(void)
 
   Vsystem = Seq_Get_Vbatt();
 
+  Isystem = Curr_get_avg();
+
+  ISR_PROF_STOP( PROF_CS_EXEC );
+
   enableInterrupts();  ///////////////// EI EI O
 
 #if defined( UNDERVOLTAGE_FAULT_ENABLED )
   // update system voltage diagnostic - check plausibilty of Vsys
   if( BL_IS_RUNNING == bl_state && Vsystem > 0 )
   {
-    Faultm_upd(VOLTAGE_NG, (faultm_assert_t)( Vsystem < V_SHUTDOWN_THR) );
+    Faultm_upd(VOLTAGE_NG, (faultm_assert_t)( Vsystem < Pstore_get()->v_shutdown ) );
+  }
+#endif
+
+#if defined( OVERCURRENT_FAULT_ENABLED )
+  // average current diagnostic, the peak current is limited in the ADC ISR
+  if( BL_IS_RUNNING == bl_state )
+  {
+    Faultm_upd(OVERCURRENT, (faultm_assert_t)( Isystem > CURR_AVG_LIMIT) );
+  }
+#endif
+
+  // supervisor has already shut the phases off, latch the fault for the SM
+  Faultm_upd(SUPERVISOR, (faultm_assert_t)( 0 != Superv_get_status() ) );
+
+#if defined( STALL_FAULT_ENABLED ) || defined( BEMF_COMPARATOR )
+  // stall detector is debounced at the commutation rate (ISR), a lost
+  // comparator lock is the stall condition while timed from the comparator
+  if( BL_IS_RUNNING == bl_state )
+  {
+    uint8_t stall = 0;
+#if defined( STALL_FAULT_ENABLED )
+    stall |= Stall_get_status();
+#endif
+#if defined( BEMF_COMPARATOR )
+    stall |= Zcp_get_status();
+#endif
+    Faultm_upd(STALL, (faultm_assert_t)( 0 != stall ) );
+  }
+#endif
+
+#if defined( HALL_SENSOR )
+  // the back-EMF stall detector is not armed in Hall mode (no ramp), a rotor
+  // that does not move or a sensor fault is detected from the Hall states
+  if( BL_IS_RUNNING == bl_state )
+  {
+    Faultm_upd(STALL, (faultm_assert_t)Hall_get_status() );
+  }
+#endif
+
+#if defined( HAS_SERVO_INPUT ) && !defined( DSHOT_INPUT )
+  // RC signal timeout is counted in the control frame, the throttle is already cut
+  if( BL_IS_RUNNING == bl_state )
+  {
+    Faultm_upd(SIGNAL_LOSS, (faultm_assert_t)Rcin_get_loss() );
   }
 #endif
 }
 
 /**
- * @brief  Run Periodic Task if ready
+ * @brief  The User Interface task
  *
- * @details
- * Called in non-ISR context - checks the background task ready flag which if !0
- * will invoke the Periodic Task function.
- * @note  Called at ~60 Hz (0.0167 ms) - see Driver_Update()
- * @return  True if task ran (allows caller to also sync w/ the time period)
+ * @details   Background task scheduled at ~60 Hz (see sched.c). Invoked in
+ *   the execution context of 'main()'.
  */
-uint8_t Task_Ready(void)
+void Periodic_Task(void)
 {
   static uint8_t framecount = 0;
-  
-#ifdef UART_IT_RXNE_ENABLE
-  Pdu_Manager_Handle_Rx();
-#endif
 
-  if (0 != TaskRdy)
-  {
-    TaskRdy = FALSE;
-    Periodic_task();
+  ui_update();
 
 // periodic task is enabled at ~60 Hz ... the modulus provides a time reference of
 // approximately 2 Hz at which time the master attempts to read a few bytes from SPI
 
-    if ( ! ((framecount++) % 0x20) )
-    {
-      Log_println(0); // note: no printf to serial terminal inside a CS
+  if ( ! ((framecount++) % 0x20) )
+  {
+    Log_println(0); // note: no printf to serial terminal inside a CS
 
 #if SPI_ENABLED == SPI_STM8_MASTER
-      SPI_controld();
+    SPI_controld();
 #endif
+  }
+
+  if (FALSE != Sched_dump)
+  {
+    Sched_dump = FALSE;
+    Sched_println();
+  }
+
+  if (FALSE != Fault_dump)
+  {
+    Fault_dump = FALSE;
+    Faultm_println();
+  }
+
+  Olcal_println();
+
+#if defined( HAS_SERVO_INPUT ) && !defined( DSHOT_INPUT )
+  Rccal_println();
+#endif
+
+#if defined( DSHOT_INPUT )
+  // settings are saved by the flight controller with the motor stopped
+  if (DSHOT_CMD_SAVE_SETTINGS == Dshot_get_command())
+  {
+    Param_save = TRUE;
+  }
+#endif
+
+  if (FALSE != Param_save)
+  {
+    Param_save = FALSE;
+
+    // EEPROM programming stalls the background loop, only with motor stopped
+    if (BL_NOT_RUNNING == BL_get_state())
+    {
+      printf("Param save: %s\r\n", (PSTORE_OK == Pstore_save()) ? "ok" : "error");
+    }
+    else
+    {
+      printf("Param save: stop motor first\r\n");
     }
-    return TRUE;
   }
-  return FALSE;
+
+#if defined( ISR_PROFILE )
+  if (FALSE != Prof_dump)
+  {
+    Prof_dump = FALSE;
+    Prof_println();
+  }
+#endif
 }
 
 /**
- * @brief  Trigger background task.
+ * @brief  Run background tasks if ready
  *
  * @details
- * Called in ISR context - sets the background task ready flag which when seen
- * by polling Task_Ready in background task will invoke the Periodic Task function.
+ * Called in non-ISR context - runs the background tasks which have been flagged
+ * ready by the scheduler tick.
+ * @return  True if task ran (allows caller to also sync w/ the time period)
  */
-void Periodic_Task_Wake(void)
+uint8_t Task_Ready(void)
 {
-  TaskRdy = TRUE; // notify background process
+#ifdef UART_IT_RXNE_ENABLE
+  Pdu_Manager_Handle_Rx();
+#endif
+
+  Superv_on_background(); // background loop is alive, service the watchdog
+
+  return Sched_run_background();
 }
 
 /**@}*/ // defgroup
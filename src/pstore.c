@@ -0,0 +1,247 @@
+/**
+  ******************************************************************************
+  * @file pstore.c
+  * @brief Persistent parameter store (data EEPROM)
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup pstore Parameter Store
+ * @brief Persistent parameter store (data EEPROM)
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h> // memset
+#include "pstore.h"
+#include "mcu_stm8s.h" // EEPROM access
+#include "pwm_stm8s.h" // PWM_GET_PULSE_COUNTS, TCC_TIME_ARMING
+
+/* Private defines -----------------------------------------------------------*/
+
+/*
+ * Default parameters (0.1 % units), precision is 1/TIM2_PWM_PD = 0.4% per count
+ */
+#define PWM_DC_ALIGN     250 // 25.0 %
+#define PWM_DC_RAMPUP    150 // 15.0 %
+#define PWM_DC_STARTUP   144 // 14.4 %
+
+// length of alignment step (experimentally determined w/ 1100kv @12.5v)
+#define BL_TIME_ALIGN  (200 * 1) // N frames @ 1 ms / frame
+
+// Threshold is set low enuogh that the machine doesn't stall
+// thru the lower speed transition into closed-loop control.
+// A stalled rotor is detected directly by the stall detector (stall.c), which
+// can be tested by letting the spinning prop disc strike a flimsy obstacle
+// like a 3x5 index card.
+#if defined ( S105_DEV )
+//  Vcc==3.3v  33k/10k @ Vbatt==12.4v
+  #define V_SHUTDOWN_THR      0x02C0    // experimentally determined @ 12.4v
+#else
+  // applies presently only to the stm8s-Discovery, at 14.2v and ADCref == 5v
+  #define V_SHUTDOWN_THR      0x02C0    // experimentally determined!
+#endif
+
+/*
+ * CRC-16/CCITT, covers the record up to the CRC
+ */
+#define PSTORE_CRC_INIT     0xFFFF
+#define PSTORE_CRC_POLY     0x1021
+
+/* Private types -------------------------------------------------------------*/
+
+/**
+ * @brief EEPROM record (one wear-levelling slot)
+ */
+typedef struct
+{
+    uint8_t version;         /**< PSTORE_VERSION, 0 (blank) is never valid */
+    uint8_t seq;             /**< write sequence, newest record is loaded */
+    pstore_params_t params;  /**< parameter block */
+    uint8_t rsvd[ PSTORE_REC_SIZE - 4 - sizeof(pstore_params_t) ]; /**< pad to slot */
+    uint16_t crc;            /**< CRC of the preceding bytes */
+}
+pstore_record_t;
+
+// record must fill a slot exactly (the EEPROM is written in 4-byte words)
+STATIC_ASSERT( sizeof(pstore_record_t) == PSTORE_REC_SIZE );
+
+#define PSTORE_CRC_LEN  ( sizeof(pstore_record_t) - sizeof(uint16_t) )
+
+/* Private variables ---------------------------------------------------------*/
+
+static const pstore_params_t Pstore_defaults =
+{
+    PWM_GET_PULSE_COUNTS( PWM_DC_ALIGN ),
+    PWM_GET_PULSE_COUNTS( PWM_DC_RAMPUP ),
+    PWM_GET_PULSE_COUNTS( PWM_DC_STARTUP ),
+    BL_TIME_ALIGN,
+    V_SHUTDOWN_THR,
+    { 0 }, // not calibrated, the built-in timing table is used
+    TCC_TIME_ARMING,
+    TCC_TIME_MAX_THRUST
+};
+
+static pstore_params_t Pstore_params; // working copy in RAM
+
+static uint8_t Pstore_slot;    // slot of the last loaded/saved record
+static uint8_t Pstore_seq;     // sequence of the last loaded/saved record
+static uint8_t Pstore_loaded;  // TRUE if the parameters were loaded from EEPROM
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint16_t crc16(const uint8_t * pdata, uint8_t len)
+{
+    uint16_t crc = PSTORE_CRC_INIT;
+    uint8_t n;
+
+    while (len-- > 0)
+    {
+        crc ^= (uint16_t)( *pdata++ ) << 8;
+
+        for (n = 0; n < 8; n++)
+        {
+            if (crc & 0x8000)
+            {
+                crc = (uint16_t)( crc << 1 ) ^ PSTORE_CRC_POLY;
+            }
+            else
+            {
+                crc <<= 1;
+            }
+        }
+    }
+    return crc;
+}
+
+static uint16_t slot_offset(uint8_t slot)
+{
+    return PSTORE_EEPROM_OFFS + (uint16_t)slot * PSTORE_REC_SIZE;
+}
+
+/*
+ * Read a slot, returns TRUE if the record is valid
+ */
+static uint8_t read_slot(uint8_t slot, pstore_record_t * prec)
+{
+    MCU_eeprom_read( slot_offset( slot ), (uint8_t *)prec, PSTORE_REC_SIZE );
+
+    return (uint8_t)( PSTORE_VERSION == prec->version &&
+                      prec->crc == crc16( (const uint8_t *)prec, PSTORE_CRC_LEN ) );
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Load the parameters from EEPROM, or the defaults if there is no valid
+ *  record (blank or corrupt EEPROM, or a different version)
+ *
+ * @details Each slot is checked (version and CRC) and the newest valid record
+ *  is loaded. The sequence number wraps, and as all valid records are within
+ *  PSTORE_NR_SLOTS writes of each other the newest is found by the signed
+ *  difference of the sequence numbers.
+ */
+void Pstore_init(void)
+{
+    pstore_record_t rec;
+    uint8_t slot;
+
+    Pstore_loaded = FALSE;
+    Pstore_slot = PSTORE_NR_SLOTS - 1; // first save goes to slot 0
+    Pstore_seq = 0;
+
+    Pstore_set_defaults();
+
+    for (slot = 0; slot < PSTORE_NR_SLOTS; slot++)
+    {
+        if ( FALSE != read_slot( slot, &rec ) )
+        {
+            if ( FALSE == Pstore_loaded || (int8_t)( rec.seq - Pstore_seq ) > 0 )
+            {
+                Pstore_loaded = TRUE;
+                Pstore_slot = slot;
+                Pstore_seq = rec.seq;
+                Pstore_params = rec.params;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Accessor for the parameters in RAM
+ */
+const pstore_params_t * Pstore_get(void)
+{
+    return &Pstore_params;
+}
+
+/**
+ * @brief Update the parameters in RAM (not saved until Pstore_save)
+ */
+void Pstore_set(const pstore_params_t * pparams)
+{
+    Pstore_params = *pparams;
+}
+
+/**
+ * @brief Set the parameters in RAM to the defaults (not saved until Pstore_save)
+ */
+void Pstore_set_defaults(void)
+{
+    Pstore_params = Pstore_defaults;
+}
+
+/**
+ * @brief Save the parameters in RAM to EEPROM
+ *
+ * @details The record is written to the slot following the last one loaded or
+ *  saved, so the writes are spread over all slots. The previous record is left
+ *  intact until the next writes wrap around to it, so a failed (e.g. power
+ *  loss) write falls back to the previous parameters at the next start.
+ *  Blocks for the EEPROM programming time (~6 ms per 4-byte word), call only
+ *  with the motor stopped.
+ *
+ * @return PSTORE_OK, or PSTORE_ERR_WRITE if the record does not read back valid
+ */
+uint8_t Pstore_save(void)
+{
+    pstore_record_t rec;
+    uint8_t slot = (uint8_t)( ( Pstore_slot + 1 ) % PSTORE_NR_SLOTS );
+
+    rec.version = PSTORE_VERSION;
+    rec.seq = (uint8_t)( Pstore_seq + 1 );
+    rec.params = Pstore_params;
+    memset( rec.rsvd, 0, sizeof(rec.rsvd) );
+    rec.crc = crc16( (const uint8_t *)&rec, PSTORE_CRC_LEN );
+
+    if ( 0 != MCU_eeprom_write( slot_offset( slot ), (const uint8_t *)&rec, PSTORE_REC_SIZE ) )
+    {
+        return PSTORE_ERR_WRITE;
+    }
+
+    if ( FALSE == read_slot( slot, &rec ) )
+    {
+        return PSTORE_ERR_WRITE;
+    }
+
+    Pstore_slot = slot;
+    Pstore_seq = rec.seq;
+    Pstore_loaded = TRUE;
+
+    return PSTORE_OK;
+}
+
+/**
+ * @brief Returns TRUE if the parameters in use were loaded from (or saved to)
+ *  EEPROM, FALSE if they are the defaults
+ */
+uint8_t Pstore_is_loaded(void)
+{
+    return Pstore_loaded;
+}
+
+/**@}*/ // defgroup
@@ -23,17 +23,53 @@
 
 /* Private defines -----------------------------------------------------------*/
 
+/**
+ * @brief Duty-cycle (less current-limit trim) rescaled from nominal counts to
+ *  the active PWM period
+ */
+#define PWM_DC_ACTIVE( )  ( PWM_dc_limited >> PWM_band_active )
+
+STATIC_ASSERT( PWM_GET_PULSE_COUNTS( 1000 ) == PWM_PERIOD_COUNTS );
+STATIC_ASSERT( FXP_Q( 100, TCC_THRTTLE_RANGE, 16 ) <= U16_MAX ); // PWM_MSPEED_SCALE
+
 /* Private types -----------------------------------------------------------*/
 
 /* Public variables  ---------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
 static uint16_t global_uDC;
+static uint16_t PWM_dc_trim;    // current-limit reduction of duty-cycle
+static uint16_t PWM_dc_limited; // duty-cycle less the trim
+
+static uint8_t PWM_band_active;  // band presently loaded to the timer
+static uint8_t PWM_band_request; // band selected by speed
+
+// servo throttle range (calibrated), and percent scale precomputed for it
+static uint16_t PWM_servo_lo = TCC_TIME_ARMING;
+static uint16_t PWM_servo_pcnt_scale = PWM_MSPEED_SCALE( TCC_THRTTLE_RANGE );
 
 /* Private function prototypes -----------------------------------------------*/
 
+static void pwm_timer_reload(uint16_t period, uint16_t dutycycle);
+static void pwm_timer_compare(uint16_t dutycycle);
+
 /* Private functions ---------------------------------------------------------*/
 
+/*
+ * Apply current-limit trim to the commanded duty-cycle
+ */
+static void update_dc_limited(void)
+{
+    if (global_uDC > PWM_dc_trim)
+    {
+        PWM_dc_limited = global_uDC - PWM_dc_trim;
+    }
+    else
+    {
+        PWM_dc_limited = 0;
+    }
+}
+
 /* Public functions ---------------------------------------------------------*/
 
 /**
@@ -42,22 +78,116 @@ static uint16_t global_uDC;
 void All_phase_stop(void)
 {
 // kill the driver signals
-    PWM_PhA_Disable();
+    PWM_PhA_CC_DISABLE();
     PWM_PhA_HB_DISABLE();
 
-    PWM_PhB_Disable();
+    PWM_PhB_CC_DISABLE();
     PWM_PhB_HB_DISABLE();
 
-    PWM_PhC_Disable();
+    PWM_PhC_CC_DISABLE();
     PWM_PhC_HB_DISABLE();
 }
 
+/**
+ * @brief Assert the PWM inputs of all 3 phases low for braking.
+ *
+ * @details With PWM input low, the low-side switch of a phase is on whenever
+ *  its half-bridge is enabled (/SD), so the motor windings are shorted by
+ *  enabling the half-bridges. The /SD inputs are left as they are.
+ */
+void All_phase_brake(void)
+{
+    PWM_PhA_CC_DISABLE();
+    PWM_PhA_OUTP_LO();
+
+    PWM_PhB_CC_DISABLE();
+    PWM_PhB_OUTP_LO();
+
+    PWM_PhC_CC_DISABLE();
+    PWM_PhC_OUTP_LO();
+}
+
 /**
  * @brief Accessor to update the duty cycle of the running PWM timer
+ *
+ * @details The compare registers of all 3 channels are loaded (preloaded,
+ *  effective at the next PWM cycle) so that commutation only has to switch
+ *  the channel output enables.
  */
 void PWM_set_dutycycle(uint16_t global_dutycycle)
 {
     global_uDC = global_dutycycle;
+    update_dc_limited();
+
+    pwm_timer_compare( PWM_DC_ACTIVE() );
+}
+
+/**
+ * @brief Apply the cycle-by-cycle current limit (ADC ISR)
+ *
+ * @details The trim is subtracted from the commanded duty-cycle and the compare
+ *  registers are reloaded directly (preloaded, effective at the next PWM
+ *  cycle) rather than waiting for the next commutation step. Only the enabled
+ *  channel is driving so the other compare registers are don't-care.
+ *
+ * @param trim  Duty-cycle reduction in nominal PWM counts
+ */
+void PWM_set_dc_trim(uint16_t trim)
+{
+    if (trim != PWM_dc_trim)
+    {
+        PWM_dc_trim = trim;
+        update_dc_limited();
+
+        pwm_timer_compare( PWM_DC_ACTIVE() );
+    }
+}
+
+/**
+ * @brief Select the PWM period band from the motor speed
+ *
+ * @details Called at the control task rate. The band is only requested here
+ *  and is loaded to the timer at the next PWM update event by PWM_on_update().
+ *
+ * @param comm_period  Commutation period in commutation timer counts
+ */
+void PWM_set_band(uint16_t comm_period)
+{
+    if (comm_period > PWM_BAND_HF_ENTER_CT)
+    {
+        PWM_band_request = PWM_BAND_HI_FREQ;
+    }
+    else if (comm_period < PWM_BAND_HF_EXIT_CT)
+    {
+        PWM_band_request = PWM_BAND_NOMINAL;
+    }
+    // else ... hysteresis, remains in present band
+}
+
+/**
+ * @brief Hook for the PWM timer update event (ISR context)
+ *
+ * @details Loads the period for a newly requested band. The timer ARR and CCR
+ *  registers are preloaded so that the new period and the rescaled duty-cycle
+ *  take effect together at the following PWM boundary.
+ */
+void PWM_on_update(void)
+{
+    if (PWM_band_request != PWM_band_active)
+    {
+        PWM_band_active = PWM_band_request;
+
+        pwm_timer_reload(
+            PWM_PERIOD_COUNTS >> PWM_band_active, PWM_DC_ACTIVE() );
+    }
+}
+
+/**
+ * @brief Number of PWM update events per system tick for the active band
+ */
+uint8_t PWM_get_frames_per_tick(void)
+{
+    return (uint8_t)(PWM_NOMINAL_FRAMES_PER_TICK << PWM_band_active);
 }
 
 /** @cond */ // hide the low-level code
@@ -81,9 +211,6 @@ void PWM_set_dutycycle(uint16_t global_dutycycle)
   #define TIM2_PRESCALER   TIM2_PRESCALER_2
 #endif
 
-#define PWM_TIMER_CHAN_A  TIM2_CHANNEL_1
-#define PWM_TIMER_CHAN_B  TIM2_CHANNEL_2
-#define PWM_TIMER_CHAN_C  TIM2_CHANNEL_3
 
 void PWM_setup(void)
 {
@@ -94,57 +221,45 @@ void PWM_setup(void)
   TIM2_TimeBaseInit(TIM2_PRESCALER, PWM_PERIOD_COUNTS);
   /* Channel 1 PWM configuration */
   TIM2_OC1Init(TIM2_OCMODE_PWM2, TIM2_OUTPUTSTATE_ENABLE, 0, TIM2_OCPOLARITY_LOW );
-//  TIM2_OC1PreloadConfig(ENABLE);
+  TIM2_OC1PreloadConfig(ENABLE);
 
   /* Channel 2 PWM configuration */
   TIM2_OC2Init(TIM2_OCMODE_PWM2, TIM2_OUTPUTSTATE_ENABLE, 0, TIM2_OCPOLARITY_LOW );
-//  TIM2_OC2PreloadConfig(ENABLE);
+  TIM2_OC2PreloadConfig(ENABLE);
 
   /* Channel 3 PWM configuration */
   TIM2_OC3Init(TIM2_OCMODE_PWM2, TIM2_OUTPUTSTATE_ENABLE, 0, TIM2_OCPOLARITY_LOW );
-//  TIM2_OC3PreloadConfig(ENABLE);
+  TIM2_OC3PreloadConfig(ENABLE);
 
-  /* Enables TIM2 peripheral Preload register on ARR */
-//  TIM2_ARRPreloadConfig(ENABLE);
+  /* Enables TIM2 peripheral Preload register on ARR (PWM period band switching) */
+  TIM2_ARRPreloadConfig(ENABLE);
 
   TIM2_ITConfig(TIM2_IT_UPDATE, ENABLE);  // for triggering ADC capture
   TIM2_Cmd(ENABLE);
+
+  /* PWM pins are output low while the channel is disabled (low-side on) */
+  PWM_PhA_OUTP_LO();
+  PWM_PhB_OUTP_LO();
+  PWM_PhC_OUTP_LO();
 }
 
 /*
- * Operate /SD inputs to IR2104
+ * Load period and compare registers (preloaded, effective at next update)
  */
-void PWM_PhA_Disable(void)
+static void pwm_timer_reload(uint16_t period, uint16_t dutycycle)
 {
-    TIM2_CCxCmd( PWM_TIMER_CHAN_A, DISABLE );
-}
-
-void PWM_PhB_Disable(void)
-{
-    TIM2_CCxCmd( PWM_TIMER_CHAN_B, DISABLE );
-}
-
-void PWM_PhC_Disable(void)
-{
-    TIM2_CCxCmd( PWM_TIMER_CHAN_C, DISABLE );
-}
-
-void PWM_PhA_Enable(void)
-{
-    TIM2_SetCompare1( global_uDC );
-    TIM2_CCxCmd( PWM_TIMER_CHAN_A, ENABLE );
-}
+    TIM2->ARRH = (uint8_t)(period >> 8); // be sure to set byte ARRH first, see data sheet
+    TIM2->ARRL = (uint8_t)(period);
 
-void PWM_PhB_Enable(void)
-{
-    TIM2_SetCompare2( global_uDC );
-    TIM2_CCxCmd( PWM_TIMER_CHAN_B, ENABLE );
+    pwm_timer_compare( dutycycle );
 }
 
-void PWM_PhC_Enable(void)
+/*
+ * Count of the PWM timer i.e. time since the update event
+ */
+uint16_t PWM_get_counter(void)
 {
-    TIM2_SetCompare3( global_uDC );
-    TIM2_CCxCmd( PWM_TIMER_CHAN_C, ENABLE );
+    return TIM2_GetCounter();
 }
 
 #elif defined ( S105_DEV )
@@ -157,9 +272,6 @@ void PWM_PhC_Enable(void)
 
 #define PWM_MODE  TIM1_OCMODE_PWM2
 
-#define PWM_TIMER_CHAN_A  TIM1_CHANNEL_2
-#define PWM_TIMER_CHAN_B  TIM1_CHANNEL_3
-#define PWM_TIMER_CHAN_C  TIM1_CHANNEL_4
 
 void PWM_setup(void)
 {
@@ -200,57 +312,117 @@ void PWM_setup(void)
                  TIM1_OCPOLARITY_LOW,
                  TIM1_OCIDLESTATE_RESET);
 
+    /* Preload compare and period registers (PWM period band switching) */
+    TIM1_OC2PreloadConfig(ENABLE);
+    TIM1_OC3PreloadConfig(ENABLE);
+    TIM1_OC4PreloadConfig(ENABLE);
+    TIM1_ARRPreloadConfig(ENABLE);
+
     TIM1_CtrlPWMOutputs(ENABLE);
 
     TIM1_ITConfig(TIM1_IT_UPDATE, ENABLE);  // for triggering ADC capture
     TIM1_Cmd(ENABLE);
+
+    /* PWM pins are output low while the channel is disabled (low-side on) */
+    PWM_PhA_OUTP_LO();
+    PWM_PhB_OUTP_LO();
+    PWM_PhC_OUTP_LO();
 }
-/**
- * Control /SD inputs to IR2104
+
+/*
+ * Load period and compare registers (preloaded, effective at next update)
+ */
+static void pwm_timer_reload(uint16_t period, uint16_t dutycycle)
+{
+    TIM1->ARRH = (uint8_t)(period >> 8); // be sure to set byte ARRH first, see data sheet
+    TIM1->ARRL = (uint8_t)(period);
+
+    pwm_timer_compare( dutycycle );
+}
+
+/*
+ * Count of the PWM timer i.e. time since the update event
+ */
+uint16_t PWM_get_counter(void)
+{
+    return TIM1_GetCounter();
+}
+
+#endif // S105
+
+/*
+ * Load compare registers (preloaded, effective at next update)
+ */
+static void pwm_timer_compare(uint16_t dutycycle)
+{
+    PWM_PhA_CC_LOAD( dutycycle );
+    PWM_PhB_CC_LOAD( dutycycle );
+    PWM_PhC_CC_LOAD( dutycycle );
+}
+
+/*
+ * Phase PWM channel control (register-level macros, see pwm_stm8s.h)
  */
 void PWM_PhA_Disable(void)
 {
-    TIM1_CCxCmd( PWM_TIMER_CHAN_A, DISABLE );
+    PWM_PhA_CC_DISABLE();
 }
 
 void PWM_PhB_Disable(void)
 {
-    TIM1_CCxCmd( PWM_TIMER_CHAN_B, DISABLE );
+    PWM_PhB_CC_DISABLE();
 }
 
 void PWM_PhC_Disable(void)
 {
-    TIM1_CCxCmd( PWM_TIMER_CHAN_C, DISABLE );
+    PWM_PhC_CC_DISABLE();
 }
 
 void PWM_PhA_Enable(void)
 {
-    TIM1_SetCompare2( global_uDC );
-    TIM1_CCxCmd( PWM_TIMER_CHAN_A, ENABLE );
+    uint16_t dutycycle = PWM_DC_ACTIVE();
+    PWM_PhA_CC_LOAD( dutycycle );
+    PWM_PhA_CC_ENABLE();
 }
 
 void PWM_PhB_Enable(void)
 {
-    TIM1_SetCompare3( global_uDC );
-    TIM1_CCxCmd( PWM_TIMER_CHAN_B, ENABLE );
+    uint16_t dutycycle = PWM_DC_ACTIVE();
+    PWM_PhB_CC_LOAD( dutycycle );
+    PWM_PhB_CC_ENABLE();
 }
 
 void PWM_PhC_Enable(void)
 {
-    TIM1_SetCompare4( global_uDC );
-    TIM1_CCxCmd( PWM_TIMER_CHAN_C, ENABLE );
+    uint16_t dutycycle = PWM_DC_ACTIVE();
+    PWM_PhC_CC_LOAD( dutycycle );
+    PWM_PhC_CC_ENABLE();
 }
 
-#endif // S105
-
 /** @endcond */
 
 
+/**
+ * @brief Set the servo throttle range
+ * @details The percent scale factor is computed once here, not per call.
+ *
+ * @param lo_counts  zero throttle pulse, timer counts
+ * @param hi_counts  full throttle pulse, timer counts
+ */
+void PWM_set_servo_range(uint16_t lo_counts, uint16_t hi_counts)
+{
+  if (hi_counts > lo_counts)
+  {
+    PWM_servo_lo = lo_counts;
+    PWM_servo_pcnt_scale = PWM_MSPEED_SCALE( hi_counts - lo_counts );
+  }
+}
+
 /**
  * @brief Converts servo pulse width to servo position
  * @details 100% of servo throttle range resides in the portion of the servo
- *    pulse i.e. (1.1 ms : 1.9 ms) i.e. 
- *      servo position = servo pulse time - 1.1 ms
+ *    pulse i.e. (1.1 ms : 1.9 ms) by default, or as calibrated i.e.
+ *      servo position = servo pulse time - zero throttle pulse
  *
  * @return duration of servo pulse expressed as timer counts, range (0:1600)
  */
@@ -258,9 +430,9 @@ uint16_t PWM_get_servo_position_counts( uint16_t pulse_duration_counts )
 {
   uint16_t servo_position_counts = 0;
 
-  if (pulse_duration_counts > TCC_TIME_ARMING)
+  if (pulse_duration_counts > PWM_servo_lo)
   {
-    servo_position_counts = pulse_duration_counts - TCC_TIME_ARMING;
+    servo_position_counts = pulse_duration_counts - PWM_servo_lo;
   }
   return servo_position_counts;
 }
@@ -282,10 +454,10 @@ uint16_t PWM_get_motor_spd_pcnt(
   uint16_t servo_position_counts = 
                      PWM_get_servo_position_counts( pulse_duration_counts );
 
-// PWM percent duty-cycle is only for display purpose so some loss of precision 
-// is ok here and necessary to prevent overflow out of 16-bit unsigned
+// PWM percent duty-cycle is only for display purpose, truncated to integer
+// percent (32-bit product, no float)
 
-  motor_pcnt_speed = (uint16_t)PWM_MSPEED_PERCENT( servo_position_counts );
+  motor_pcnt_speed = PWM_MSPEED_PERCENT( servo_position_counts, PWM_servo_pcnt_scale );
 
   return motor_pcnt_speed;
 }
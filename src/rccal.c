@@ -0,0 +1,245 @@
+/**
+  ******************************************************************************
+  * @file rccal.c
+  * @brief RC throttle range calibration
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup rccal RC Throttle Calibration
+ * @brief RC throttle range calibration
+ *
+ * @details Standard ESC calibration of the servo (PWM) throttle range: the
+ *  transmitter is powered with the stick at full throttle, the ESC is powered
+ *  and measures the full stick pulse, then the stick is moved to low and the
+ *  low stick pulse is measured. The range is stored in the parameter store
+ *  and applied at each start (Rccal_init), so every transmitter gets the full
+ *  resolution of the throttle. The throttle is held at zero while the
+ *  calibration is in progress, and after it failed (until power off).
+ *
+ *  Zero and full throttle are set inside of the measured range by 1/32 of the
+ *  range, so the stick reliably reaches both ends.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "rccal.h"
+#include "pstore.h"
+#include "pwm_stm8s.h" // PWM_set_servo_range
+
+#if defined( HAS_SERVO_INPUT )
+
+/* Private defines -----------------------------------------------------------*/
+
+#define RCCAL_AVG_FRAMES   ( 1 << RCCAL_AVG_SH )
+
+#define RCCAL_MARGIN_SH    5
+
+// the calibrated range must give a 16-bit percent scale (PWM_MSPEED_SCALE)
+STATIC_ASSERT( RCCAL_HI_MIN - RCCAL_LO_MAX >= 100 );
+STATIC_ASSERT( RCCAL_AVG_SH <= 16 ); // sum of the window fits 32 bits
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static rccal_status_t Rccal_status;
+static uint16_t Rccal_frames;   // frames since power-up, or the calibration started
+static uint16_t Rccal_avg_ct;   // frames in the averaging window
+static uint32_t Rccal_sum;      // sum of the averaging window
+static uint16_t Rccal_min;      // lowest pulse of the window
+static uint16_t Rccal_max;      // highest pulse of the window
+static uint16_t Rccal_lo;       // result, zero throttle
+static uint16_t Rccal_hi;       // result, full throttle
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Restart the averaging window at the present pulse
+ */
+static void measure_start(uint16_t pulse_dur)
+{
+    Rccal_avg_ct = 0;
+    Rccal_sum = 0;
+    Rccal_min = pulse_dur;
+    Rccal_max = pulse_dur;
+}
+
+/*
+ * Average the pulse over a window while it is stable, returns TRUE with the
+ * average when the window is complete
+ */
+static uint8_t measure(uint16_t pulse_dur, uint16_t * pavg)
+{
+    if (pulse_dur < Rccal_min)
+    {
+        Rccal_min = pulse_dur;
+    }
+    if (pulse_dur > Rccal_max)
+    {
+        Rccal_max = pulse_dur;
+    }
+
+    if (Rccal_max - Rccal_min > RCCAL_TOL)
+    {
+        measure_start( pulse_dur ); // stick moving
+    }
+
+    Rccal_sum += pulse_dur;
+    Rccal_avg_ct += 1;
+
+    if (Rccal_avg_ct < RCCAL_AVG_FRAMES)
+    {
+        return FALSE;
+    }
+
+    *pavg = (uint16_t)( Rccal_sum >> RCCAL_AVG_SH );
+    measure_start( pulse_dur );
+
+    return TRUE;
+}
+
+/*
+ * Set the range to the RC input and the servo display scale
+ */
+static void set_range(uint16_t lo, uint16_t hi)
+{
+    Rcin_set_range( lo, hi );
+    PWM_set_servo_range( lo, hi );
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Apply the stored range and open the power-up calibration window
+ *
+ * @details Called at start, with interrupts disabled, after the parameter
+ *  store is loaded.
+ */
+void Rccal_init(void)
+{
+    set_range( Pstore_get()->thr_lo, Pstore_get()->thr_hi );
+
+    Rccal_status = RCCAL_IDLE;
+    Rccal_frames = 0;
+}
+
+/**
+ * @brief Run the calibration, call once per control frame (ISR context)
+ *
+ * @param protocol  Detected RC protocol, RCIN_NONE if the signal is lost
+ * @param pulse_dur  Filtered pulse duration, timer counts
+ *
+ * @return TRUE if the throttle is to be held at zero
+ */
+uint8_t Rccal_update(rcin_protocol_t protocol, uint16_t pulse_dur)
+{
+    uint16_t avg;
+
+    switch (Rccal_status)
+    {
+    case RCCAL_IDLE:
+        if (RCIN_PWM == protocol && pulse_dur >= RCCAL_HI_MIN)
+        {
+            Rccal_status = RCCAL_HI;
+            Rccal_frames = 0;
+            measure_start( pulse_dur );
+        }
+        else if (++Rccal_frames >= RCCAL_START_FRAMES)
+        {
+            Rccal_status = RCCAL_OFF;
+        }
+        break;
+
+    case RCCAL_HI:
+    case RCCAL_LO:
+        if (RCIN_PWM != protocol || ++Rccal_frames >= RCCAL_TIMEOUT_FRAMES)
+        {
+            Rccal_status = RCCAL_FAILED;
+        }
+        else if (RCCAL_HI == Rccal_status)
+        {
+            if (FALSE != measure( pulse_dur, &avg ))
+            {
+                Rccal_hi = avg;
+                Rccal_status = RCCAL_LO;
+            }
+        }
+        else if (pulse_dur > RCCAL_LO_MAX)
+        {
+            measure_start( pulse_dur ); // stick not low yet
+        }
+        else if (FALSE != measure( pulse_dur, &avg ))
+        {
+            // the stick thresholds ensure a valid range
+            Rccal_lo = avg;
+            avg = ( Rccal_hi - Rccal_lo ) >> RCCAL_MARGIN_SH;
+            Rccal_lo += avg;
+            Rccal_hi -= avg;
+            Rccal_status = RCCAL_DONE;
+        }
+        break;
+
+    case RCCAL_DONE:
+    case RCCAL_OFF:
+    default:
+        break;
+    }
+
+    return (uint8_t)( RCCAL_HI == Rccal_status || RCCAL_LO == Rccal_status ||
+                      RCCAL_FAILED == Rccal_status );
+}
+
+/**
+ * @brief Accessor for the calibration status
+ */
+rccal_status_t Rccal_get_status(void)
+{
+    return Rccal_status;
+}
+
+/**
+ * @brief Accessor for the calibrated range (valid in RCCAL_DONE)
+ *
+ * @param plo  Zero throttle pulse, timer counts
+ * @param phi  Full throttle pulse, timer counts
+ */
+void Rccal_get_range(uint16_t * plo, uint16_t * phi)
+{
+    *plo = Rccal_lo;
+    *phi = Rccal_hi;
+}
+
+/**
+ * @brief Apply the calibrated range to the RC input and the parameters in
+ *  RAM (saved by the caller)
+ *
+ * @details Background task context, the range is set in a critical section
+ *  as it is used by the capture ISR.
+ */
+void Rccal_apply(void)
+{
+    pstore_params_t params;
+
+    if (RCCAL_DONE == Rccal_status)
+    {
+        params = *Pstore_get();
+        params.thr_lo = Rccal_lo;
+        params.thr_hi = Rccal_hi;
+        Pstore_set( &params );
+
+        disableInterrupts();
+        set_range( Rccal_lo, Rccal_hi );
+        enableInterrupts();
+
+        Rccal_status = RCCAL_OFF;
+    }
+}
+
+#endif // HAS_SERVO_INPUT
+
+/**@}*/ // defgroup
@@ -0,0 +1,378 @@
+/**
+  ******************************************************************************
+  * @file rcin.c
+  * @brief RC throttle pulse input, protocol detection and scaling
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup rcin RC Throttle Input
+ * @brief RC throttle pulse input, protocol detection and scaling
+ *
+ * @details The throttle pulse is measured by the servo capture timer (driver.c)
+ *  and the protocol is detected from the pulse duration and period: standard
+ *  servo PWM, OneShot125, OneShot42 or Multishot. The protocol is locked after
+ *  RCIN_DETECT_CT consecutive pulses and each pulse is then scaled to the
+ *  throttle (PWM counts) by the descriptor of the protocol.
+ *
+ *  A pulse is plausible if its duration is within the range of the protocol
+ *  and its period (from the previous rising edge) is not shorter than the
+ *  protocol allows, which rejects a noise spike as it also gives a short
+ *  period. Plausible pulses are filtered by a median of 3, so a single
+ *  corrupted pulse does not move the throttle, at the cost of one pulse of
+ *  latency on a step. Once locked only the descriptor of the protocol is
+ *  evaluated, the ISR runs a fixed path of a few compares and one 16x32-bit
+ *  multiply. Without a plausible pulse for RCIN_LOSS_FRAMES control frames
+ *  the signal is lost (failsafe).
+ *
+ *  The capture timer also provides the 0.5 us timestamp of the back-EMF
+ *  sampling so its prescaler is not changed per protocol, the resolution of
+ *  the throttle is 1600 steps for PWM, 250 for OneShot125, 84 for OneShot42
+ *  and 40 for Multishot.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "rcin.h"
+#include "pwm_stm8s.h" // PWM_PERIOD_COUNTS
+
+#if defined( HAS_SERVO_INPUT )
+
+/* Private defines -----------------------------------------------------------*/
+
+#define RCIN_US( _US_ )   (uint16_t)( (_US_) * RCIN_CT_PER_US )
+
+/*
+ * Longest pulse period of any protocol (40 Hz)
+ */
+#define RCIN_PERD_MAX     RCIN_US( 25000 )
+
+// the pulse is at most 5/4 of the range, the scaled product must fit 32 bits
+STATIC_ASSERT( (uint32_t)PWM_PERIOD_COUNTS * 5 / 4 < U16_MAX );
+STATIC_ASSERT( RCIN_PERD_MAX <= U16_MAX );
+
+/*
+ * Shortest valid pulse: 1/4 of the throttle range below zero throttle, but at
+ * least half of the zero throttle pulse (Multishot: 1/4 of the range is the
+ * whole zero throttle pulse, any glitch would be accepted)
+ */
+#define RCIN_DUR_MIN( _LO_, _HI_ )                                                 \
+  ( ( (_HI_) - (_LO_) ) / 4 < (_LO_) / 2 ?                                         \
+      RCIN_US( (_LO_) - ( (_HI_) - (_LO_) ) / 4 ) : RCIN_US( _LO_ ) / 2 )
+
+STATIC_ASSERT( RCIN_DUR_MIN( 5, 25 ) > 0 ); // Multishot
+
+/*
+ * Descriptor initializer: pulse duration at zero and full throttle, and the
+ * shortest period (us). A pulse is accepted within 1/4 of the throttle range
+ * outside of the range (RCIN_DUR_MIN below). The scale factor to PWM counts
+ * is Q16.
+ */
+#define RCIN_PROTO( _LO_, _HI_, _PERD_MIN_ )                                       \
+  {                                                                              \
+    RCIN_US( _LO_ ),                                                             \
+    RCIN_US( _HI_ ),                                                             \
+    RCIN_DUR_MIN( _LO_, _HI_ ),                                                  \
+    RCIN_US( (_HI_) + ( (_HI_) - (_LO_) ) / 4 ),                                 \
+    RCIN_US( _PERD_MIN_ ),                                                       \
+    ( (uint32_t)PWM_PERIOD_COUNTS << 16 ) / RCIN_US( (_HI_) - (_LO_) )           \
+  }
+
+/* Private types -------------------------------------------------------------*/
+
+/**
+ * @brief Protocol descriptor (timer counts)
+ */
+typedef struct
+{
+    uint16_t dur_lo;    /**< zero throttle */
+    uint16_t dur_hi;    /**< full throttle */
+    uint16_t dur_min;   /**< shortest valid pulse */
+    uint16_t dur_max;   /**< longest valid pulse */
+    uint16_t perd_min;  /**< shortest valid period */
+    uint32_t scale;     /**< throttle range to PWM counts, Q16 */
+}
+rcin_proto_desc_t;
+
+/* Private variables ---------------------------------------------------------*/
+
+/*
+ * Indexed by rcin_protocol_t - 1. Standard PWM zero throttle is the arming
+ * pulse of the original servo setup (TCC_TIME_ARMING), the shortest period
+ * of the OneShot protocols is the full throttle pulse. In RAM, the range of
+ * standard PWM is calibrated (Rcin_set_range).
+ */
+static rcin_proto_desc_t Rcin_proto_tbl[ RCIN_NR_PROTOCOLS - 1 ] =
+{
+    RCIN_PROTO( 1100, 1900, 2500 ), // RCIN_PWM
+    RCIN_PROTO(  125,  250,  250 ), // RCIN_ONESHOT125
+    RCIN_PROTO(   42,   84,   84 ), // RCIN_ONESHOT42
+    RCIN_PROTO(    5,   25,   25 )  // RCIN_MULTISHOT
+};
+
+static rcin_protocol_t Rcin_protocol;  // locked protocol
+static rcin_protocol_t Rcin_candidate; // protocol of the last pulses (detection)
+static uint8_t Rcin_detect_ct;         // consecutive pulses of the candidate
+static uint8_t Rcin_new;               // valid pulse since the last read
+static uint16_t Rcin_errors;           // pulses rejected after the lock
+static uint16_t Rcin_smp[ 3 ];         // last plausible pulses (median filter)
+static uint16_t Rcin_pulse_dur;        // median pulse duration
+static uint8_t Rcin_loss_ct;           // control frames since a plausible pulse
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Range and period plausibility of a pulse for a protocol
+ */
+static uint8_t plausible(const rcin_proto_desc_t * pdesc,
+                         uint16_t pulse_dur, uint16_t pulse_perd)
+{
+    return (uint8_t)( pulse_dur >= pdesc->dur_min && pulse_dur <= pdesc->dur_max &&
+                      pulse_perd >= pdesc->perd_min && pulse_perd <= RCIN_PERD_MAX );
+}
+
+/*
+ * Protocol of a pulse, RCIN_NONE if it does not fit any
+ */
+static rcin_protocol_t classify(uint16_t pulse_dur, uint16_t pulse_perd)
+{
+    uint8_t n;
+
+    for (n = 0; n < RCIN_NR_PROTOCOLS - 1; n++)
+    {
+        if (FALSE != plausible( &Rcin_proto_tbl[ n ], pulse_dur, pulse_perd ))
+        {
+            return (rcin_protocol_t)( n + 1 );
+        }
+    }
+    return RCIN_NONE;
+}
+
+/*
+ * Protocol detection, locks the protocol after RCIN_DETECT_CT consecutive
+ * pulses of the same protocol
+ */
+static void detect(rcin_protocol_t protocol)
+{
+    if (RCIN_NONE != protocol && protocol == Rcin_candidate)
+    {
+        Rcin_detect_ct += 1;
+
+        if (Rcin_detect_ct >= RCIN_DETECT_CT)
+        {
+            Rcin_protocol = protocol;
+        }
+    }
+    else
+    {
+        Rcin_candidate = protocol;
+        Rcin_detect_ct = 1;
+    }
+}
+
+/*
+ * Median of the last 3 plausible pulses
+ */
+static uint16_t median3(uint16_t pulse_dur)
+{
+    uint16_t a, b, c;
+
+    Rcin_smp[ 2 ] = Rcin_smp[ 1 ];
+    Rcin_smp[ 1 ] = Rcin_smp[ 0 ];
+    Rcin_smp[ 0 ] = pulse_dur;
+
+    a = Rcin_smp[ 0 ];
+    b = Rcin_smp[ 1 ];
+    c = Rcin_smp[ 2 ];
+
+    if (a > b)
+    {
+        a = b;
+        b = Rcin_smp[ 0 ];
+    }
+    // a <= b, the median is b unless c is lower, then the larger of a and c
+    if (c < b)
+    {
+        b = (c > a) ? c : a;
+    }
+    return b;
+}
+
+/*
+ * Scale the pulse to the throttle, limited to the throttle range
+ */
+static uint16_t scale(const rcin_proto_desc_t * pdesc, uint16_t pulse_dur)
+{
+    uint32_t u32;
+
+    if (pulse_dur <= pdesc->dur_lo)
+    {
+        return 0;
+    }
+
+    u32 = ( (uint32_t)( pulse_dur - pdesc->dur_lo ) * pdesc->scale + 0x8000 ) >> 16;
+
+    return (u32 < PWM_PERIOD_COUNTS) ? (uint16_t)u32 : PWM_PERIOD_COUNTS;
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Reset the protocol detection
+ */
+void Rcin_reset(void)
+{
+    Rcin_protocol = RCIN_NONE;
+    Rcin_candidate = RCIN_NONE;
+    Rcin_detect_ct = 0;
+    Rcin_new = FALSE;
+    Rcin_errors = 0;
+    Rcin_smp[ 0 ] = Rcin_smp[ 1 ] = Rcin_smp[ 2 ] = 0;
+    Rcin_pulse_dur = 0;
+    Rcin_loss_ct = 0;
+}
+
+/**
+ * @brief Set the throttle range of standard PWM (calibration)
+ *
+ * @details The scale factor is computed once here, not per pulse. Call with
+ *  the capture interrupt disabled.
+ *
+ * @param lo  Zero throttle pulse, timer counts
+ * @param hi  Full throttle pulse, timer counts
+ */
+void Rcin_set_range(uint16_t lo, uint16_t hi)
+{
+    rcin_proto_desc_t * pdesc = &Rcin_proto_tbl[ RCIN_PWM - 1 ];
+    uint16_t range = hi - lo;
+
+    if (hi <= lo)
+    {
+        return; // not a range, keep the present one
+    }
+
+    pdesc->dur_lo = lo;
+    pdesc->dur_hi = hi;
+    pdesc->dur_min = (range / 4 < lo / 2) ? lo - range / 4 : lo / 2;
+    pdesc->dur_max = hi + range / 4;
+    pdesc->scale = ( (uint32_t)PWM_PERIOD_COUNTS << 16 ) / range;
+}
+
+/**
+ * @brief Evaluate a throttle pulse (capture ISR context, falling edge)
+ *
+ * @details Until the protocol is locked, the pulse is only classified. Once
+ *  locked, a pulse that is not plausible for the protocol is rejected (the
+ *  throttle is held) and the protocol does not change. Only the median filter
+ *  runs at the pulse rate, the pulse is scaled to the throttle when it is read
+ *  (control frame).
+ *
+ * @param pulse_dur  Pulse duration, timer counts
+ * @param pulse_perd  Pulse period (rising edge to rising edge), timer counts
+ */
+void Rcin_on_pulse(uint16_t pulse_dur, uint16_t pulse_perd)
+{
+    if (RCIN_NONE == Rcin_protocol)
+    {
+        rcin_protocol_t protocol = classify( pulse_dur, pulse_perd );
+
+        detect( protocol );
+
+        if (RCIN_NONE == protocol)
+        {
+            return;
+        }
+    }
+    else if (FALSE == plausible( &Rcin_proto_tbl[ Rcin_protocol - 1 ],
+                                 pulse_dur, pulse_perd ))
+    {
+        Rcin_errors += 1;
+        return;
+    }
+
+    Rcin_pulse_dur = median3( pulse_dur );
+    Rcin_loss_ct = 0;
+
+    if (RCIN_NONE != Rcin_protocol)
+    {
+        // the locking pulse sets the throttle, the filter has 3 pulses of the protocol
+        Rcin_new = TRUE;
+    }
+}
+
+/**
+ * @brief Signal loss timer, call once per control frame (ISR context)
+ */
+void Rcin_on_frame(void)
+{
+    if (Rcin_loss_ct < RCIN_LOSS_FRAMES)
+    {
+        Rcin_loss_ct += 1;
+    }
+}
+
+/**
+ * @brief Signal loss status
+ *
+ * @return TRUE if the protocol is locked and there was no plausible pulse for
+ *  RCIN_LOSS_FRAMES control frames, cleared by the next plausible pulse
+ */
+uint8_t Rcin_get_loss(void)
+{
+    return (uint8_t)( RCIN_NONE != Rcin_protocol && Rcin_loss_ct >= RCIN_LOSS_FRAMES );
+}
+
+/**
+ * @brief Accessor for the filtered (median) pulse duration, timer counts
+ */
+uint16_t Rcin_get_pulse_dur(void)
+{
+    return Rcin_pulse_dur;
+}
+
+/**
+ * @brief Read the throttle of the last valid pulse
+ *
+ * @details The filtered pulse is scaled here, once per read, rather than in
+ *  the capture ISR at the pulse rate (up to 32 kHz for Multishot). Call from
+ *  a context that the capture ISR does not preempt (control frame).
+ *
+ * @param pthrottle  Throttle, PWM counts (0:PWM_PERIOD_COUNTS), 0 if the
+ *  protocol is not locked
+ *
+ * @return TRUE if a new pulse was received since the last call
+ */
+uint8_t Rcin_get_throttle(uint16_t * pthrottle)
+{
+    uint8_t new_pulse = Rcin_new;
+
+    Rcin_new = FALSE;
+    *pthrottle = (RCIN_NONE != Rcin_protocol) ?
+        scale( &Rcin_proto_tbl[ Rcin_protocol - 1 ], Rcin_pulse_dur ) : 0;
+
+    return new_pulse;
+}
+
+/**
+ * @brief Accessor for the detected protocol
+ */
+rcin_protocol_t Rcin_get_protocol(void)
+{
+    return Rcin_protocol;
+}
+
+/**
+ * @brief Accessor for the count of pulses rejected after the protocol lock
+ */
+uint16_t Rcin_get_errors(void)
+{
+    return Rcin_errors;
+}
+
+#endif // HAS_SERVO_INPUT
+
+/**@}*/ // defgroup
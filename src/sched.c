@@ -0,0 +1,261 @@
+/**
+  ******************************************************************************
+  * @file sched.c
+  * @brief Table-driven cooperative task scheduler
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup sched Scheduler
+ * @brief Table-driven cooperative task scheduler
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h> // NULL
+#include "mcu_stm8s.h"
+#include "pwm_stm8s.h"
+#include "driver.h"
+#include "per_task.h"
+#include "sched.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+/**
+ * @brief Task table
+ *
+ * @details The system tick is derived from the PWM timer update event,
+ *  i.e. every PWM cycle at the nominal PWM period (~128 us, ~8 kHz), so a
+ *  task may run at up to the PWM rate (e.g. a 4 kHz loop is 2 ticks).
+ *
+ *    BL Control task    = 8 ticks   -> ~1 ms (1000 Hz)
+ *    Periodic (UI) task = 128 ticks -> ~16 ms (60 Hz)
+ *
+ *  The control task is on the odd ticks and the UI task is on the even ticks
+ *  so they do not run in the same tick.
+ */
+static const sched_task_t Sched_table[] =
+{
+//  period  phase  context         task
+    {   8,    1,   SCHED_CTX_ISR,  Driver_Update },
+    { 128,    0,   SCHED_CTX_BG,   Periodic_Task }
+};
+
+#define SCHED_NR_TASKS  ( sizeof( Sched_table ) / sizeof( sched_task_t ) )
+
+static sched_stats_t Sched_stats[ SCHED_NR_TASKS ];
+
+static uint8_t Sched_countdn[ SCHED_NR_TASKS ]; // ticks until task is due
+static uint8_t Sched_pending[ SCHED_NR_TASKS ]; // background task is ready
+static uint8_t Sched_held[ SCHED_NR_TASKS ];    // ISR task held for one tick
+
+static uint8_t Sched_hold; // hold ISR tasks that are due (set from capture ISR)
+
+static uint8_t Sched_frame_count; // PWM frames in the present tick
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Update statistics for a task
+ */
+static void sched_stats_upd(uint8_t n, uint16_t exec_time)
+{
+    sched_stats_t * pstats = &Sched_stats[ n ];
+
+    pstats->runs += 1;
+    pstats->exec_last = exec_time;
+
+    if (exec_time > pstats->exec_max)
+    {
+        pstats->exec_max = exec_time;
+    }
+
+    if ( exec_time > (uint16_t)( (uint16_t)Sched_table[ n ].period * SCHED_TICK_TS_COUNTS ) )
+    {
+        if (pstats->misses < U16_MAX)
+        {
+            pstats->misses += 1;
+        }
+    }
+}
+
+/*
+ * Run a task and return its execution time
+ */
+static uint16_t sched_run(uint8_t n)
+{
+    uint16_t t0 = MCU_get_timestamp();
+
+    Sched_table[ n ].ptask();
+
+    // 16-bit timer wraps at 0xFFFF so no concern for sign of result
+    return MCU_get_timestamp() - t0;
+}
+
+/*
+ * System tick: dispatch ISR tasks and flag background tasks that are due
+ */
+static void sched_tick(void)
+{
+    uint8_t n;
+
+    for (n = 0; n < SCHED_NR_TASKS; n++)
+    {
+        if (Sched_countdn[ n ] > 0)
+        {
+            Sched_countdn[ n ] -= 1;
+            continue;
+        }
+
+        if ( SCHED_CTX_ISR == Sched_table[ n ].context &&
+             FALSE != Sched_hold && FALSE == Sched_held[ n ] )
+        {
+            // due again at the next tick, held only once so it is not starved
+            Sched_held[ n ] = TRUE;
+            continue;
+        }
+        Sched_held[ n ] = FALSE;
+
+        Sched_countdn[ n ] = Sched_table[ n ].period - 1;
+
+        if (SCHED_CTX_ISR == Sched_table[ n ].context)
+        {
+            sched_stats_upd( n, sched_run( n ) );
+        }
+        else
+        {
+            if (FALSE != Sched_pending[ n ])
+            {
+                // previous activation was not serviced in time
+                if (Sched_stats[ n ].misses < U16_MAX)
+                {
+                    Sched_stats[ n ].misses += 1;
+                }
+            }
+            Sched_pending[ n ] = TRUE;
+        }
+    }
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Initialize the scheduler
+ *
+ * @details Expect to be called before interrupts are enabled.
+ */
+void Sched_init(void)
+{
+    uint8_t n;
+
+    for (n = 0; n < SCHED_NR_TASKS; n++)
+    {
+        Sched_countdn[ n ] = Sched_table[ n ].phase;
+        Sched_pending[ n ] = FALSE;
+        Sched_held[ n ] = FALSE;
+
+        Sched_stats[ n ].runs = 0;
+        Sched_stats[ n ].misses = 0;
+        Sched_stats[ n ].exec_last = 0;
+        Sched_stats[ n ].exec_max = 0;
+    }
+    Sched_frame_count = 0;
+    Sched_hold = FALSE;
+}
+
+/**
+ * @brief Hook for the PWM timer update event (ISR context)
+ *
+ * @details Divides the PWM frames down to the system tick. The number of frames
+ *  per tick is scaled with the PWM period band to keep the tick rate constant.
+ */
+void Sched_on_PWM_frame(void)
+{
+// note pre-increment on variable
+    if ( ++Sched_frame_count >= PWM_get_frames_per_tick() )
+    {
+        Sched_frame_count = 0;
+
+        sched_tick();
+    }
+}
+
+/**
+ * @brief Hold the ISR tasks (ISR context)
+ *
+ * @details Set by a lower priority ISR for the duration of a time-critical
+ *  poll: an ISR task that becomes due while held runs at the following tick
+ *  instead, so the PWM timer ISR that preempts the poll is kept short. A task
+ *  is held for at most one tick.
+ *
+ * @param hold  TRUE to hold, FALSE to release
+ */
+void Sched_set_hold(uint8_t hold)
+{
+    Sched_hold = hold;
+}
+
+/**
+ * @brief Run background tasks that are ready
+ *
+ * @details Called in non-ISR context from the main loop. The execution time of
+ *  a background task includes time spent in ISRs.
+ *
+ * @return  True if a task ran (allows caller to also sync w/ the time period)
+ */
+uint8_t Sched_run_background(void)
+{
+    uint8_t n;
+    uint8_t ran = FALSE;
+
+    for (n = 0; n < SCHED_NR_TASKS; n++)
+    {
+        if (FALSE != Sched_pending[ n ])
+        {
+            uint16_t exec_time;
+
+            Sched_pending[ n ] = FALSE; // byte write, no CS needed
+
+            exec_time = sched_run( n );
+
+            disableInterrupts(); // stats are shared with the tick (ISR)
+            sched_stats_upd( n, exec_time );
+            enableInterrupts();
+
+            ran = TRUE;
+        }
+    }
+    return ran;
+}
+
+/**
+ * @brief Number of tasks in the table
+ */
+uint8_t Sched_get_nr_tasks(void)
+{
+    return (uint8_t)SCHED_NR_TASKS;
+}
+
+/**
+ * @brief Accessor for task statistics
+ * @param task  Index of the task in the table
+ * @return Pointer to statistics, NULL if index out of range
+ */
+const sched_stats_t * Sched_get_stats(uint8_t task)
+{
+    if (task < SCHED_NR_TASKS)
+    {
+        return &Sched_stats[ task ];
+    }
+    return NULL;
+}
+
+/**@}*/ // defgroup
@@ -18,6 +18,8 @@
 #include "pwm_stm8s.h"
 #include "driver.h"
 #include "bldc_sm.h"
+#include "stall.h"
+#include "zcp.h"
 
 
 /* Private defines -----------------------------------------------------------*/
@@ -50,26 +52,36 @@ typedef enum
 }
 Seq_sector_t;
 
+/*
+ * Phase output states for building the sector register images
+ */
+#define PH_FLT  0  // half-bridge disabled, phase floating
+#define PH_LO   1  // half-bridge enabled, PWM input low (low-side on)
+#define PH_PWM  2  // half-bridge enabled, PWM on high-side
+
+#define SEQ_CCER( _A_, _B_, _C_, _EN_A_, _EN_B_, _EN_C_ ) \
+  (uint8_t)( ( PH_PWM == (_A_) ? (_EN_A_) : 0 ) |         \
+             ( PH_PWM == (_B_) ? (_EN_B_) : 0 ) |         \
+             ( PH_PWM == (_C_) ? (_EN_C_) : 0 ) )
+
+#define SEQ_SD( _X_, _PIN_ )  (uint8_t)( PH_FLT != (_X_) ? (_PIN_) : 0 )
+
 /**
-* @brief  Table of handler functions for 6 commutation steps.
-*
-* @details  Each commutation step sequence is implemented as a simple function and
-*  function pointers are aggregated into a single table.
-*
-* @return  void
-*/
-typedef void (*step_ptr_t)( void );
+ * @brief Build the register image of a commutation sector from phase states
+ * @details Evaluated entirely by the preprocessor/compiler (const table).
+ */
+#define SEQ_SECTOR_IMAGE( _A_, _B_, _C_ )                                          \
+  {                                                                                \
+    SEQ_CCER( _A_, _B_, _C_, PWM_PhA_CCER1_EN, PWM_PhB_CCER1_EN, PWM_PhC_CCER1_EN ), \
+    SEQ_CCER( _A_, _B_, _C_, PWM_PhA_CCER2_EN, PWM_PhB_CCER2_EN, PWM_PhC_CCER2_EN ), \
+    SEQ_SD( _A_, SDa_SD_PIN ),                                                     \
+    SEQ_SD( _B_, SDb_SD_PIN ),                                                     \
+    SEQ_SD( _C_, SDc_SD_PIN )                                                      \
+  }
 
 
 /* Private function prototypes -----------------------------------------------*/
 
-static void sector_0(void);
-static void sector_1(void);
-static void sector_2(void);
-static void sector_3(void);
-static void sector_4(void);
-static void sector_5(void);
-
 
 /* Public variables  ---------------------------------------------------------*/
 
@@ -160,22 +172,55 @@ static uint16_t Vbatt_;
  * already active from the previous 60-degrees sector.
  *
  * Fourth: enable PWM on high-side switch phase (N+0).
+ *
+ * The steps above are precomputed per sector as a register image (timer
+ * channel enables and /SD output levels) so that a commutation is a fixed
+ * handful of register stores regardless of the sector. The PWM inputs of
+ * disabled channels are held low by their GPIO (configured in PWM_setup), and
+ * the compare registers are loaded by the PWM module at the duty-cycle update.
  */
-static const step_ptr_t step_ptr_table[] =
+static const PWM_sector_image_t Seq_image_table[] =
 {
-  sector_0, //    { A_PWM_HS,       B_OFF_LS,       C_FLOAT_NEG
-  sector_1, //    { A_PWM_HS,       B_FLOAT_POS,    C_OFF_LS,
-  sector_2, //    { A_FLOAT_NEG,    B_PWM_HS,       C_OFF_LS,
-  sector_3, //    { A_OFF_LS,       B_PWM_HS,       C_FLOAT_POS,
-  sector_4, //    { A_OFF_LS,       B_FLOAT_NEG,    C_PWM_HS,
-  sector_5  //    { A_FLOAT_POS,    B_OFF_LS,       C_PWM_HS,
+  SEQ_SECTOR_IMAGE( PH_PWM, PH_LO,  PH_FLT ), // A_PWM_HS,    B_OFF_LS,    C_FLOAT_NEG
+  SEQ_SECTOR_IMAGE( PH_PWM, PH_FLT, PH_LO  ), // A_PWM_HS,    B_FLOAT_POS, C_OFF_LS
+  SEQ_SECTOR_IMAGE( PH_FLT, PH_PWM, PH_LO  ), // A_FLOAT_NEG, B_PWM_HS,    C_OFF_LS
+  SEQ_SECTOR_IMAGE( PH_LO,  PH_PWM, PH_FLT ), // A_OFF_LS,    B_PWM_HS,    C_FLOAT_POS
+  SEQ_SECTOR_IMAGE( PH_LO,  PH_FLT, PH_PWM ), // A_OFF_LS,    B_FLOAT_NEG, C_PWM_HS
+  SEQ_SECTOR_IMAGE( PH_FLT, PH_LO,  PH_PWM )  // A_FLOAT_POS, B_OFF_LS,    C_PWM_HS
+};
+
+#define SEQ_NR_SECTORS  ( sizeof(Seq_image_table) / sizeof(PWM_sector_image_t) )
+
+/*
+ * PWM driven phase of each sector (phase A divider reads the system voltage)
+ */
+static const uint8_t Seq_pwm_phase[] =
+{
+  DRIVER_PHASE_A, DRIVER_PHASE_A,
+  DRIVER_PHASE_B, DRIVER_PHASE_B,
+  DRIVER_PHASE_C, DRIVER_PHASE_C
+};
+
+/*
+ * Floating phase of each sector, its back-EMF is sensed on its own divider.
+ * The floats alternate falling (even sectors) and rising (odd sectors).
+ */
+static const uint8_t Seq_float_phase[] =
+{
+  DRIVER_PHASE_C, // C_FLOAT_NEG
+  DRIVER_PHASE_B, // B_FLOAT_POS
+  DRIVER_PHASE_A, // A_FLOAT_NEG
+  DRIVER_PHASE_C, // C_FLOAT_POS
+  DRIVER_PHASE_B, // B_FLOAT_NEG
+  DRIVER_PHASE_A  // A_FLOAT_POS
 };
 
 /*
  * Timing error term -  magnitude of the "falling"
  * (right) side is proportional to the degree of timing advance .. advanced
  * condition is seen when there is greater distribution of back-emf area on the
- * right side.
+ * right side. Updated at each sector from the latest rising and falling
+ * floats (of any phase).
  */
 // There isn't a timing control point to use to determine the error - however
 // ratio of the leading and falling slopes (integration) indicates the direction
@@ -183,161 +228,193 @@ static const step_ptr_t step_ptr_table[] =
 //  ratio = ( L / F  ) - 1
 static int16_t comm_tm_err_ratio;
 
-#define SCALE_64_LSH   6
-#define SCALE_64_ONE  (1 << SCALE_64_LSH)
-
-
-/* Private functions ---------------------------------------------------------*/
-
 /*
- * Sector 0:  A_PWM_HS | B_OFF_LS | C_FLOAT_NEG
- *
- * Previous sector (5) phase-A was floating (positive-going transition) so ADC
- * input from phase A resistor divider is taken as average back-EMF voltage
- * during the positive-going float sector.
+ * Zero-crossing point error (timestamp counts) from the two-point estimate,
+ * taken on the latest falling and rising floating sectors.
  */
-static void sector_0(void)
-{
-#ifdef BUFFER_ADC_BEMF
-  Back_EMF_Riseing_PhX = ( Back_EMF_Riseing_PhX + Driver_Get_Back_EMF_Avg() ) >> 1 ;
-#else
-  Back_EMF_Riseing_PhX = ( Back_EMF_Riseing_PhX + Driver_Get_ADC() ) >> 1 ;
-#endif
+static int16_t zcp_err_falling;
+static int16_t zcp_err_rising;
 
-// C FLOAT NEG
-  PWM_PhC_Disable(); // phase C PWM asserted off (negative-going float)
-  PWM_PhC_HB_DISABLE(); // half-bridge disable
+#define SCALE_64_LSH   6
+#define SCALE_64_ONE  (1 << SCALE_64_LSH)
 
-// B_OFF_LS  (NO-OP?)
-  PWM_PhB_OUTP_LO();
-  PWM_PhB_HB_ENABLE(); // half-bridge enable
 
-// A PWM HS
-  PWM_PhA_Enable(); // PWM on
-  PWM_PhA_HB_ENABLE(); // half-bridge enable
-}
+/* Private functions ---------------------------------------------------------*/
 
 /*
- * Sector 1:  A_PWM_HS | B_FLOAT_POS | C_OFF_LS
+ * Interval between the back-EMF samples at 15 and 45 degrees, 0 if they are
+ * not from the same sector (a request not taken before the commutation at
+ * high speed leaves the sample of an earlier sector)
  */
-static void sector_1(void)
+static uint16_t bemf_sample_dt(void)
 {
-// B FLOAT POS
-  PWM_PhC_Disable(); // Phase C PWM asserted off (positive-going float)
-  PWM_PhB_HB_DISABLE();
-
-// C OFF LS
-  PWM_PhC_OUTP_LO();
-  PWM_PhC_HB_ENABLE();
+  uint16_t dt = Driver_get_bemf_sample_tm( DRIVER_BEMF_SMP_45 ) -
+                Driver_get_bemf_sample_tm( DRIVER_BEMF_SMP_15 );
 
-// A PWM HS
-//  PWM_PhA_Enable(); // NO
-//  PWM_PhA_HB_ENABLE(); // NO-OP?
+  // sector period in timestamp counts is numerically the commutation period
+  if ( (int16_t)dt <= 0 || dt >= BL_get_timing() )
+  {
+    return 0;
+  }
+  return dt;
 }
 
 /*
- * Sector 2:  A_FLOAT_NEG | B_PWM_HS | C_OFF_LS
+ * Two-point estimate of the zero-crossing point (docs/md/zeropoint.md).
+ *
+ * The back-EMF samples at 15 and 45 degrees of the floating sector are
+ * interpolated to find where the phase crosses the neutral (Vbatt/2). If the
+ * motor is in time the ZCP is midway between the samples (30 degrees):
+ *
+ *   t_zcp - t_mid = dt * ( (vn - v15) / (v45 - v15) - 1/2 )
  *
- * Phase A was driven PWM, so that latest ADC input from phase A resistor divider
- * (during PWM on-time is taken as battery/system voltage.
+ * Applies to either rising or falling slope. Called once per floating sector
+ * so the divide is acceptable.
+ *
+ * Returns ZCP time relative to the 30 degree point (timestamp counts), positive
+ * if the crossing is late, clamped to +/- the sample interval.
  */
-static void sector_2(void)
+static int16_t zcp_estimate(void)
 {
-  Vbatt_ = Driver_Get_ADC();
-
-// A FLOAT NEG
-  PWM_PhA_Disable();  // phase A PWM asserted off (negative-going float)
-  PWM_PhA_HB_DISABLE();
+  int16_t v15 = (int16_t)Driver_get_bemf_sample( DRIVER_BEMF_SMP_15 );
+  int16_t v45 = (int16_t)Driver_get_bemf_sample( DRIVER_BEMF_SMP_45 );
+  int16_t vn = (int16_t)(Vbatt_ >> 1);
+  int16_t dv = v45 - v15;
+  int16_t dt = (int16_t)bemf_sample_dt();
+  int32_t err;
+
+  if (0 == dv || 0 == Vbatt_ || dt <= 0)
+  {
+    return 0; // no estimate
+  }
 
-// C OFF LS  (NO-OP?)
-  PWM_PhC_OUTP_LO();
-  PWM_PhC_HB_ENABLE();
+  err = ( (int32_t)dt * ( 2 * (vn - v15) - dv ) ) / ( 2 * (int32_t)dv );
 
-// B PWM HS
-  PWM_PhB_Enable();
-  PWM_PhB_HB_ENABLE();
+  if (err > dt)
+  {
+    err = dt;
+  }
+  else if (err < -dt)
+  {
+    err = -dt;
+  }
+  return (int16_t)err;
 }
 
 /*
- * Sector 3:  A_OFF_LS | B_PWM_HS | C_FLOAT_POS
- *
- * ADC input from phase A resistor divider is taken as average back-EMF voltage
- * (previously phase-A was floating-falling transition).
-
- * Previous sector (2) phase-A was floating (negative-going transition) so ADC
- * input from phase A resistor divider is taken as average back-EMF voltage
- * during the negative-going float sector.
+ * Pass the back-EMF slope and ZCP estimate of a floating sector to the stall
+ * detector.
  */
-static void sector_3(void)
+static void stall_check(int16_t zcp_err)
 {
-#ifdef BUFFER_ADC_BEMF
-  Back_EMF_Falling_PhX = ( Back_EMF_Falling_PhX + Driver_Get_Back_EMF_Avg() ) >> 1;
-#else
-  Back_EMF_Falling_PhX = ( Back_EMF_Falling_PhX + Driver_Get_ADC() ) >> 1;
-#endif
-
-// C FLOAT POS
-  PWM_PhC_Disable(); //phase C PWM asserted off (positive-going float)
-  PWM_PhC_HB_DISABLE();
-
-// A OFF LS
-  PWM_PhA_OUTP_LO();
-  PWM_PhA_HB_ENABLE();
+  int16_t dv = (int16_t)( Driver_get_bemf_sample( DRIVER_BEMF_SMP_45 ) -
+                          Driver_get_bemf_sample( DRIVER_BEMF_SMP_15 ) );
+  uint16_t dt = bemf_sample_dt();
 
-// B PWM HS
-//  PWM_PhB_Enable(); // NO
-//  PWM_PhB_HB_ENABLE(); // NO-OP?
+  if (dv < 0)
+  {
+    dv = -dv;
+  }
+  Stall_on_sector( (uint16_t)dv, dt, zcp_err );
 }
 
 /*
- * Sector 4:  A_OFF_LS | B_FLOAT_NEG | C_PWM_HS,
+ * ZCP estimate and stall check of the floating sector from the back-EMF
+ * samples. There are no samples while the commutation is timed from the
+ * comparator (the lock is the stall check).
  */
-static void sector_4(void)
+static int16_t float_check(void)
 {
-// B FLOAT NEG
-  PWM_PhB_Disable(); // phase B PWM asserted off (negative going float)
-  PWM_PhB_HB_DISABLE();
+  int16_t zcp_err;
 
-// A OFF LS  (NO-OP?)
-  PWM_PhA_OUTP_LO();
-  PWM_PhA_HB_ENABLE();
+#if defined( BEMF_COMPARATOR )
+  if (FALSE != Zcp_is_locked())
+  {
+    return 0;
+  }
+#endif
+  zcp_err = zcp_estimate();
+  stall_check( zcp_err );
 
-// C PWM HS
-  PWM_PhC_Enable();
-  PWM_PhC_HB_ENABLE();
+  return zcp_err;
 }
 
 /*
- * Sector 5:  A_FLOAT_POS | B_OFF_LS | C_PWM_HS
+ * Measurements coordinated with the sector transitions - taken after the
+ * register image of the new sector is loaded, so that they do not add to the
+ * commutation latency.
  *
- * Note:  update the timing error term once per frame
+ *  Each sector: the phase floating in the previous sector is evaluated on its
+ *   own divider - the samples at 15 and 45 degrees for the ZCP estimate and
+ *   the latest ADC input as average back-EMF voltage of the float. Floats of
+ *   odd sectors are positive-going (taken at the even sectors), of even
+ *   sectors negative-going. The timing error term is updated from the latest
+ *   rising and falling floats, i.e. six times per electrical revolution.
+ *  The battery/system voltage is the ADC input from phase A resistor divider
+ *   during PWM on-time, taken in the scan while phase A is driven PWM.
+ *  Boards with the phase A divider only (no PH1_BEMF_IN_PORT) evaluate the
+ *   floats of phase A, i.e. at sectors 0 (rising) and 3 (falling).
+ * All inputs are from the same ADC scan snapshot.
  */
-static void sector_5(void)
+static void sector_measure(void)
 {
-// A FLOAT POS
-  PWM_PhA_OUTP_LO(); // phase A PWM asserted off (positive-going float)
-  PWM_PhA_HB_DISABLE();
+  uint8_t prev = (uint8_t)( ( Seq_step + SEQ_NR_SECTORS - 1 ) % SEQ_NR_SECTORS );
+  driver_adc_scan_t scan;
+  uint16_t bemf;
+
+  Driver_get_adc_scan( &scan );
 
-// B OFF LS
-  PWM_PhB_OUTP_LO();
-  PWM_PhB_HB_ENABLE();
+  Vbatt_ = scan.vbatt;
 
-// C PWM HS
-//  PWM_PhC_Enable();  // NO
-//  PWM_PhC_HB_ENABLE(); NO-OP?
+#if !defined( PH1_BEMF_IN_PORT )
+  if (DRIVER_PHASE_A != Seq_float_phase[ prev ])
+  {
+    return;
+  }
+#endif
 
+#ifdef BUFFER_ADC_BEMF
+  bemf = Driver_Get_Back_EMF_Avg();
+#else
+  bemf = scan.phase[ Seq_float_phase[ prev ] ];
+#endif
 
-// update the timing error once per frame
-//  comm_timing_error = (comm_timing_error + TIMING_ERROR_TERM) > 1; // sma
+  if (0 != ( prev & 1 ))
+  {
+    zcp_err_rising = float_check();
+    Back_EMF_Riseing_PhX = ( Back_EMF_Riseing_PhX + bemf ) >> 1;
+  }
+  else
+  {
+    zcp_err_falling = float_check();
+    Back_EMF_Falling_PhX = ( Back_EMF_Falling_PhX + bemf ) >> 1;
+  }
 
   // signed_error_ratio = ( post / pre ) - 1
   // Uses scalar of 64 to get most precision from ADC 10-bit terms (assuming max 0x03ff).
   // ADC 10-bit i.e. 0x03FF << 6 = 0xFFC0
   // Calculation result gets scaled down in conjunction with factoring in of
   //  controller gain term(s).
-  comm_tm_err_ratio =
-    (int16_t)( ( Back_EMF_Falling_PhX << SCALE_64_LSH ) / Back_EMF_Riseing_PhX )
-    - (int16_t)SCALE_64_ONE;
+  if (0 != Back_EMF_Riseing_PhX)
+  {
+    comm_tm_err_ratio =
+      (int16_t)( ( Back_EMF_Falling_PhX << SCALE_64_LSH ) / Back_EMF_Riseing_PhX )
+      - (int16_t)SCALE_64_ONE;
+  }
+}
+
+/*
+ * Load the register image of the present sector, and set its driven and
+ * floating phase for the ADC scan
+ */
+static void sector_load(void)
+{
+  const PWM_sector_image_t * pimg = &Seq_image_table[ Seq_step ];
+
+  PWM_SECTOR_IMAGE_LOAD( pimg );
+
+  Driver_set_sector_phases( Seq_pwm_phase[ Seq_step ], Seq_float_phase[ Seq_step ],
+                            (uint8_t)( Seq_step & 1 ) ); // odd sectors float positive-going
 }
 
 /* Public functions ---------------------------------------------------------*/
@@ -372,6 +449,20 @@ int16_t Seq_get_timing_error(void)
   return comm_tm_err_ratio; // positive if advanced
 }
 
+/**
+ * @brief Accessor for zero-crossing point error
+ *
+ * @details Average of the two-point ZCP estimates of the latest rising and
+ *  falling floating sectors.
+ *
+ * @return ZCP time relative to the 30 degree point of the sector (timestamp
+ *  counts), positive if the crossing occurs late.
+ */
+int16_t Seq_get_zcp_error(void)
+{
+  return (zcp_err_falling + zcp_err_rising) / 2;
+}
+
 /**
  * @brief  Accessor for back-EMF measurement.
  */
@@ -401,7 +492,7 @@ uint16_t Seq_Get_Vbatt(void)
 
 
 /**
- * @brief Public accessor for step 0 in the commutation sequence function table
+ * @brief Public accessor for step 0 in the commutation sequence table
  * 
  * @details The sequence is initialized by the Alignment to Ramp transition. The
  *     Alignment sets the Sector to 0 and waits some time for the motor to align.
@@ -411,7 +502,8 @@ uint16_t Seq_Get_Vbatt(void)
 void Sequence_Step_0(void)
 {
   Seq_step = SECTOR_0;
-  step_ptr_table[ Seq_step ]();
+  sector_load();
+  sector_measure();
 
   // point to sector 1 for next sequence step
   Seq_step = SECTOR_1;
@@ -425,23 +517,44 @@ void Sequence_Step_0(void)
 void Sequence_Step(void)
 {
   // note this sizeof and divide done in preprocessor - verified in the assembly
-  const uint8_t N_CSTEPS = sizeof(step_ptr_table) / sizeof(step_ptr_t);
+  const uint8_t N_CSTEPS = SEQ_NR_SECTORS;
 
 
 // has to cast modulus expression to uint8
   Seq_step = (uint8_t)(( Seq_step + 1 ) % N_CSTEPS);
 
-// intentionally letting motor windmill (i.e. not braking) when switched off
-// normally
+// sequencer lets the motor windmill when switched off, braking (if enabled)
+// is applied by the brake module
   if (BL_IS_RUNNING == BL_get_state() )
   {
     // let'er rip!
-    step_ptr_table[Seq_step]();
+    sector_load();
+    sector_measure();
   }
   else
   {
     // intitialize the average
     Back_EMF_Riseing_PhX = Back_EMF_Falling_PhX = Vbatt_ = 0;
+    zcp_err_rising = zcp_err_falling = 0;
+  }
+}
+
+/**
+ * @brief  Load the sector given by the rotor position (Hall sensor mode).
+ *
+ * @details  Commutates at once in place of stepping the timer-driven sequence.
+ *  An invalid sector (unknown position) is ignored.
+ *
+ * @param sector  Sector index (0:5)
+ */
+void Sequence_Set_Sector(uint8_t sector)
+{
+  if ( sector < SEQ_NR_SECTORS &&
+       BL_IS_RUNNING == BL_get_state() )
+  {
+    Seq_step = (Seq_sector_t)sector;
+    sector_load();
+    sector_measure();
   }
 }
 
@@ -0,0 +1,167 @@
+/**
+  ******************************************************************************
+  * @file stall.c
+  * @brief Stall and blocked-rotor detection
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup stall Stall Detection
+ * @brief Stall and blocked-rotor detection
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stall.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+/*
+ * The back-EMF amplitude is proportional to speed, so the change of the
+ * floating phase voltage over the 15-45 degree sample interval (dv) times the
+ * length of the interval (dt, inversely proportional to speed) is constant for
+ * the motor i.e. a back-EMF constant "ke" in ADC counts * timestamp counts.
+ * The reference ke is learned over the first sectors after the detector is
+ * armed (end of the open-loop ramp) as a sum of 2^STALL_LEARN_SH samples.
+ */
+#if defined( PH1_BEMF_IN_PORT )
+#define STALL_LEARN_SH       5
+#else
+#define STALL_LEARN_SH       4
+#endif
+#define STALL_LEARN_SECTORS  ( 1 << STALL_LEARN_SH )
+
+/*
+ * ke lower than 1/4 of the reference is a stall (blocked rotor, the floating
+ * phase stays flat near the neutral).
+ */
+#define STALL_KE_FRAC_SH     2
+
+/*
+ * Leaky count of violations: six measured sectors per electrical revolution
+ * (rising and falling float of each phase), so with +2/-1 the detector trips
+ * after 18 consecutive violations i.e. 3 electrical revolutions, and
+ * tolerates an occasional bad sample. With the phase A divider only, two
+ * measured sectors per revolution trip after 6 violations.
+ */
+#define STALL_VIOL_INCR      2
+#define STALL_VIOL_DECR      1
+#if defined( PH1_BEMF_IN_PORT )
+#define STALL_TRIP_CT        36
+#else
+#define STALL_TRIP_CT        12
+#endif
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint8_t Stall_armed;
+static uint8_t Stall_tripped;
+static uint8_t Stall_learn_ct;  // sectors remaining in the learning phase
+static uint8_t Stall_viol_ct;   // leaky count of violations
+static uint32_t Stall_ke_ref;   // learned reference ke
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Disarm the detector and clear the latched status
+ *
+ * @details Called at motor reset (BL_reset).
+ */
+void Stall_reset(void)
+{
+    Stall_armed = FALSE;
+    Stall_tripped = FALSE;
+    Stall_viol_ct = 0;
+    Stall_ke_ref = 0;
+}
+
+/**
+ * @brief Arm the detector and start learning the reference back-EMF constant
+ *
+ * @details Called by the state machine at the end of the open-loop ramp, the
+ *  back-EMF is not reliable at lower speed.
+ */
+void Stall_arm(void)
+{
+    Stall_reset();
+    Stall_learn_ct = STALL_LEARN_SECTORS;
+    Stall_armed = TRUE;
+}
+
+/**
+ * @brief Evaluate the stall conditions for a floating sector (ISR context)
+ *
+ * @details Two conditions are checked:
+ *  - back-EMF amplitude low for the speed (blocked rotor)
+ *  - ZCP persistently outside the sampled 15-45 degree window (lost sync),
+ *    which also catches a rotor that stalled while the reference was learned
+ *
+ * @param bemf_dv  Change of phase voltage over the sample interval (magnitude)
+ * @param dt       Sample interval, timestamp counts
+ * @param zcp_err  ZCP error relative to the 30 degree point, timestamp counts
+ */
+void Stall_on_sector(uint16_t bemf_dv, uint16_t dt, int16_t zcp_err)
+{
+    uint32_t ke;
+    uint8_t viol;
+
+    if (FALSE == Stall_armed || 0 == dt)
+    {
+        return; // no timestamp, nothing to check
+    }
+
+    ke = (uint32_t)bemf_dv * dt;
+
+    if (Stall_learn_ct > 0)
+    {
+        Stall_ke_ref += ke >> STALL_LEARN_SH;
+        Stall_learn_ct -= 1;
+        return;
+    }
+
+    viol = ( ke < ( Stall_ke_ref >> STALL_KE_FRAC_SH ) );
+
+    if (zcp_err < 0)
+    {
+        zcp_err = -zcp_err;
+    }
+    if ( (uint16_t)zcp_err > (dt >> 1) )
+    {
+        viol = TRUE;
+    }
+
+    if (viol)
+    {
+        Stall_viol_ct += STALL_VIOL_INCR;
+
+        if (Stall_viol_ct >= STALL_TRIP_CT)
+        {
+            Stall_viol_ct = STALL_TRIP_CT;
+            Stall_tripped = TRUE; // latched until reset
+        }
+    }
+    else if (Stall_viol_ct >= STALL_VIOL_DECR)
+    {
+        Stall_viol_ct -= STALL_VIOL_DECR;
+    }
+}
+
+/**
+ * @brief Accessor for stall status
+ *
+ * @return TRUE if a stall has been detected since the last reset
+ */
+uint8_t Stall_get_status(void)
+{
+    return Stall_tripped;
+}
+
+/**@}*/ // defgroup
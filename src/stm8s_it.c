@@ -14,6 +14,8 @@
 #include "stm8s_it.h"
 #include "system.h"
 #include "driver.h"
+#include "sched.h"
+#include "isr_prof.h"
 
 
 /** @addtogroup Template_Project
@@ -112,9 +114,9 @@ INTERRUPT_HANDLER(EXTI_PORTA_IRQHandler, 3)
   */
 INTERRUPT_HANDLER(EXTI_PORTB_IRQHandler, 4)
 {
-  /* In order to detect unexpected events during development,
-     it is recommended to set a breakpoint on the following instruction.
-  */
+#if defined( HALL_SENSOR )
+  Driver_on_hall_edge(); // Hall sensors on port B of both S105 boards
+#endif
 }
 
 /**
@@ -218,29 +220,34 @@ INTERRUPT_HANDLER(SPI_IRQHandler, 10)
 INTERRUPT_HANDLER(TIM1_UPD_OVF_TRG_BRK_IRQHandler, 11)
 {
 #if defined ( S003_DEV )
+    ISR_PROF_DECL
+
+    ISR_PROF_START();
+    ISR_PROF_LATENCY( PROF_COMM_LAT, MCU_get_comm_timer_count() );
+
     Driver_Step();
 
     // reset interrupt flag
     TIM1_ClearITPendingBit(TIM1_IT_UPDATE);
     TIM1_ClearFlag(TIM1_FLAG_UPDATE);
+
+    ISR_PROF_STOP( PROF_COMM_EXEC );
 #endif
 #if defined(S105_DEV) || defined (S105_DISCOVERY)
+    ISR_PROF_DECL
 
-    static const int Frame_count = 4;
-    static uint8_t frame_counter = 0;
+    ISR_PROF_START();
+    ISR_PROF_LATENCY( PROF_PWM_LAT, PWM_get_counter() );
 
-// note pre-increment on variable 
-    if ( ++frame_counter >= Frame_count )
-    {
-        frame_counter = 0;
+    Sched_on_PWM_frame(); // system tick
 
-        Driver_Update();
-    }
     Driver_on_PWM_edge(); // starts ADC conversion
 
     // reset interrupt flag
     TIM1_ClearITPendingBit(TIM1_IT_UPDATE);
     TIM1_ClearFlag(TIM1_FLAG_UPDATE);
+
+    ISR_PROF_STOP( PROF_PWM_EXEC );
 #endif
 }
 
@@ -251,7 +258,34 @@ INTERRUPT_HANDLER(TIM1_UPD_OVF_TRG_BRK_IRQHandler, 11)
   */
 INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
 {
-#if defined( S105_DISCOVERY ) && defined( HAS_SERVO_INPUT )
+#if defined( S105_DISCOVERY ) && defined( BEMF_COMPARATOR )
+    // pending and enabled (status and enable bits are at the same positions)
+    if ( 0 != ( TIM1->SR1 & TIM1->IER & TIM1_SR1_CC1IF ) )
+    {
+        TIM1->SR1 = (uint8_t)~TIM1_SR1_CC1IF;
+
+        Driver_on_zcp_capture();
+
+        if ( 0 == ( TIM1->SR1 & TIM1->IER & ( TIM1_SR1_CC3IF | TIM1_SR1_CC4IF ) ) )
+        {
+            return; // no servo capture pending
+        }
+    }
+#endif
+#if defined( S105_DISCOVERY ) && defined( HAS_SERVO_INPUT ) && defined( DSHOT_INPUT )
+    {
+        ISR_PROF_DECL
+
+        ISR_PROF_START();
+
+        // first edge of a DShot frame, the frame is captured and the flags
+        // cleared (lowest priority, preempted by the commutation/PWM/ADC ISRs)
+        Driver_on_capture_frame();
+
+        ISR_PROF_STOP( PROF_SRV_EXEC );
+    }
+
+#elif defined( S105_DISCOVERY ) && defined( HAS_SERVO_INPUT )
     if ( 0 != TIM1_GetFlagStatus(TIM1_FLAG_CC3) )
     {
 //        GPIOD->ODR &=  ~(1<<LED); // clear test pin
@@ -303,22 +337,20 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
   */
  INTERRUPT_HANDLER(TIM2_UPD_OVF_BRK_IRQHandler, 13)
 {
-    static const int Frame_count = 4;
-    static uint8_t frame_counter = 0;
+    ISR_PROF_DECL
 
-// note pre-increment on variable 
-    if ( ++frame_counter >= Frame_count )
-    {
-        frame_counter = 0;
+    ISR_PROF_START();
+    ISR_PROF_LATENCY( PROF_PWM_LAT, PWM_get_counter() );
 
-        Driver_Update();
-    }
+    Sched_on_PWM_frame(); // system tick
 
     Driver_on_PWM_edge(); // starts ADC conversion
 
     // reset interrupt flag
     TIM2_ClearITPendingBit(TIM2_IT_UPDATE); // TIM2 interrupt sources defined in stm8s_tim2.h
 //    TIM2->SR1 &= ~ TIM2_SR1_UIF; // Update Interrupt Flag mask defined in stm8s.h
+
+    ISR_PROF_STOP( PROF_PWM_EXEC );
 }
 
 /**
@@ -328,7 +360,34 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
   */
  INTERRUPT_HANDLER(TIM2_CAP_COM_IRQHandler, 14)
  {
-#if defined( S105_DEV ) && defined( HAS_SERVO_INPUT )
+#if defined( S105_DEV ) && defined( BEMF_COMPARATOR )
+    // pending and enabled (status and enable bits are at the same positions)
+    if ( 0 != ( TIM2->SR1 & TIM2->IER & TIM2_SR1_CC3IF ) )
+    {
+        TIM2->SR1 = (uint8_t)~TIM2_SR1_CC3IF;
+
+        Driver_on_zcp_capture();
+
+        if ( 0 == ( TIM2->SR1 & TIM2->IER & ( TIM2_SR1_CC1IF | TIM2_SR1_CC2IF ) ) )
+        {
+            return; // no servo capture pending
+        }
+    }
+#endif
+#if defined( S105_DEV ) && defined( HAS_SERVO_INPUT ) && defined( DSHOT_INPUT )
+    {
+        ISR_PROF_DECL
+
+        ISR_PROF_START();
+
+        // first edge of a DShot frame, the frame is captured and the flags
+        // cleared (lowest priority, preempted by the commutation/PWM/ADC ISRs)
+        Driver_on_capture_frame();
+
+        ISR_PROF_STOP( PROF_SRV_EXEC );
+    }
+
+#elif defined( S105_DEV ) && defined( HAS_SERVO_INPUT )
 
     if ( 0 != TIM2_GetFlagStatus(TIM2_FLAG_CC1) )
     {
@@ -358,10 +417,17 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
  INTERRUPT_HANDLER(TIM3_UPD_OVF_BRK_IRQHandler, 15)
  {
 #if defined( S105_DEV ) || defined(S105_DISCOVERY)
+    ISR_PROF_DECL
+
+    ISR_PROF_START();
+    ISR_PROF_LATENCY( PROF_COMM_LAT, MCU_get_comm_timer_count() );
+
     Driver_Step();
     // reset interrupt flag
 //    TIM3_ClearITPendingBit(TIM3_IT_UPDATE);
     TIM3->SR1 &= (uint8_t)~TIM3_SR1_UIF;
+
+    ISR_PROF_STOP( PROF_COMM_EXEC );
 #endif
  }
 
@@ -531,9 +597,15 @@ INTERRUPT_HANDLER(I2C_IRQHandler, 19)
   */
  INTERRUPT_HANDLER(ADC1_IRQHandler, 22)
  {
+    ISR_PROF_DECL
+
+    ISR_PROF_START();
+
     Driver_on_ADC_conv();
 
     ADC1_ClearFlag(ADC1_FLAG_EOC);
+
+    ISR_PROF_STOP( PROF_ADC_EXEC );
  }
 #endif /* (STM8S208) || (STM8S207) || (STM8AF52Ax) || (STM8AF62Ax) */
 
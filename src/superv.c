@@ -0,0 +1,128 @@
+/**
+  ******************************************************************************
+  * @file superv.c
+  * @brief Run-time supervisor - ISR overrun and background starvation, watchdog
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup superv Supervisor
+ * @brief Run-time supervisor - ISR overrun and background starvation, watchdog
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "superv.h"
+#include "mcu_stm8s.h" // watchdog
+#include "pwm_stm8s.h" // All_phase_stop
+
+/* Private defines -----------------------------------------------------------*/
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint8_t Superv_status;    // latched supervisor faults
+static uint8_t Superv_comm_ct;   // commutation ISR entries in this control frame
+static uint8_t Superv_bg_age;    // control frames since the background loop ran
+static uint8_t Superv_frame_ok;  // control frame checks ran and passed since the last kick
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Initialize the supervisor and start the watchdog
+ *
+ * @details Called once at startup, after the peripherals are initialized and
+ *  before interrupts are enabled.
+ */
+void Superv_init(void)
+{
+    Superv_status = 0;
+    Superv_comm_ct = 0;
+    Superv_bg_age = 0;
+    Superv_frame_ok = FALSE;
+
+    MCU_wdg_init();
+}
+
+/**
+ * @brief Count a commutation timer event (ISR context)
+ */
+void Superv_on_comm_isr(void)
+{
+    if (Superv_comm_ct < U8_MAX)
+    {
+        Superv_comm_ct += 1;
+    }
+}
+
+/**
+ * @brief Supervisor checks once per control frame (ISR context)
+ *
+ * @details Detects an overrun of the commutation ISR and starvation of the
+ *  background loop. A detected fault is latched and the phases are held off
+ *  at each frame. The watchdog is then no longer serviced, so the MCU is
+ *  reset if the fault persists past the watchdog timeout.
+ */
+void Superv_on_control_frame(void)
+{
+    if (Superv_comm_ct > SUPERV_COMM_ISR_MAX)
+    {
+        Superv_status |= SUPERV_ISR_OVERRUN;
+    }
+    Superv_comm_ct = 0;
+
+    if (Superv_bg_age < SUPERV_BG_TIMEOUT_FRAMES)
+    {
+        Superv_bg_age += 1;
+    }
+    else
+    {
+        Superv_status |= SUPERV_BG_STARVED;
+    }
+
+    if (0 != Superv_status)
+    {
+        All_phase_stop();
+    }
+    else
+    {
+        Superv_frame_ok = TRUE;
+    }
+}
+
+/**
+ * @brief Background loop check-in and watchdog service (non-ISR context)
+ *
+ * @details The watchdog is kicked only if the control frame checks have run
+ *  and passed since the last kick, so it also expires if the control frame
+ *  (PWM timer ISR) stops.
+ */
+void Superv_on_background(void)
+{
+    Superv_bg_age = 0;
+
+    if (FALSE != Superv_frame_ok && 0 == Superv_status)
+    {
+        Superv_frame_ok = FALSE;
+        MCU_wdg_kick();
+    }
+}
+
+/**
+ * @brief Accessor for the latched supervisor status
+ *
+ * @return 0 if no fault, else SUPERV_ISR_OVERRUN and/or SUPERV_BG_STARVED
+ */
+uint8_t Superv_get_status(void)
+{
+    return Superv_status;
+}
+
+/**@}*/ // defgroup
@@ -0,0 +1,127 @@
+/**
+  ******************************************************************************
+  * @file telem.c
+  * @brief eRPM telemetry encoder (bidirectional DShot)
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup telem Telemetry
+ * @brief eRPM telemetry encoder (bidirectional DShot)
+ *
+ * @details The electrical period of the motor is returned to the flight
+ *  controller on the DShot input pin in the gap after each throttle frame, so
+ *  its RPM filter tracks the motor with the latency of one frame.
+ *
+ *  The 16-bit reply frame is the period in us as a 9-bit mantissa and 3-bit
+ *  exponent (period = m << e) and the inverted 4-bit CRC. The frame is mapped
+ *  nibble-wise to a 20-bit GCR code (no more than 2 consecutive zeroes) and
+ *  sent as transitions: each 1 toggles the line, which starts with a low bit
+ *  from the idle high level. The reply is sent MSB first by the MCU layer.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "telem.h"
+
+#if defined( DSHOT_TELEM )
+
+/* Private defines -----------------------------------------------------------*/
+
+/*
+ * The commutation timer counts 0.125 us and its period is 1/4 of a sector,
+ * the electrical period is 6 sectors i.e. 3 us per count.
+ */
+#define TELEM_EPERIOD_PER_CT  3
+
+#define TELEM_MANT_BITS       9
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+/*
+ * 4-bit to 5-bit GCR
+ */
+static const uint8_t Telem_gcr_tbl[ 16 ] =
+{
+    0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17,
+    0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+};
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Electrical period of the motor from the commutation period
+ *
+ * @param comm_period  Commutation timer period (BL_get_timing)
+ *
+ * @return Electrical period in us, limited to TELEM_EPERIOD_MAX (stopped)
+ */
+uint16_t Telem_eperiod_us(uint16_t comm_period)
+{
+    uint32_t u32 = (uint32_t)comm_period * TELEM_EPERIOD_PER_CT;
+
+    return (u32 < TELEM_EPERIOD_MAX) ? (uint16_t)u32 : TELEM_EPERIOD_MAX;
+}
+
+/**
+ * @brief Encode the reply frame
+ *
+ * @param eperiod_us  Electrical period, us
+ *
+ * @return Exponent (3 bits), mantissa (9 bits) and inverted CRC (4 bits)
+ */
+uint16_t Telem_frame(uint16_t eperiod_us)
+{
+    uint16_t v;
+    uint8_t exp = 0;
+
+    while (eperiod_us >= ( 1 << TELEM_MANT_BITS ))
+    {
+        eperiod_us >>= 1;
+        exp += 1;
+    }
+
+    v = ( (uint16_t)exp << TELEM_MANT_BITS ) | eperiod_us;
+
+    return (uint16_t)( v << 4 ) | ( ~( v ^ ( v >> 4 ) ^ ( v >> 8 ) ) & 0x0F );
+}
+
+/**
+ * @brief GCR and transition coding of the reply frame
+ *
+ * @param frame  Reply frame (Telem_frame)
+ *
+ * @return Line levels of the TELEM_NR_BITS reply bits, right-aligned
+ */
+uint32_t Telem_gcr(uint16_t frame)
+{
+    uint32_t gcr = 0;
+    uint32_t line = 0;
+    uint8_t level = 0;
+    int8_t n;
+
+    for (n = 12; n >= 0; n -= 4)
+    {
+        gcr = ( gcr << 5 ) | Telem_gcr_tbl[ ( frame >> n ) & 0x0F ];
+    }
+
+    // start bit is low, then each 1 of the code toggles the level
+    for (n = TELEM_NR_BITS - 2; n >= 0; n--)
+    {
+        level ^= (uint8_t)( ( gcr >> n ) & 1 );
+        line = ( line << 1 ) | level;
+    }
+    return line;
+}
+
+#endif // DSHOT_TELEM
+
+/**@}*/ // defgroup
@@ -0,0 +1,270 @@
+/**
+  ******************************************************************************
+  * @file thr_shape.c
+  * @brief Throttle shaping - deadband, expo curve and slew-rate limit
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup thr_shape Throttle Shaping
+ * @brief Throttle shaping - deadband, expo curve and slew-rate limit
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "thr_shape.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+/*
+ * Deadband of about 2% of throttle range
+ */
+#define THR_DEADBAND_DEF   ( THR_FULL_SCALE / 50 )
+
+/*
+ * Slew limits per control frame (~1 ms): full range in about 0.25 seconds
+ * going up, and about twice that rate going down. Keeping the step size small
+ * at the low end prevents the current spike on a sharp stick step that
+ * desyncs the motor in open-loop.
+ */
+#define THR_SLEW_UP_DEF    ( THR_FULL_SCALE / 256 )
+#define THR_SLEW_DN_DEF    ( THR_FULL_SCALE / 128 )
+
+/*
+ * Q16 gain to rescale the range following the deadband to Q10, rounded up so
+ * that the full scale input maps to the end of the curve
+ */
+#define THR_DB_GAIN( _DB_ ) \
+  ( ( ( (uint32_t)THR_Q_ONE << 16 ) + ( THR_FULL_SCALE - (_DB_) - 1 ) ) / \
+      ( THR_FULL_SCALE - (_DB_) ) )
+
+#define THR_CURVE_SEG_W  ( THR_Q_ONE >> THR_CURVE_SEG_SH )  // segment width
+#define THR_CURVE_X_SH   ( THR_Q_SH - THR_CURVE_SEG_SH )   // shift to segment index
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+/**
+ * @brief Expo curve:  y = e * x^3 + (1 - e) * x   (e == 0.4)
+ * @details Softens response around the low end of the throttle where the
+ *  open-loop startup is most sensitive.
+ */
+static const uint16_t Thr_expo_curve[ THR_CURVE_NPTS ] =
+{
+   0, 78, 160, 252, 358, 484, 634, 812, 1024
+};
+
+static const thr_shape_cfg_t Thr_cfg_default =
+{
+    THR_DEADBAND_DEF,
+    THR_SLEW_UP_DEF,
+    THR_SLEW_DN_DEF,
+    Thr_expo_curve
+};
+
+// the default configuration is in effect without Thr_shape_init() (no servo
+// input, the UI throttle only)
+static thr_shape_cfg_t Thr_cfg =
+{
+    THR_DEADBAND_DEF,
+    THR_SLEW_UP_DEF,
+    THR_SLEW_DN_DEF,
+    Thr_expo_curve
+};
+
+// precomputed (Q16) gain to rescale the range following the deadband
+static uint32_t Thr_db_gain = THR_DB_GAIN( THR_DEADBAND_DEF );
+
+static uint16_t Thr_input;  // latest commanded throttle
+static uint16_t Thr_output; // slew-limited output
+static uint16_t Thr_base;   // output at the start of the control frame
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Piecewise-linear interpolation of the curve table, input and result Q10
+ */
+static uint16_t curve_lookup(uint16_t xq)
+{
+    const uint16_t * pcurve = Thr_cfg.pcurve;
+    uint8_t seg;
+    uint16_t frac;
+    uint16_t y0, y1;
+
+    if (xq >= THR_Q_ONE)
+    {
+        return pcurve[ THR_CURVE_NPTS - 1 ];
+    }
+
+    seg = (uint8_t)(xq >> THR_CURVE_X_SH);
+    frac = xq & (THR_CURVE_SEG_W - 1);
+    y0 = pcurve[ seg ];
+    y1 = pcurve[ seg + 1 ];
+
+    // curve must be monotonic, y1 >= y0
+    return y0 + (uint16_t)( ( (uint32_t)(y1 - y0) * frac ) >> THR_CURVE_X_SH );
+}
+
+/*
+ * Deadband and curve applied to the input ... result in full scale counts
+ */
+static uint16_t shape_target(uint16_t input)
+{
+    uint16_t xq;
+
+    if (input <= Thr_cfg.deadband)
+    {
+        return 0;
+    }
+
+    if (input > THR_FULL_SCALE)
+    {
+        input = THR_FULL_SCALE;
+    }
+
+    // remove the deadband, rescale to Q10
+    xq = (uint16_t)( ( (uint32_t)(input - Thr_cfg.deadband) * Thr_db_gain ) >> 16 );
+
+    return (uint16_t)( ( (uint32_t)curve_lookup( xq ) * THR_FULL_SCALE ) >> THR_Q_SH );
+}
+
+/*
+ * Target limited by the up/down slew rates from the output at the start of the
+ * control frame
+ */
+static uint16_t slew_limit(uint16_t target)
+{
+    uint16_t base = Thr_base;
+
+    if (target > base)
+    {
+        if ( (target - base) > Thr_cfg.slew_up )
+        {
+            target = base + Thr_cfg.slew_up;
+        }
+    }
+    else if (target < base)
+    {
+        if ( (base - target) > Thr_cfg.slew_dn )
+        {
+            target = base - Thr_cfg.slew_dn;
+        }
+    }
+
+    return target;
+}
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Initialize throttle shaping with the default configuration
+ */
+void Thr_shape_init(void)
+{
+    Thr_shape_config( &Thr_cfg_default );
+}
+
+/**
+ * @brief Load a throttle shaping configuration
+ *
+ * @details The deadband rescaling factor is computed here so that the update
+ *  (control frame) does not divide. Expect to be called from non-ISR context
+ *  with interrupts disabled.
+ *
+ * @param pcfg  Pointer to configuration, the curve table is referenced not copied.
+ */
+void Thr_shape_config(const thr_shape_cfg_t * pcfg)
+{
+    Thr_cfg = *pcfg;
+
+    if (Thr_cfg.deadband >= THR_FULL_SCALE)
+    {
+        Thr_cfg.deadband = THR_DEADBAND_DEF;
+    }
+
+    // normalizing factor, Q10 / (full scale - deadband), in Q16
+    Thr_db_gain = THR_DB_GAIN( Thr_cfg.deadband );
+
+    Thr_shape_reset();
+}
+
+/**
+ * @brief Reset the throttle command and output immediately to 0
+ */
+void Thr_shape_reset(void)
+{
+    Thr_input = 0;
+    Thr_output = 0;
+    Thr_base = 0;
+}
+
+/**
+ * @brief Set the commanded throttle
+ * @param input  Commanded throttle, range (0:THR_FULL_SCALE)
+ */
+void Thr_shape_set_input(uint16_t input)
+{
+    Thr_input = input;
+}
+
+/**
+ * @brief Evaluate the throttle shaping stage
+ *
+ * @details Called once per control frame. The output tracks the shaped target
+ *  limited by the configured up/down slew rates.
+ *
+ * @return Shaped throttle, range (0:THR_FULL_SCALE)
+ */
+uint16_t Thr_shape_update(void)
+{
+    Thr_base = Thr_output;
+    Thr_output = slew_limit( shape_target( Thr_input ) );
+
+    return Thr_output;
+}
+
+/**
+ * @brief Re-evaluate the shaping stage within the present control frame
+ *
+ * @details Called when a new input is set between control frames (digital
+ *  throttle frame). The output tracks the shaped target limited to one slew
+ *  step from the output at the start of the frame, so the slew rate does not
+ *  depend on the input rate.
+ *
+ * @return Shaped throttle, range (0:THR_FULL_SCALE)
+ */
+uint16_t Thr_shape_track(void)
+{
+    Thr_output = slew_limit( shape_target( Thr_input ) );
+
+    return Thr_output;
+}
+
+/**
+ * @brief Set the shaped throttle to the value applied by a downstream limiter
+ *
+ * @details The next update slews from this value rather than stepping to the
+ *  output of the stage (control frame, ISR context).
+ *
+ * @param output  Throttle held by the limiter, range (0:THR_FULL_SCALE)
+ */
+void Thr_shape_set_output(uint16_t output)
+{
+    Thr_output = output;
+    Thr_base = output;
+}
+
+/**
+ * @brief Accessor for the shaped throttle
+ */
+uint16_t Thr_shape_get_output(void)
+{
+    return Thr_output;
+}
+
+/**@}*/ // defgroup
@@ -0,0 +1,194 @@
+/**
+  ******************************************************************************
+  * @file zcp.c
+  * @brief Comparator zero-crossing capture
+  * @author Neidermeier
+  * @version
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/**
+ * \defgroup zcp Comparator ZCP
+ * @brief Comparator zero-crossing capture
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "zcp.h"
+
+#if defined( BEMF_COMPARATOR )
+
+/* Private defines -----------------------------------------------------------*/
+
+/* Private types -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint16_t Zcp_comm_tm;  // timestamp of the commutation (sector start)
+static uint16_t Zcp_blank;    // blanking window of the sector
+static uint8_t Zcp_found;     // ZCP captured in the present sector
+static uint8_t Zcp_prev_ok;   // ZCP captured in the previous sector
+
+static uint16_t Zcp_tm;       // timestamp of the latest ZCP
+static uint16_t Zcp_dt;       // latest ZCP to ZCP interval
+static uint16_t Zcp_perd;     // sector period
+
+static uint8_t Zcp_lock_ct;   // consecutive sectors with a ZCP
+static uint8_t Zcp_miss_ct;   // consecutive sectors without a ZCP
+static uint8_t Zcp_locked;
+static uint8_t Zcp_lost;      // lock lost, latched until reset
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private functions ---------------------------------------------------------*/
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Clear the lock and the latched status
+ *
+ * @details Called at motor reset (BL_reset).
+ */
+void Zcp_reset(void)
+{
+    Zcp_found = FALSE;
+    Zcp_prev_ok = FALSE;
+    Zcp_dt = 0;
+    Zcp_perd = 0;
+    Zcp_lock_ct = 0;
+    Zcp_miss_ct = 0;
+    Zcp_locked = FALSE;
+    Zcp_lost = FALSE;
+}
+
+/**
+ * @brief Start of a sector (commutation ISR)
+ *
+ * @details Opens the blanking window, and counts the previous sector if it
+ *  had no ZCP - the lock is lost after ZCP_MISS_MAX sectors in a row.
+ *
+ * @param tm           Timestamp of the commutation, 0.5 us counts
+ * @param sector_perd  Present sector period (commutation period), timestamp counts
+ */
+void Zcp_on_commutation(uint16_t tm, uint16_t sector_perd)
+{
+    if (FALSE == Zcp_found)
+    {
+        Zcp_prev_ok = FALSE; // next interval would span two sectors
+        Zcp_lock_ct = 0;
+
+        if (FALSE != Zcp_locked)
+        {
+            Zcp_miss_ct += 1;
+
+            if (Zcp_miss_ct >= ZCP_MISS_MAX)
+            {
+                Zcp_locked = FALSE;
+                Zcp_lost = TRUE;
+            }
+        }
+    }
+    else
+    {
+        Zcp_miss_ct = 0;
+    }
+
+    Zcp_comm_tm = tm;
+    Zcp_found = FALSE;
+
+    Zcp_blank = sector_perd >> ZCP_BLANK_SH;
+
+    if (Zcp_blank < ZCP_BLANK_MIN)
+    {
+        Zcp_blank = ZCP_BLANK_MIN;
+    }
+}
+
+/**
+ * @brief Comparator edge captured (capture ISR)
+ *
+ * @details The first edge after the blanking window is the ZCP of the sector.
+ *  The sector period is the average of the latest two ZCP intervals, which
+ *  cancels the offset of the comparator between rising and falling floats.
+ *  The next commutation is due at 30 degrees (half the sector) after the ZCP,
+ *  less the advance and the time already elapsed in servicing the capture.
+ *
+ * @param t_zcp   Captured timestamp of the edge, 0.5 us counts
+ * @param t_now   Present timestamp
+ * @param pdelay  Time from now to the commutation, timestamp counts
+ *
+ * @return TRUE if the edge is the ZCP of the sector (capture may be disabled
+ *  until the next commutation)
+ */
+uint8_t Zcp_on_capture(uint16_t t_zcp, uint16_t t_now, uint16_t * pdelay)
+{
+    uint16_t due;
+    uint16_t elapsed = t_now - t_zcp;
+
+    if (FALSE != Zcp_found || (uint16_t)( t_zcp - Zcp_comm_tm ) < Zcp_blank)
+    {
+        return FALSE; // second edge (chatter), or in the blanking window
+    }
+    Zcp_found = TRUE;
+
+    if (FALSE != Zcp_prev_ok)
+    {
+        uint16_t dt = t_zcp - Zcp_tm;
+
+        Zcp_perd = (0 != Zcp_dt) ?
+                   (uint16_t)( ( (uint32_t)dt + Zcp_dt ) >> 1 ) : dt;
+        Zcp_dt = dt;
+
+        if (Zcp_lock_ct < ZCP_LOCK_CT)
+        {
+            Zcp_lock_ct += 1;
+        }
+        if (Zcp_lock_ct >= ZCP_LOCK_CT)
+        {
+            Zcp_locked = TRUE;
+        }
+    }
+    Zcp_tm = t_zcp;
+    Zcp_prev_ok = TRUE;
+
+    due = ( Zcp_perd >> 1 ) - ( Zcp_perd >> ZCP_ADV_SH );
+    *pdelay = (elapsed < due) ? due - elapsed : 0;
+
+    return TRUE;
+}
+
+/**
+ * @brief Accessor for lock status
+ *
+ * @return TRUE if a ZCP has been captured in each of the latest ZCP_LOCK_CT
+ *  sectors, the commutation may be timed from the ZCP
+ */
+uint8_t Zcp_is_locked(void)
+{
+    return Zcp_locked;
+}
+
+/**
+ * @brief Accessor for the sector period
+ *
+ * @return sector period from the ZCP intervals, timestamp counts (same unit as
+ *  the commutation period), 0 if not measured
+ */
+uint16_t Zcp_get_period(void)
+{
+    return Zcp_perd;
+}
+
+/**
+ * @brief Accessor for the capture status
+ *
+ * @return TRUE if the lock was lost since the last reset (motor out of sync)
+ */
+uint8_t Zcp_get_status(void)
+{
+    return Zcp_lost;
+}
+
+#endif // BEMF_COMPARATOR
+
+/**@}*/ // defgroup
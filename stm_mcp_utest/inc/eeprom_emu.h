@@ -0,0 +1,27 @@
+/**
+  ******************************************************************************
+  * @file    eeprom_emu.h
+  * @brief   File-backed emulation of the STM8S data EEPROM for host builds
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+#ifndef EEPROM_EMU_H
+#define EEPROM_EMU_H
+
+#include <stdint.h>
+
+/*
+ * size of the emulated data EEPROM (STM8S105)
+ */
+#define EEPROM_EMU_SIZE  1024
+
+int Eeprom_emu_open(const char * path);
+void Eeprom_emu_close(void);
+
+void Eeprom_emu_poke(uint16_t offset, uint8_t value);
+uint32_t Eeprom_emu_get_wear(uint16_t offset);
+uint32_t Eeprom_emu_get_nr_writes(void);
+
+#endif // EEPROM_EMU_H
@@ -0,0 +1,105 @@
+/**
+  ******************************************************************************
+  * @file    stm8s.h
+  * @brief   Host stand-in for the STM8S toolchain/SPL header.
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  *
+  * horrors of unit testing ... provides only the types and constants that the
+  * application headers need in order to build the modules under test on the host.
+  */
+#ifndef STM8S_H
+#define STM8S_H
+
+#include <stdint.h>
+
+#define FALSE  0
+#define TRUE   1
+
+#define U8_MAX   ((uint8_t)255)
+#define S8_MAX   ((int8_t)127)
+#define U16_MAX  ((uint16_t)65535u)
+#define S16_MAX  ((int16_t)32767)
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus;
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } FunctionalState;
+
+typedef struct
+{
+    volatile uint8_t ODR;
+    volatile uint8_t IDR;
+    volatile uint8_t DDR;
+    volatile uint8_t CR1;
+    volatile uint8_t CR2;
+}
+GPIO_TypeDef;
+
+typedef enum
+{
+    GPIO_PIN_0 = 0x01,
+    GPIO_PIN_1 = 0x02,
+    GPIO_PIN_2 = 0x04,
+    GPIO_PIN_3 = 0x08,
+    GPIO_PIN_4 = 0x10,
+    GPIO_PIN_5 = 0x20,
+    GPIO_PIN_6 = 0x40,
+    GPIO_PIN_7 = 0x80
+}
+GPIO_Pin_TypeDef;
+
+/*
+ * timer registers used by the PWM phase control macros (pwm_stm8s.h), the
+ * register blocks are host variables defined by the test
+ */
+typedef struct
+{
+    volatile uint8_t CR1, CR2, SMCR, ETR, IER, SR1, SR2, EGR;
+    volatile uint8_t CCMR1, CCMR2, CCMR3, CCMR4, CCER1, CCER2;
+    volatile uint8_t CNTRH, CNTRL, PSCRH, PSCRL, ARRH, ARRL, RCR;
+    volatile uint8_t CCR1H, CCR1L, CCR2H, CCR2L, CCR3H, CCR3L, CCR4H, CCR4L;
+    volatile uint8_t BKR, DTR, OISR;
+}
+TIM1_TypeDef;
+
+typedef struct
+{
+    volatile uint8_t CR1, IER, SR1, SR2, EGR, CCMR1, CCMR2, CCMR3, CCER1, CCER2;
+    volatile uint8_t CNTRH, CNTRL, PSCR, ARRH, ARRL;
+    volatile uint8_t CCR1H, CCR1L, CCR2H, CCR2L, CCR3H, CCR3L;
+}
+TIM2_TypeDef;
+
+#define TIM1_CCER1_CC1E  ((uint8_t)0x01)
+#define TIM1_CCER1_CC2E  ((uint8_t)0x10)
+#define TIM1_CCER2_CC3E  ((uint8_t)0x01)
+#define TIM1_CCER2_CC4E  ((uint8_t)0x10)
+
+#define TIM2_CCER1_CC1E  ((uint8_t)0x01)
+#define TIM2_CCER1_CC2E  ((uint8_t)0x10)
+#define TIM2_CCER2_CC3E  ((uint8_t)0x01)
+
+extern TIM1_TypeDef Host_TIM1;
+extern TIM2_TypeDef Host_TIM2;
+extern GPIO_TypeDef Host_GPIOA, Host_GPIOC, Host_GPIOD, Host_GPIOE;
+
+#define TIM1   (&Host_TIM1)
+#define TIM2   (&Host_TIM2)
+#define GPIOA  (&Host_GPIOA)
+#define GPIOC  (&Host_GPIOC)
+#define GPIOD  (&Host_GPIOD)
+#define GPIOE  (&Host_GPIOE)
+
+typedef enum
+{
+    TIM2_CHANNEL_1 = 0,
+    TIM2_CHANNEL_2 = 1,
+    TIM2_CHANNEL_3 = 2
+}
+TIM2_Channel_TypeDef;
+
+#define enableInterrupts()
+#define disableInterrupts()
+
+#endif // STM8S_H
@@ -0,0 +1,138 @@
+/**
+  ******************************************************************************
+  * @file    eeprom_emu.c
+  * @brief   File-backed emulation of the STM8S data EEPROM for host builds
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  *
+  * Implements the MCU EEPROM access (mcu_stm8s.h) on a RAM image which is
+  * loaded from and written through to a file, so that the content persists
+  * across runs of the host program like the EEPROM persists across a reset.
+  * A missing file is a blank (erased, all 0) EEPROM.
+  */
+#include <stdio.h>
+#include <string.h>
+
+#include "eeprom_emu.h"
+#include "mcu_stm8s.h"
+
+
+static uint8_t Emu_image[ EEPROM_EMU_SIZE ];
+static uint32_t Emu_wear[ EEPROM_EMU_SIZE / 4 ]; // program cycles per word
+static uint32_t Emu_writes;
+static FILE * Emu_file;
+
+
+static void emu_flush(void)
+{
+    if (NULL != Emu_file)
+    {
+        fseek(Emu_file, 0, SEEK_SET);
+        fwrite(Emu_image, 1, sizeof(Emu_image), Emu_file);
+        fflush(Emu_file);
+    }
+}
+
+/*
+ * open (or create) the backing file, returns 0 if ok
+ */
+int Eeprom_emu_open(const char * path)
+{
+    Eeprom_emu_close();
+
+    memset(Emu_image, 0, sizeof(Emu_image));
+
+    Emu_file = fopen(path, "r+b");
+
+    if (NULL != Emu_file)
+    {
+        if (fread(Emu_image, 1, sizeof(Emu_image), Emu_file) != sizeof(Emu_image))
+        {
+            memset(Emu_image, 0, sizeof(Emu_image)); // short file, blank
+        }
+    }
+    else
+    {
+        // new device, wear counts are kept over reopen (reset) of the file
+        memset(Emu_wear, 0, sizeof(Emu_wear));
+        Emu_writes = 0;
+
+        Emu_file = fopen(path, "w+b");
+
+        if (NULL == Emu_file)
+        {
+            return -1;
+        }
+        emu_flush();
+    }
+    return 0;
+}
+
+void Eeprom_emu_close(void)
+{
+    if (NULL != Emu_file)
+    {
+        fclose(Emu_file);
+        Emu_file = NULL;
+    }
+}
+
+/*
+ * corrupt a byte (write through, not counted as a program cycle)
+ */
+void Eeprom_emu_poke(uint16_t offset, uint8_t value)
+{
+    if (offset < EEPROM_EMU_SIZE)
+    {
+        Emu_image[ offset ] = value;
+        emu_flush();
+    }
+}
+
+uint32_t Eeprom_emu_get_wear(uint16_t offset)
+{
+    return (offset < EEPROM_EMU_SIZE) ? Emu_wear[ offset / 4 ] : 0;
+}
+
+uint32_t Eeprom_emu_get_nr_writes(void)
+{
+    return Emu_writes;
+}
+
+/*
+ * MCU EEPROM interface
+ */
+void MCU_eeprom_read(uint16_t offset, uint8_t * pbuf, uint8_t len)
+{
+    while (len-- > 0)
+    {
+        *pbuf++ = (offset < EEPROM_EMU_SIZE) ? Emu_image[ offset ] : 0;
+        offset += 1;
+    }
+}
+
+uint8_t MCU_eeprom_write(uint16_t offset, const uint8_t * pbuf, uint8_t len)
+{
+    // word programming only, as on the target
+    if ( (offset & 3) || (len & 3) || (offset + len) > EEPROM_EMU_SIZE )
+    {
+        return 1;
+    }
+
+    while (len >= 4)
+    {
+        memcpy(&Emu_image[ offset ], pbuf, 4);
+        Emu_wear[ offset / 4 ] += 1;
+
+        offset += 4;
+        pbuf += 4;
+        len -= 4;
+    }
+    Emu_writes += 1;
+
+    emu_flush();
+
+    return 0;
+}
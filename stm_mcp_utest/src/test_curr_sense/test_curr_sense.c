@@ -0,0 +1,215 @@
+/**
+  ******************************************************************************
+  * @file    test_curr_sense.c
+  * @brief   test driver for curr_sense.c (simulated current waveform)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "curr_sense.h"
+#include "faultm.h"
+
+
+/*
+ * stubs for the fault manager freeze-frame data
+ */
+uint8_t BL_get_opstate(void) { return 0; }
+uint16_t BL_get_timing(void) { return 0; }
+uint16_t BL_get_speed(void) { return 0; }
+uint16_t Seq_Get_Vbatt(void) { return 0; }
+
+/*
+ * PWM cycles per fault manager update (PWM @ ~8 kHz, background task @ 60 Hz)
+ */
+#define PWM_CYCLES_PER_TASK  128
+
+/*
+ * Simulated motor current sampled at the start of the PWM on-window. First
+ * order response toward the current driven by the (trimmed) duty-cycle
+ * against the back-EMF, plus a ripple term at 6 sectors of the commutation.
+ *   i_ss = ( duty * Vbus - bemf ) / R     ... expressed in ADC counts
+ */
+static uint16_t Sim_duty;    // commanded duty-cycle, PWM counts
+static uint16_t Sim_bemf;    // back-EMF, in ADC current counts at full duty
+static uint16_t Sim_gain;    // current counts at full duty and zero back-EMF
+static uint16_t Sim_ripple;  // peak ripple, ADC counts
+static int32_t  Sim_current; // present current, ADC counts
+static uint32_t Sim_cycle;
+
+static uint16_t sim_sample(uint16_t trim)
+{
+    int32_t duty = (int32_t)Sim_duty - trim;
+    int32_t i_ss;
+    int32_t ripple = 0;
+
+    if (duty < 0)
+    {
+        duty = 0;
+    }
+    i_ss = ( duty * Sim_gain ) / PWM_PERIOD_COUNTS - Sim_bemf;
+
+    if (i_ss < 0)
+    {
+        i_ss = 0; // no regen in this model
+    }
+
+    // tau == 4 PWM cycles
+    Sim_current += (i_ss - Sim_current) / 4;
+
+    // triangular ripple, period of 32 PWM cycles
+    if (Sim_ripple > 0)
+    {
+        int32_t ph = (int32_t)(Sim_cycle & 31);
+        ripple = (ph < 16) ? ph : (32 - ph);
+        ripple = ( ripple * Sim_ripple ) / 16;
+    }
+    Sim_cycle += 1;
+
+    return (uint16_t)( Sim_current + ripple + CURR_ADC_OFFSET );
+}
+
+static void sim_start(uint16_t duty, uint16_t gain, uint16_t bemf, uint16_t ripple)
+{
+    Curr_reset();
+    Faultm_init();
+
+    Sim_duty = duty;
+    Sim_gain = gain;
+    Sim_bemf = bemf;
+    Sim_ripple = ripple;
+    Sim_current = 0;
+    Sim_cycle = 0;
+}
+
+/*
+ * run one background task period of PWM cycles and update the fault manager
+ */
+static void sim_task_frame(uint16_t * pmax_sample)
+{
+    int n;
+    uint16_t trim = Curr_get_dc_trim();
+
+    for (n = 0; n < PWM_CYCLES_PER_TASK; n++)
+    {
+        uint16_t sample = sim_sample( trim );
+
+        trim = Curr_on_sample( sample );
+
+        if (sample > *pmax_sample)
+        {
+            *pmax_sample = sample;
+        }
+    }
+    Faultm_upd(OVERCURRENT, (faultm_assert_t)( Curr_get_avg() > CURR_AVG_LIMIT) );
+}
+
+/*
+ * stalled rotor at full duty: current would be 4x the peak limit, expect the
+ * per-cycle limit to hold the peak, and the average fault to latch
+ */
+int test_case_stall_iteration(void)
+{
+    static int frames = 0;
+    uint16_t max_sample = 0;
+
+    sim_task_frame(&max_sample);
+    frames += 1;
+
+    // allow one frame for the trim to build up
+    if (frames > 1 && max_sample > (CURR_PEAK_LIMIT + CURR_PEAK_LIMIT / 8))
+    {
+        printf(" stall: peak %u > limit %u (trim %u)\n",
+               max_sample, CURR_PEAK_LIMIT, Curr_get_dc_trim());
+        return TEST_FAIL;
+    }
+
+    if (0 != (Faultm_get_status() & FAULTM_STATUS_BIT( OVERCURRENT )))
+    {
+        printf(" stall: fault after %d frames, avg %u trim %u\n",
+               frames, Curr_get_avg(), Curr_get_dc_trim());
+        return TEST_DONE;
+    }
+    return TEST_OK;
+}
+
+/*
+ * normal running load: no trim and no fault
+ */
+int test_case_normal_iteration(void)
+{
+    uint16_t max_sample = 0;
+
+    sim_task_frame(&max_sample);
+
+    if (0 != Curr_get_dc_trim() || 0 != Faultm_get_status())
+    {
+        printf(" normal: trim %u status %X\n", Curr_get_dc_trim(), Faultm_get_status());
+        return TEST_FAIL;
+    }
+    return TEST_OK;
+}
+
+/*
+ * ripple with peaks over the average limit (but not over the peak limit)
+ * while the average is under the limit: no fault
+ */
+int test_case_ripple_iteration(void)
+{
+    uint16_t max_sample = 0;
+
+    sim_task_frame(&max_sample);
+
+    if (0 != Faultm_get_status())
+    {
+        printf(" ripple: fault, avg %u max %u\n", Curr_get_avg(), max_sample);
+        return TEST_FAIL;
+    }
+    if (max_sample <= CURR_AVG_LIMIT)
+    {
+        printf(" ripple: test waveform peak %u not over avg limit\n", max_sample);
+        return TEST_FAIL;
+    }
+    return TEST_OK;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    // stall: 160 A at full duty, no back-EMF
+    sim_start(PWM_PERIOD_COUNTS, CURR_AMPS_TO_COUNTS( 160 ), 0, 0);
+    putf_n_iterations(1000, &test_case_stall_iteration, "test_case_stall_iteration");
+
+    // running: 50% duty, 60 A - 40 A back-EMF -> ~10 A
+    sim_start(PWM_PERIOD_COUNTS / 2, CURR_AMPS_TO_COUNTS( 60 ), CURR_AMPS_TO_COUNTS( 20 ), 0);
+    putf_n_iterations(200, &test_case_normal_iteration, "test_case_normal_iteration");
+
+    // running: 20 A plus 14 A triangular ripple i.e. ~27 A average, 34 A peaks
+    sim_start(PWM_PERIOD_COUNTS / 2, CURR_AMPS_TO_COUNTS( 96 ), CURR_AMPS_TO_COUNTS( 28 ),
+              CURR_AMPS_TO_COUNTS( 14 ));
+    putf_n_iterations(200, &test_case_ripple_iteration, "test_case_ripple_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
@@ -0,0 +1,253 @@
+/**
+  ******************************************************************************
+  * @file    test_dshot.c
+  * @brief   test driver for dshot.c (synthetic capture timestamps)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "dshot.h"
+
+
+/*
+ * Signal generator: bit timing in us, the capture timer counts at 0.5 us and
+ * wraps at 16 bits. The frame is passed to the decoder with the timestamps of
+ * the rising and falling edge of each bit, as the capture ISR does at the end
+ * of the frame.
+ */
+#define US_150        ( 20.0 / 3 )
+#define US_300        ( 10.0 / 3 )
+#define FRAME_GAP_US  20.0
+
+static double Sim_t_us;          // time of the next rising edge
+static double Sim_jitter_us;     // +/- edge jitter
+static uint32_t Sim_rand = 1;
+static int Sim_drop_bit = -1;    // bit not captured (missed edge), -1 if none
+static double Sim_last_fall_us;  // falling edge of the last bit sent
+
+static double jitter(void)
+{
+    Sim_rand = Sim_rand * 1103515245 + 12345;
+
+    return Sim_jitter_us * ( (double)( (Sim_rand >> 16) % 201 ) / 100.0 - 1.0 );
+}
+
+static uint16_t capture(double t_us)
+{
+    return (uint16_t)( (uint32_t)( t_us * DSHOT_CT_PER_US ) & 0xFFFF );
+}
+
+static uint16_t frame_encode(uint16_t value, uint8_t telem)
+{
+    uint16_t v = (uint16_t)( ( value << 1 ) | telem );
+    uint16_t crc = ( v ^ ( v >> 4 ) ^ ( v >> 8 ) ) & 0x0F;
+
+    return (uint16_t)( ( v << 4 ) | crc );
+}
+
+static void send_frame(uint16_t frame, double bit_us)
+{
+    uint16_t t_start[ DSHOT_FRAME_BITS ];
+    uint16_t t_end[ DSHOT_FRAME_BITS ];
+    uint8_t nr_bits = 0;
+    int n;
+
+    for (n = 15; n >= 0; n--)
+    {
+        double high = ( frame & ( 1 << n ) ) ? bit_us * 3 / 4 : bit_us * 3 / 8;
+        double t_rise = Sim_t_us + jitter();
+        double t_fall = Sim_t_us + high + jitter();
+
+        if (n != Sim_drop_bit)
+        {
+            t_start[ nr_bits ] = capture( t_rise );
+            t_end[ nr_bits ] = capture( t_fall );
+            nr_bits += 1;
+        }
+        Sim_last_fall_us = t_fall;
+        Sim_t_us += bit_us;
+    }
+    Dshot_on_frame( t_start, t_end, nr_bits );
+
+    Sim_t_us += FRAME_GAP_US;
+}
+
+static void sim_start(double jitter_us)
+{
+    Dshot_reset();
+
+    Sim_t_us = 32000.0; // capture timer wraps after 32768 us
+    Sim_jitter_us = jitter_us;
+    Sim_drop_bit = -1;
+}
+
+/*
+ * every throttle value is decoded, the result is ready at the last edge of
+ * the frame
+ */
+static int sweep_values(double bit_us, uint16_t rate)
+{
+    static uint16_t value = DSHOT_THR_MIN;
+    uint16_t decoded = 0;
+    double t_start = Sim_t_us;
+
+    send_frame( frame_encode( value, value & 1 ), bit_us );
+
+    if (FALSE == Dshot_get_value( &decoded ) || decoded != value)
+    {
+        printf(" sweep: sent %u decoded %u errors %u\n", value, decoded, Dshot_get_errors());
+        return TEST_FAIL;
+    }
+    if (rate != Dshot_get_rate())
+    {
+        printf(" sweep: rate %u\n", Dshot_get_rate());
+        return TEST_FAIL;
+    }
+
+    if (value++ >= DSHOT_THR_MAX)
+    {
+        printf(" DShot%u: frame to value %.1f us, errors %u\n",
+               rate, Sim_last_fall_us - t_start, Dshot_get_errors());
+        value = DSHOT_THR_MIN;
+        return (0 == Dshot_get_errors()) ? TEST_DONE : TEST_FAIL;
+    }
+    return TEST_OK;
+}
+
+int test_case_dshot150_iteration(void)
+{
+    return sweep_values( US_150, 150 );
+}
+
+int test_case_dshot300_iteration(void)
+{
+    return sweep_values( US_300, 300 );
+}
+
+/*
+ * a frame with a bad CRC is dropped, the previous value is kept
+ */
+int test_case_crc_iteration(void)
+{
+    uint16_t value;
+
+    send_frame( frame_encode( 1000, 0 ), US_300 );
+    Dshot_get_value( &value );
+
+    send_frame( frame_encode( 1500, 0 ) ^ 0x0100, US_300 );
+
+    if (FALSE != Dshot_get_value( &value ) || 1000 != value || 1 != Dshot_get_errors() ||
+        2 != Dshot_get_frames())
+    {
+        printf(" crc: value %u errors %u frames %u\n",
+               value, Dshot_get_errors(), Dshot_get_frames());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * a missed edge drops the frame, the decoder resyncs at the next frame
+ */
+int test_case_missed_edge_iteration(void)
+{
+    uint16_t value = 0;
+
+    Sim_drop_bit = 7;
+    send_frame( frame_encode( 1200, 0 ), US_150 );
+    Sim_drop_bit = -1;
+
+    if (FALSE != Dshot_get_value( &value ))
+    {
+        printf(" missed edge: decoded %u\n", value);
+        return TEST_FAIL;
+    }
+
+    send_frame( frame_encode( 1300, 0 ), US_150 );
+
+    if (FALSE == Dshot_get_value( &value ) || 1300 != value || 0 == Dshot_get_errors())
+    {
+        printf(" missed edge: no resync, value %u\n", value);
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * a command is accepted after DSHOT_CMD_REPEAT consecutive frames, once
+ */
+int test_case_command_iteration(void)
+{
+    uint16_t value;
+    int n;
+
+    for (n = 0; n < DSHOT_CMD_REPEAT - 1; n++)
+    {
+        send_frame( frame_encode( DSHOT_CMD_SAVE_SETTINGS, 1 ), US_300 );
+    }
+    if (0 != Dshot_get_command())
+    {
+        printf(" command: accepted early\n");
+        return TEST_FAIL;
+    }
+
+    send_frame( frame_encode( DSHOT_CMD_SAVE_SETTINGS, 1 ), US_300 );
+
+    if (DSHOT_CMD_SAVE_SETTINGS != Dshot_get_command() || 0 != Dshot_get_command())
+    {
+        printf(" command: not accepted once\n");
+        return TEST_FAIL;
+    }
+
+    Dshot_get_value( &value );
+
+    if (DSHOT_CMD_SAVE_SETTINGS != value)
+    {
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    sim_start(0.3); // +/- 0.3 us edge jitter
+    putf_n_iterations(3000, &test_case_dshot150_iteration, "test_case_dshot150_iteration");
+
+    sim_start(0.1); // +/- 0.1 us edge jitter
+    putf_n_iterations(3000, &test_case_dshot300_iteration, "test_case_dshot300_iteration");
+
+    sim_start(0.0);
+    putf_n_iterations(1, &test_case_crc_iteration, "test_case_crc_iteration");
+
+    sim_start(0.0);
+    putf_n_iterations(1, &test_case_missed_edge_iteration, "test_case_missed_edge_iteration");
+
+    sim_start(0.0);
+    putf_n_iterations(1, &test_case_command_iteration, "test_case_command_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
@@ -0,0 +1,214 @@
+/**
+  ******************************************************************************
+  * @file    test_faultm.c
+  * @brief   test driver for faultm.c (trip thresholds and fault history)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "faultm.h"
+
+
+/*
+ * stubs for the fault manager freeze-frame data
+ */
+static uint8_t Stub_opstate;
+static uint16_t Stub_timing;
+static uint16_t Stub_speed;
+static uint16_t Stub_vbatt;
+
+uint8_t BL_get_opstate(void) { return Stub_opstate; }
+uint16_t BL_get_timing(void) { return Stub_timing; }
+uint16_t BL_get_speed(void) { return Stub_speed; }
+uint16_t Seq_Get_Vbatt(void) { return Stub_vbatt; }
+
+static void stub_set(uint8_t opstate, uint16_t timing, uint16_t speed, uint16_t vbatt)
+{
+    Stub_opstate = opstate;
+    Stub_timing = timing;
+    Stub_speed = speed;
+    Stub_vbatt = vbatt;
+}
+
+/*
+ * count of updates with the condition asserted until the fault trips
+ */
+static int updates_to_trip(faultm_ID_t id, int limit)
+{
+    int n;
+
+    for (n = 1; n <= limit; n++)
+    {
+        Faultm_upd(id, 1);
+
+        if (0 != (Faultm_get_status() & FAULTM_STATUS_BIT( id )))
+        {
+            return n;
+        }
+    }
+    return -1;
+}
+
+/*
+ * per-fault thresholds: voltage fault at unit rate, overcurrent at 4x
+ */
+int test_case_thresh_iteration(void)
+{
+    int n;
+
+    Faultm_init();
+    n = updates_to_trip(VOLTAGE_NG, 100);
+    if (48 != n)
+    {
+        printf(" thresh: VOLTAGE_NG tripped after %d\n", n);
+        return TEST_FAIL;
+    }
+
+    Faultm_init();
+    n = updates_to_trip(OVERCURRENT, 100);
+    if (12 != n)
+    {
+        printf(" thresh: OVERCURRENT tripped after %d\n", n);
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * intermittent condition leaks out of the bucket, and a disabled fault does
+ * not trip
+ */
+int test_case_leak_iteration(void)
+{
+    int n;
+
+    Faultm_init();
+
+    for (n = 0; n < 1000; n++)
+    {
+        Faultm_upd(VOLTAGE_NG, (faultm_assert_t)(n & 1));
+    }
+    if (0 != Faultm_get_status())
+    {
+        printf(" leak: intermittent fault tripped\n");
+        return TEST_FAIL;
+    }
+
+    Faultm_enable(THROTTLE_HI, 0);
+    if (-1 != updates_to_trip(THROTTLE_HI, 100))
+    {
+        printf(" leak: disabled fault tripped\n");
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * faults are accumulated in the status word and each trip writes one
+ * freeze-frame, the ring keeps the most recent FAULTM_HIST_LEN
+ */
+int test_case_history_iteration(void)
+{
+    const faultm_frame_t * pframe;
+    uint8_t nr_hist = Faultm_get_nr_history();
+    int n;
+
+    Faultm_init();
+
+    stub_set(2, 0x0400, 0x0100, 0x0280); // voltage sag
+    updates_to_trip(VOLTAGE_NG, 100);
+    updates_to_trip(VOLTAGE_NG, 100); // latched, no new record
+
+    stub_set(3, 0x0180, 0x0300, 0x0350); // high current
+    updates_to_trip(OVERCURRENT, 100);
+
+    if ( ( FAULTM_STATUS_BIT( VOLTAGE_NG ) | FAULTM_STATUS_BIT( OVERCURRENT ) )
+         != Faultm_get_status() )
+    {
+        printf(" history: status %X\n", Faultm_get_status());
+        return TEST_FAIL;
+    }
+
+    if (Faultm_get_nr_history() != nr_hist + 2)
+    {
+        printf(" history: %u records\n", Faultm_get_nr_history());
+        return TEST_FAIL;
+    }
+
+    pframe = Faultm_get_history(0);
+    if (OVERCURRENT != pframe->fault_ID || 3 != pframe->opstate ||
+        0x0180 != pframe->comm_period || 0x0300 != pframe->duty || 0x0350 != pframe->vbatt)
+    {
+        printf(" history: frame 0 id=%u CT=%04X\n", pframe->fault_ID, pframe->comm_period);
+        return TEST_FAIL;
+    }
+
+    pframe = Faultm_get_history(1);
+    if (VOLTAGE_NG != pframe->fault_ID || 0x0280 != pframe->vbatt)
+    {
+        printf(" history: frame 1 id=%u Vs=%04X\n", pframe->fault_ID, pframe->vbatt);
+        return TEST_FAIL;
+    }
+
+    // wrap the ring, history is retained across Faultm_init()
+    for (n = 0; n < FAULTM_HIST_LEN; n++)
+    {
+        Faultm_init();
+        stub_set(1, (uint16_t)n, 0, 0);
+        updates_to_trip(FAULT_1, 100);
+    }
+
+    if (FAULTM_HIST_LEN != Faultm_get_nr_history() ||
+        NULL != Faultm_get_history(FAULTM_HIST_LEN))
+    {
+        printf(" history: %u records after wrap\n", Faultm_get_nr_history());
+        return TEST_FAIL;
+    }
+
+    for (n = 0; n < FAULTM_HIST_LEN; n++)
+    {
+        pframe = Faultm_get_history((uint8_t)n);
+
+        if (FAULT_1 != pframe->fault_ID ||
+            (FAULTM_HIST_LEN - 1 - n) != pframe->comm_period)
+        {
+            printf(" history: wrap frame %d id=%u CT=%04X\n",
+                   n, pframe->fault_ID, pframe->comm_period);
+            return TEST_FAIL;
+        }
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    putf_n_iterations(1, &test_case_thresh_iteration, "test_case_thresh_iteration");
+    putf_n_iterations(1, &test_case_leak_iteration, "test_case_leak_iteration");
+    putf_n_iterations(1, &test_case_history_iteration, "test_case_history_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
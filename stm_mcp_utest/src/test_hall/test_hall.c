@@ -0,0 +1,284 @@
+/**
+  ******************************************************************************
+  * @file    test_hall.c
+  * @brief   test driver for hall.c (simulated sensor edges)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "hall.h"
+
+
+/*
+ * Hall states in the forward direction (sensors at 120 degrees)
+ */
+static const uint8_t Fwd_states[ 6 ] = { 1, 3, 2, 6, 4, 5 };
+
+/*
+ * Simulated rotor: sector period in timestamp counts, the sensors are
+ * misplaced so that the intervals alternate +/- Sim_skew
+ */
+static uint16_t Sim_tm;
+static uint16_t Sim_perd;
+static uint16_t Sim_skew;
+static int Sim_pos;
+static int Sim_edges;
+
+static void sim_start(uint16_t perd, uint16_t skew)
+{
+    Sim_tm = 0xF000; // timestamp wraps during the test
+    Sim_perd = perd;
+    Sim_skew = skew;
+    Sim_pos = 0;
+    Sim_edges = 0;
+
+    Hall_reset();
+    Hall_on_frame( Fwd_states[ Sim_pos ] ); // position from the poll, taken at
+    Hall_on_frame( Fwd_states[ Sim_pos ] ); // the second if a sector is known
+}
+
+/*
+ * advance to the next sector, returns the commutated sector
+ */
+static uint8_t sim_edge(void)
+{
+    Sim_tm += (Sim_edges & 1) ? Sim_perd + Sim_skew : Sim_perd - Sim_skew;
+    Sim_pos = (Sim_pos + 1) % 6;
+    Sim_edges += 1;
+
+    return Hall_on_edge( Fwd_states[ Sim_pos ], Sim_tm );
+}
+
+/*
+ * each edge commutates the next sector at once, the period is measured from
+ * the first interval and the sensor skew cancels over the revolution
+ */
+int test_case_rotate_iteration(void)
+{
+    uint8_t prev = Hall_get_sector();
+    uint8_t sector = sim_edge();
+    uint16_t perd = Hall_get_period();
+
+    if (sector != (prev + 1) % 6 || sector != Hall_get_sector())
+    {
+        printf(" rotate: sector %u after %u\n", sector, prev);
+        return TEST_FAIL;
+    }
+    if (1 == Sim_edges && HALL_PERIOD_MAX != perd)
+    {
+        printf(" rotate: period %u at the first edge\n", perd);
+        return TEST_FAIL;
+    }
+    if (Sim_edges > 7 && Sim_perd != perd)
+    {
+        printf(" rotate: period %u expected %u\n", perd, Sim_perd);
+        return TEST_FAIL;
+    }
+    if (Sim_edges > 1 && Sim_edges <= 7 &&
+        ( perd < Sim_perd - Sim_skew || perd > Sim_perd + Sim_skew ))
+    {
+        printf(" rotate: period %u at edge %d\n", perd, Sim_edges);
+        return TEST_FAIL;
+    }
+    if (0 != Hall_get_status())
+    {
+        printf(" rotate: status\n");
+        return TEST_FAIL;
+    }
+    return TEST_OK;
+}
+
+/*
+ * sensor bounce back to the present state is not an interval, invalid states
+ * are not commutated and 000/111 for HALL_INVALID_MAX edges is a fault
+ */
+int test_case_invalid_iteration(void)
+{
+    uint8_t sector;
+    int n;
+
+    sim_edge();
+    sim_edge();
+    sector = Hall_get_sector();
+
+    if (sector != Hall_on_edge( Fwd_states[ Sim_pos ], Sim_tm + 3 ) ||
+        Sim_perd != Hall_get_period())
+    {
+        printf(" invalid: bounce period %u\n", Hall_get_period());
+        return TEST_FAIL;
+    }
+
+    for (n = 0; n < HALL_INVALID_MAX; n++)
+    {
+        if (HALL_SECTOR_INVALID != Hall_on_edge( (n & 1) ? 7 : 0, Sim_tm ) ||
+            sector != Hall_get_sector())
+        {
+            printf(" invalid: state commutated\n");
+            return TEST_FAIL;
+        }
+        if ((n < HALL_INVALID_MAX - 1) == (0 != Hall_get_status()))
+        {
+            printf(" invalid: status %u after %d\n", Hall_get_status(), n + 1);
+            return TEST_FAIL;
+        }
+    }
+
+    sim_edge();
+
+    if (0 != Hall_get_status())
+    {
+        printf(" invalid: fault not cleared by a valid state\n");
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * rotor slows down (no edge): the period follows the time since the last
+ * edge, the rotor is stalled after HALL_STALL_FRAMES, and the next interval
+ * (timestamp may have wrapped) is not measured
+ */
+int test_case_stall_iteration(void)
+{
+    static int frames = 0;
+    uint16_t perd;
+
+    Hall_on_frame( Fwd_states[ Sim_pos ] );
+    frames += 1;
+    perd = Hall_get_period();
+
+    if (perd < Sim_perd ||
+        ( (uint32_t)frames * HALL_CT_PER_FRAME > Sim_perd &&
+          perd != ( ( (uint32_t)frames * HALL_CT_PER_FRAME > HALL_PERIOD_MAX ) ?
+                    HALL_PERIOD_MAX : frames * HALL_CT_PER_FRAME ) ))
+    {
+        printf(" stall: period %u after %d frames\n", perd, frames);
+        return TEST_FAIL;
+    }
+
+    if (frames < HALL_STALL_FRAMES)
+    {
+        return (0 == Hall_get_status()) ? TEST_OK : TEST_FAIL;
+    }
+
+    if (0 == Hall_get_status())
+    {
+        printf(" stall: not detected\n");
+        return TEST_FAIL;
+    }
+
+    sim_edge();
+
+    if (HALL_PERIOD_MAX != Hall_get_period() || 0 != Hall_get_status())
+    {
+        printf(" stall: period %u after restart\n", Hall_get_period());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * the poll does not commutate an edge still pending in its interrupt, an edge
+ * missed by the interrupt is commutated at the second poll, the speed
+ * measurement is kept and the interval spanning the missed edge is skipped
+ */
+int test_case_missed_iteration(void)
+{
+    uint8_t prev;
+    uint8_t sector;
+    int n;
+
+    for (n = 0; n < 7; n++)
+    {
+        sim_edge(); // measured revolution
+    }
+    prev = Hall_get_sector();
+
+    Sim_pos = (Sim_pos + 1) % 6; // edge pending at the poll
+    Sim_tm += Sim_perd;
+
+    if (HALL_SECTOR_INVALID != Hall_on_frame( Fwd_states[ Sim_pos ] ) ||
+        (prev + 1) % 6 != Hall_on_edge( Fwd_states[ Sim_pos ], Sim_tm ) ||
+        HALL_SECTOR_INVALID != Hall_on_frame( Fwd_states[ Sim_pos ] ))
+    {
+        printf(" missed: pending edge commutated by the poll\n");
+        return TEST_FAIL;
+    }
+    if (HALL_PERIOD_MAX == Hall_get_period())
+    {
+        printf(" missed: period restarted by a pending edge\n");
+        return TEST_FAIL;
+    }
+
+    prev = Hall_get_sector();
+    Sim_pos = (Sim_pos + 1) % 6; // no edge interrupt
+
+    if (HALL_SECTOR_INVALID != Hall_on_frame( Fwd_states[ Sim_pos ] ))
+    {
+        printf(" missed: commutated at the first poll\n");
+        return TEST_FAIL;
+    }
+    sector = Hall_on_frame( Fwd_states[ Sim_pos ] );
+
+    if (sector != (prev + 1) % 6 || sector != Hall_get_sector() ||
+        HALL_PERIOD_MAX == Hall_get_period())
+    {
+        printf(" missed: sector %u after %u period %u\n", sector, prev, Hall_get_period());
+        return TEST_FAIL;
+    }
+    if (HALL_SECTOR_INVALID != Hall_on_frame( Fwd_states[ Sim_pos ] ))
+    {
+        printf(" missed: commutated twice\n");
+        return TEST_FAIL;
+    }
+
+    sim_edge(); // spans the missed edge, not measured
+
+    if (Sim_perd != Hall_get_period())
+    {
+        printf(" missed: period %u after the next edge\n", Hall_get_period());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    sim_start(500, 0);
+    putf_n_iterations(1000, &test_case_rotate_iteration, "test_case_rotate_iteration");
+
+    sim_start(20000, 1500);
+    putf_n_iterations(1000, &test_case_rotate_iteration, "test_case_rotate_iteration (skew)");
+
+    sim_start(800, 0);
+    putf_n_iterations(12, &test_case_rotate_iteration, "test_case_rotate_iteration (start)");
+    putf_n_iterations(1, &test_case_invalid_iteration, "test_case_invalid_iteration");
+    putf_n_iterations(HALL_STALL_FRAMES, &test_case_stall_iteration, "test_case_stall_iteration");
+    putf_n_iterations(1, &test_case_missed_iteration, "test_case_missed_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
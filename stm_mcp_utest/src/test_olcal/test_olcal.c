@@ -0,0 +1,327 @@
+/**
+  ******************************************************************************
+  * @file    test_olcal.c
+  * @brief   test driver for olcal.c (calibration against a motor plant model)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+#include "eeprom_emu.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "olcal.h"
+#include "mdata.h"
+#include "pstore.h"
+
+
+#define EEPROM_FILE  "obj/eeprom_test.bin"
+
+/*
+ * Plant model: the motor runs in sync with the open-loop commutation period,
+ * the natural (balanced) period is inversely proportional to the applied
+ * voltage less a friction offset:
+ *
+ *   T = K / ( dc * Vbatt / Vcal - D0 )
+ *
+ * which is deliberately not the curve of the built-in table. The timing error
+ * is proportional to the relative error of the period (+/- 64 full-scale),
+ * updated once per electrical revolution, with noise.
+ */
+#define PLANT_K         260000.0
+#define PLANT_D0        16.0
+#define PLANT_ERR_GAIN  128.0
+#define PLANT_ERR_MAX   64
+#define PLANT_NOISE     3
+#define PLANT_ERR_UPD   4  // control frames per timing error update
+
+#define V_HI  ( MDATA_VCAL_COUNTS * 6 / 5 ) // 20% above calibration voltage
+
+static uint16_t Sim_vbatt;
+static uint16_t Sim_dutycycle;
+static uint16_t Sim_comm_period;
+static int16_t Sim_timing_err;
+static uint32_t Sim_frames;
+static uint32_t Sim_rand = 1;
+static int Sim_err_fixed; // non-zero to force a timing error that never balances
+
+static double plant_period(uint16_t dutycycle, uint16_t vbatt)
+{
+    double v = (0 != vbatt) ? (double)dutycycle * vbatt / MDATA_VCAL_COUNTS : dutycycle;
+
+    return PLANT_K / ( v - PLANT_D0 );
+}
+
+static int16_t plant_noise(void)
+{
+    Sim_rand = Sim_rand * 1103515245 + 12345;
+
+    return (int16_t)( (Sim_rand >> 16) % (2 * PLANT_NOISE + 1) ) - PLANT_NOISE;
+}
+
+static void plant_update(void)
+{
+    double tn = plant_period( Sim_dutycycle, Sim_vbatt );
+    double err = PLANT_ERR_GAIN * ( tn - Sim_comm_period ) / tn;
+
+    if (0 != Sim_err_fixed)
+    {
+        err = Sim_err_fixed;
+    }
+
+    err += plant_noise();
+
+    if (err > PLANT_ERR_MAX)
+    {
+        err = PLANT_ERR_MAX;
+    }
+    else if (err < -PLANT_ERR_MAX)
+    {
+        err = -PLANT_ERR_MAX;
+    }
+    Sim_timing_err = (int16_t)err;
+}
+
+/*
+ * motor running open-loop at the ramp-to speed
+ */
+static void sim_start(uint16_t vbatt)
+{
+    Eeprom_emu_close();
+    remove(EEPROM_FILE);
+    Eeprom_emu_open(EEPROM_FILE);
+    Pstore_init();
+
+    Sim_vbatt = vbatt;
+    Sim_dutycycle = MDATA_OL_BP_DC( 0 ) + 16;
+    Sim_comm_period = Get_OL_Timing_Vcomp( Sim_dutycycle, vbatt );
+    Sim_frames = 0;
+    Sim_err_fixed = 0;
+    plant_update();
+
+    Olcal_start();
+}
+
+/*
+ * one control frame of the open-loop state
+ */
+static uint8_t sim_frame(void)
+{
+    uint16_t dc = Sim_dutycycle;
+    uint16_t ct = Sim_comm_period;
+    uint8_t active = Olcal_update( &dc, &ct, Sim_timing_err, Sim_vbatt );
+
+    if (FALSE != active)
+    {
+        Sim_dutycycle = dc;
+        Sim_comm_period = ct;
+    }
+
+    if (0 == (Sim_frames % PLANT_ERR_UPD))
+    {
+        plant_update();
+    }
+    Sim_frames += 1;
+
+    return active;
+}
+
+static double rel_err(double t, double t_ref)
+{
+    double e = ( t - t_ref ) / t_ref;
+
+    return (e < 0) ? -e : e;
+}
+
+/*
+ * check the breakpoints against the plant at the calibration voltage, returns
+ * the greatest relative error
+ */
+static double check_breakpoints(const uint16_t * pbp)
+{
+    double emax = 0;
+    uint8_t n;
+
+    for (n = 0; n < MDATA_OL_NR_BP; n++)
+    {
+        double e = rel_err( pbp[ n ], plant_period( MDATA_OL_BP_DC( n ), 0 ) );
+
+        emax = (e > emax) ? e : emax;
+    }
+    return emax;
+}
+
+/*
+ * check the timing lookup against the plant over the calibrated range, at
+ * the breakpoints and midway between them
+ */
+static double check_lookup(void)
+{
+    double emax = 0;
+    uint16_t dc;
+
+    for (dc = MDATA_OL_BP_DC( 0 );
+         dc <= MDATA_OL_BP_DC( MDATA_OL_NR_BP - 1 ); dc += MDATA_OL_BP_DC_STEP / 2)
+    {
+        double e = rel_err( Get_OL_Timing( dc ), plant_period( dc, 0 ) );
+
+        emax = (e > emax) ? e : emax;
+    }
+    return emax;
+}
+
+/*
+ * calibration sweep at the calibration voltage, the result is saved and used
+ * by the timing lookup after a reset
+ */
+int test_case_sweep_iteration(void)
+{
+    double e_table, e_bp, e_cal;
+
+    sim_frame();
+
+    if (OLCAL_FAILED == Olcal_get_status())
+    {
+        printf(" sweep: failed at step duty %u\n", Sim_dutycycle);
+        return TEST_FAIL;
+    }
+    if (OLCAL_DONE != Olcal_get_status())
+    {
+        return TEST_OK;
+    }
+
+    e_table = check_lookup();
+    e_bp = check_breakpoints( Olcal_get_breakpoints() );
+
+    Olcal_apply();
+
+    if (PSTORE_OK != Pstore_save())
+    {
+        printf(" sweep: save failed\n");
+        return TEST_FAIL;
+    }
+
+    Pstore_set_defaults();
+    Eeprom_emu_open(EEPROM_FILE); // reset
+    Pstore_init();
+
+    e_cal = check_lookup();
+
+    printf(" sweep: %.1f s, breakpoints %.1f%%, lookup %.1f%% (table %.1f%%)\n",
+           Sim_frames / 1000.0, e_bp * 100, e_cal * 100, e_table * 100);
+
+    if (e_bp > 0.03 || e_cal > 0.06 || Sim_frames > 60000)
+    {
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * sweep with the supply 20% above the calibration voltage, the breakpoints
+ * are normalized to the calibration voltage
+ */
+int test_case_sweep_vbatt_iteration(void)
+{
+    double e_bp;
+
+    sim_frame();
+
+    if (OLCAL_FAILED == Olcal_get_status())
+    {
+        printf(" sweep vbatt: failed\n");
+        return TEST_FAIL;
+    }
+    if (OLCAL_DONE != Olcal_get_status())
+    {
+        return TEST_OK;
+    }
+
+    e_bp = check_breakpoints( Olcal_get_breakpoints() );
+    printf(" sweep vbatt: %.1f s, breakpoints %.1f%%\n", Sim_frames / 1000.0, e_bp * 100);
+
+    Olcal_apply();
+
+    return (e_bp > 0.03) ? TEST_FAIL : TEST_DONE;
+}
+
+/*
+ * motor stopped during the sweep, open-loop control resumes
+ */
+int test_case_abort_iteration(void)
+{
+    uint8_t active = sim_frame();
+
+    if (1000 == Sim_frames)
+    {
+        Olcal_abort();
+
+        if (OLCAL_FAILED != Olcal_get_status() || FALSE != sim_frame())
+        {
+            printf(" abort: still active\n");
+            return TEST_FAIL;
+        }
+        return TEST_DONE;
+    }
+    return (FALSE != active) ? TEST_OK : TEST_FAIL;
+}
+
+/*
+ * timing error never balances (e.g. no back-EMF), the step times out
+ */
+int test_case_timeout_iteration(void)
+{
+    Sim_err_fixed = PLANT_ERR_MAX;
+
+    if (FALSE == sim_frame())
+    {
+        if (OLCAL_FAILED != Olcal_get_status())
+        {
+            return TEST_FAIL;
+        }
+        printf(" timeout: after %u frames\n", (unsigned int)Sim_frames);
+        return TEST_DONE;
+    }
+    return TEST_OK;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    sim_start(0);
+    putf_n_iterations(60000, &test_case_sweep_iteration, "test_case_sweep_iteration");
+
+    sim_start(V_HI);
+    putf_n_iterations(60000, &test_case_sweep_vbatt_iteration, "test_case_sweep_vbatt_iteration");
+
+    sim_start(0);
+    putf_n_iterations(60000, &test_case_abort_iteration, "test_case_abort_iteration");
+
+    sim_start(0);
+    putf_n_iterations(60000, &test_case_timeout_iteration, "test_case_timeout_iteration");
+
+    Eeprom_emu_close();
+    remove(EEPROM_FILE);
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
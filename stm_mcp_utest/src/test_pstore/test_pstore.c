@@ -0,0 +1,261 @@
+/**
+  ******************************************************************************
+  * @file    test_pstore.c
+  * @brief   test driver for pstore.c (on the file-backed EEPROM emulator)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+#include "eeprom_emu.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "pstore.h"
+
+
+#define EEPROM_FILE  "obj/eeprom_test.bin"
+
+/*
+ * simulated reset: reopen the backing file (the EEPROM content survives) and
+ * load the parameters as at MCU_Init
+ */
+static void sim_reset(void)
+{
+    Eeprom_emu_open(EEPROM_FILE);
+    Pstore_init();
+}
+
+/*
+ * blank EEPROM
+ */
+static void sim_erase(void)
+{
+    Eeprom_emu_close();
+    remove(EEPROM_FILE);
+    sim_reset();
+}
+
+/*
+ * save a parameter set distinguished by 'tag'
+ */
+static int save_tagged(uint16_t tag)
+{
+    pstore_params_t params = *Pstore_get();
+
+    params.time_align = tag;
+    Pstore_set(&params);
+
+    return Pstore_save();
+}
+
+/*
+ * blank EEPROM loads the defaults
+ */
+int test_case_blank_iteration(void)
+{
+    pstore_params_t defaults;
+
+    sim_erase();
+
+    if (0 != Pstore_is_loaded())
+    {
+        printf(" blank: loaded\n");
+        return TEST_FAIL;
+    }
+
+    defaults = *Pstore_get();
+    Pstore_set_defaults();
+
+    if (0 != memcmp(&defaults, Pstore_get(), sizeof(defaults)) ||
+        0 != defaults.ol_bp[ 0 ])
+    {
+        printf(" blank: not the defaults\n");
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * save, reset, and the saved parameters are loaded
+ */
+int test_case_round_trip_iteration(void)
+{
+    sim_erase();
+
+    if (PSTORE_OK != save_tagged(0x1234))
+    {
+        printf(" round trip: save failed\n");
+        return TEST_FAIL;
+    }
+
+    Pstore_set_defaults(); // not saved
+    sim_reset();
+
+    if (0 == Pstore_is_loaded() || 0x1234 != Pstore_get()->time_align)
+    {
+        printf(" round trip: time_align %X\n", Pstore_get()->time_align);
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * repeated saves (with resets between) are spread evenly over the slots
+ */
+int test_case_wear_iteration(void)
+{
+    static int n_saves;
+    uint16_t offs;
+
+    if (PSTORE_OK != save_tagged( (uint16_t)n_saves ))
+    {
+        return TEST_FAIL;
+    }
+    n_saves += 1;
+
+    if (0 == (n_saves % 3))
+    {
+        sim_reset();
+    }
+
+    if (n_saves < PSTORE_NR_SLOTS * 10)
+    {
+        return TEST_OK;
+    }
+
+    for (offs = 0; offs < PSTORE_NR_SLOTS * PSTORE_REC_SIZE; offs += 4)
+    {
+        if (10 != Eeprom_emu_get_wear( PSTORE_EEPROM_OFFS + offs ))
+        {
+            printf(" wear: offset %u written %u times\n",
+                   offs, Eeprom_emu_get_wear( PSTORE_EEPROM_OFFS + offs ));
+            return TEST_FAIL;
+        }
+    }
+    if (Eeprom_emu_get_wear( PSTORE_EEPROM_OFFS + PSTORE_NR_SLOTS * PSTORE_REC_SIZE ) != 0)
+    {
+        printf(" wear: write past the last slot\n");
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * corrupt (e.g. power loss during the write) newest record, the previous one
+ * is loaded, and the next save doesn't overwrite the previous record
+ */
+int test_case_corrupt_iteration(void)
+{
+    uint16_t offs;
+
+    sim_erase();
+
+    save_tagged(0x0A0A);
+    save_tagged(0x0B0B); // slot 1
+
+    offs = PSTORE_EEPROM_OFFS + 1 * PSTORE_REC_SIZE + 4;
+    Eeprom_emu_poke(offs, 0x5A);
+
+    sim_reset();
+
+    if (0 == Pstore_is_loaded() || 0x0A0A != Pstore_get()->time_align)
+    {
+        printf(" corrupt: time_align %X\n", Pstore_get()->time_align);
+        return TEST_FAIL;
+    }
+
+    save_tagged(0x0C0C); // slot 1 again
+    Eeprom_emu_poke(offs, 0x5A);
+    sim_reset();
+
+    if (0x0A0A != Pstore_get()->time_align)
+    {
+        printf(" corrupt: previous record overwritten\n");
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * record of a different version is not loaded
+ */
+int test_case_version_iteration(void)
+{
+    sim_erase();
+
+    save_tagged(0x0D0D);
+    Eeprom_emu_poke(PSTORE_EEPROM_OFFS, PSTORE_VERSION + 1); // version byte
+    sim_reset();
+
+    if (0 != Pstore_is_loaded())
+    {
+        printf(" version: loaded\n");
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * the newest record is found across the wrap of the 8-bit sequence number
+ */
+int test_case_seq_wrap_iteration(void)
+{
+    static uint16_t n_saves;
+
+    if (0 == n_saves)
+    {
+        sim_erase();
+    }
+
+    n_saves += 1;
+    save_tagged(n_saves);
+
+    sim_reset();
+
+    if (n_saves != Pstore_get()->time_align)
+    {
+        printf(" seq wrap: save %u loaded %u\n", n_saves, Pstore_get()->time_align);
+        return TEST_FAIL;
+    }
+    return (n_saves < 300) ? TEST_OK : TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    putf_n_iterations(1, &test_case_blank_iteration, "test_case_blank_iteration");
+    putf_n_iterations(1, &test_case_round_trip_iteration, "test_case_round_trip_iteration");
+
+    sim_erase();
+    putf_n_iterations(1000, &test_case_wear_iteration, "test_case_wear_iteration");
+
+    putf_n_iterations(1, &test_case_corrupt_iteration, "test_case_corrupt_iteration");
+    putf_n_iterations(1, &test_case_version_iteration, "test_case_version_iteration");
+    putf_n_iterations(1000, &test_case_seq_wrap_iteration, "test_case_seq_wrap_iteration");
+
+    Eeprom_emu_close();
+    remove(EEPROM_FILE);
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
@@ -0,0 +1,466 @@
+/**
+  ******************************************************************************
+  * @file    test_pwm.c
+  * @brief   test driver for the PWM phase control macros (pwm_stm8s.h)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  *
+  * The commutation register image load is checked against the step handlers it
+  * replaced (SPL TIMx_CCxCmd/TIMx_SetCompareN calls), on host copies of the
+  * timer and GPIO registers, as are the per-phase primitives against the SPL
+  * calls. The board (timer mapping) is selected by the makefile:
+  * make BOARD=S105_DISCOVERY ...
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "pwm_stm8s.h"
+
+
+#define NR_SECTORS  6
+
+/*
+ * host register blocks (stm8s.h)
+ */
+TIM1_TypeDef Host_TIM1;
+TIM2_TypeDef Host_TIM2;
+GPIO_TypeDef Host_GPIOA, Host_GPIOC, Host_GPIOD, Host_GPIOE;
+
+/*
+ * sector images, same definition as the table in sequence.c
+ */
+#define PH_FLT  0
+#define PH_LO   1
+#define PH_PWM  2
+
+#define SEQ_CCER( _A_, _B_, _C_, _EN_A_, _EN_B_, _EN_C_ )  \
+  (uint8_t)( ( PH_PWM == (_A_) ? (_EN_A_) : 0 ) |         \
+             ( PH_PWM == (_B_) ? (_EN_B_) : 0 ) |         \
+             ( PH_PWM == (_C_) ? (_EN_C_) : 0 ) )
+
+#define SEQ_SD( _X_, _PIN_ )  (uint8_t)( PH_FLT != (_X_) ? (_PIN_) : 0 )
+
+#define SEQ_SECTOR_IMAGE( _A_, _B_, _C_ )                                          \
+  {                                                                                \
+    SEQ_CCER( _A_, _B_, _C_, PWM_PhA_CCER1_EN, PWM_PhB_CCER1_EN, PWM_PhC_CCER1_EN ), \
+    SEQ_CCER( _A_, _B_, _C_, PWM_PhA_CCER2_EN, PWM_PhB_CCER2_EN, PWM_PhC_CCER2_EN ), \
+    SEQ_SD( _A_, SDa_SD_PIN ),                                                     \
+    SEQ_SD( _B_, SDb_SD_PIN ),                                                     \
+    SEQ_SD( _C_, SDc_SD_PIN )                                                      \
+  }
+
+static const PWM_sector_image_t Image_table[ NR_SECTORS ] =
+{
+  SEQ_SECTOR_IMAGE( PH_PWM, PH_LO,  PH_FLT ),
+  SEQ_SECTOR_IMAGE( PH_PWM, PH_FLT, PH_LO  ),
+  SEQ_SECTOR_IMAGE( PH_FLT, PH_PWM, PH_LO  ),
+  SEQ_SECTOR_IMAGE( PH_LO,  PH_PWM, PH_FLT ),
+  SEQ_SECTOR_IMAGE( PH_LO,  PH_FLT, PH_PWM ),
+  SEQ_SECTOR_IMAGE( PH_FLT, PH_LO,  PH_PWM )
+};
+
+/*
+ * the replaced path: SPL timer functions (STM8S_StdPeriph_Lib stm8s_tim1.c, as
+ * called by the step handlers) and the step handlers of the baseline sequencer
+ */
+static uint16_t global_uDC = PWM_PERIOD_COUNTS / 4;
+
+#if defined( S105_DEV )
+typedef enum
+{
+  TIM1_CHANNEL_1 = 0, TIM1_CHANNEL_2, TIM1_CHANNEL_3, TIM1_CHANNEL_4
+}
+TIM1_Channel_TypeDef;
+
+__attribute__((noinline))
+static void TIM1_CCxCmd(TIM1_Channel_TypeDef TIM1_Channel, FunctionalState NewState)
+{
+  if (TIM1_Channel == TIM1_CHANNEL_1)
+  {
+    if (NewState != DISABLE)
+      TIM1->CCER1 |= TIM1_CCER1_CC1E;
+    else
+      TIM1->CCER1 &= (uint8_t)(~TIM1_CCER1_CC1E);
+  }
+  else if (TIM1_Channel == TIM1_CHANNEL_2)
+  {
+    if (NewState != DISABLE)
+      TIM1->CCER1 |= TIM1_CCER1_CC2E;
+    else
+      TIM1->CCER1 &= (uint8_t)(~TIM1_CCER1_CC2E);
+  }
+  else if (TIM1_Channel == TIM1_CHANNEL_3)
+  {
+    if (NewState != DISABLE)
+      TIM1->CCER2 |= TIM1_CCER2_CC3E;
+    else
+      TIM1->CCER2 &= (uint8_t)(~TIM1_CCER2_CC3E);
+  }
+  else
+  {
+    if (NewState != DISABLE)
+      TIM1->CCER2 |= TIM1_CCER2_CC4E;
+    else
+      TIM1->CCER2 &= (uint8_t)(~TIM1_CCER2_CC4E);
+  }
+}
+
+__attribute__((noinline)) static void TIM1_SetCompare2(uint16_t Compare2)
+{
+  TIM1->CCR2H = (uint8_t)(Compare2 >> 8);
+  TIM1->CCR2L = (uint8_t)(Compare2);
+}
+
+__attribute__((noinline)) static void TIM1_SetCompare3(uint16_t Compare3)
+{
+  TIM1->CCR3H = (uint8_t)(Compare3 >> 8);
+  TIM1->CCR3L = (uint8_t)(Compare3);
+}
+
+__attribute__((noinline)) static void TIM1_SetCompare4(uint16_t Compare4)
+{
+  TIM1->CCR4H = (uint8_t)(Compare4 >> 8);
+  TIM1->CCR4L = (uint8_t)(Compare4);
+}
+
+#define OLD_CCxCmd         TIM1_CCxCmd
+#define OLD_PhA_CH         TIM1_CHANNEL_2
+#define OLD_PhB_CH         TIM1_CHANNEL_3
+#define OLD_PhC_CH         TIM1_CHANNEL_4
+#define OLD_PhA_SetCompare TIM1_SetCompare2
+#define OLD_PhB_SetCompare TIM1_SetCompare3
+#define OLD_PhC_SetCompare TIM1_SetCompare4
+
+#else // S105_DISCOVERY || S003_DEV
+__attribute__((noinline))
+static void TIM2_CCxCmd(TIM2_Channel_TypeDef TIM2_Channel, FunctionalState NewState)
+{
+  if (TIM2_Channel == TIM2_CHANNEL_1)
+  {
+    if (NewState != DISABLE)
+      TIM2->CCER1 |= TIM2_CCER1_CC1E;
+    else
+      TIM2->CCER1 &= (uint8_t)(~TIM2_CCER1_CC1E);
+  }
+  else if (TIM2_Channel == TIM2_CHANNEL_2)
+  {
+    if (NewState != DISABLE)
+      TIM2->CCER1 |= TIM2_CCER1_CC2E;
+    else
+      TIM2->CCER1 &= (uint8_t)(~TIM2_CCER1_CC2E);
+  }
+  else
+  {
+    if (NewState != DISABLE)
+      TIM2->CCER2 |= TIM2_CCER2_CC3E;
+    else
+      TIM2->CCER2 &= (uint8_t)(~TIM2_CCER2_CC3E);
+  }
+}
+
+__attribute__((noinline)) static void TIM2_SetCompare1(uint16_t Compare1)
+{
+  TIM2->CCR1H = (uint8_t)(Compare1 >> 8);
+  TIM2->CCR1L = (uint8_t)(Compare1);
+}
+
+__attribute__((noinline)) static void TIM2_SetCompare2(uint16_t Compare2)
+{
+  TIM2->CCR2H = (uint8_t)(Compare2 >> 8);
+  TIM2->CCR2L = (uint8_t)(Compare2);
+}
+
+__attribute__((noinline)) static void TIM2_SetCompare3(uint16_t Compare3)
+{
+  TIM2->CCR3H = (uint8_t)(Compare3 >> 8);
+  TIM2->CCR3L = (uint8_t)(Compare3);
+}
+
+#define OLD_CCxCmd         TIM2_CCxCmd
+#define OLD_PhA_CH         TIM2_CHANNEL_1
+#define OLD_PhB_CH         TIM2_CHANNEL_2
+#define OLD_PhC_CH         TIM2_CHANNEL_3
+#define OLD_PhA_SetCompare TIM2_SetCompare1
+#define OLD_PhB_SetCompare TIM2_SetCompare2
+#define OLD_PhC_SetCompare TIM2_SetCompare3
+#endif
+
+__attribute__((noinline)) static void old_PhA_Disable(void) { OLD_CCxCmd( OLD_PhA_CH, DISABLE ); }
+__attribute__((noinline)) static void old_PhB_Disable(void) { OLD_CCxCmd( OLD_PhB_CH, DISABLE ); }
+__attribute__((noinline)) static void old_PhC_Disable(void) { OLD_CCxCmd( OLD_PhC_CH, DISABLE ); }
+
+__attribute__((noinline)) static void old_PhA_Enable(void)
+{
+  OLD_PhA_SetCompare( global_uDC );
+  OLD_CCxCmd( OLD_PhA_CH, ENABLE );
+}
+
+__attribute__((noinline)) static void old_PhB_Enable(void)
+{
+  OLD_PhB_SetCompare( global_uDC );
+  OLD_CCxCmd( OLD_PhB_CH, ENABLE );
+}
+
+__attribute__((noinline)) static void old_PhC_Enable(void)
+{
+  OLD_PhC_SetCompare( global_uDC );
+  OLD_CCxCmd( OLD_PhC_CH, ENABLE );
+}
+
+static void old_sector_0(void)
+{
+  old_PhC_Disable();
+  PWM_PhC_HB_DISABLE();
+  PWM_PhB_OUTP_LO();
+  PWM_PhB_HB_ENABLE();
+  old_PhA_Enable();
+  PWM_PhA_HB_ENABLE();
+}
+
+static void old_sector_1(void)
+{
+  old_PhC_Disable();
+  PWM_PhB_HB_DISABLE();
+  PWM_PhC_OUTP_LO();
+  PWM_PhC_HB_ENABLE();
+}
+
+static void old_sector_2(void)
+{
+  old_PhA_Disable();
+  PWM_PhA_HB_DISABLE();
+  PWM_PhC_OUTP_LO();
+  PWM_PhC_HB_ENABLE();
+  old_PhB_Enable();
+  PWM_PhB_HB_ENABLE();
+}
+
+static void old_sector_3(void)
+{
+  old_PhC_Disable();
+  PWM_PhC_HB_DISABLE();
+  PWM_PhA_OUTP_LO();
+  PWM_PhA_HB_ENABLE();
+}
+
+static void old_sector_4(void)
+{
+  old_PhB_Disable();
+  PWM_PhB_HB_DISABLE();
+  PWM_PhA_OUTP_LO();
+  PWM_PhA_HB_ENABLE();
+  old_PhC_Enable();
+  PWM_PhC_HB_ENABLE();
+}
+
+static void old_sector_5(void)
+{
+  PWM_PhA_OUTP_LO();
+  PWM_PhA_HB_DISABLE();
+  PWM_PhB_OUTP_LO();
+  PWM_PhB_HB_ENABLE();
+}
+
+typedef void (*step_ptr_t)( void );
+
+static const step_ptr_t Old_step_table[ NR_SECTORS ] =
+{
+  old_sector_0, old_sector_1, old_sector_2, old_sector_3, old_sector_4, old_sector_5
+};
+
+/*
+ * channel enables and /SD levels of the present sector
+ */
+typedef struct
+{
+  uint8_t ccer1, ccer2, sd_a, sd_b, sd_c;
+}
+outputs_t;
+
+static outputs_t get_outputs(void)
+{
+  outputs_t o;
+
+  o.ccer1 = PWM_TIMER->CCER1 & PWM_CCER1_EN_MASK;
+  o.ccer2 = PWM_TIMER->CCER2 & PWM_CCER2_EN_MASK;
+  o.sd_a = SDa_SD_PORT->ODR & SDa_SD_PIN;
+  o.sd_b = SDb_SD_PORT->ODR & SDb_SD_PIN;
+  o.sd_c = SDc_SD_PORT->ODR & SDc_SD_PIN;
+
+  return o;
+}
+
+static int sector;
+
+/*
+ * from the same state, the image of each sector sets the same channel enables
+ * and /SD levels as the step handler, and leaves the other register bits
+ */
+int test_case_equiv_iteration(void)
+{
+  outputs_t o_old, o_new;
+  const uint8_t other = (uint8_t)0x0A; // polarity bits, not in the masks
+
+  Old_step_table[ sector ]();
+  o_old = get_outputs();
+
+  // back to the state ahead of this sector, then load the image instead
+  Old_step_table[ (sector + NR_SECTORS - 1) % NR_SECTORS ]();
+  PWM_TIMER->CCER1 |= other;
+  PWM_TIMER->CCER2 |= other;
+
+  PWM_SECTOR_IMAGE_LOAD( &Image_table[ sector ] );
+  o_new = get_outputs();
+
+  if (o_old.ccer1 != o_new.ccer1 || o_old.ccer2 != o_new.ccer2 ||
+      o_old.sd_a != o_new.sd_a || o_old.sd_b != o_new.sd_b || o_old.sd_c != o_new.sd_c)
+  {
+    printf(" equiv: sector %d ccer %02X %02X / %02X %02X sd %02X %02X %02X / %02X %02X %02X\n",
+           sector, o_old.ccer1, o_old.ccer2, o_new.ccer1, o_new.ccer2,
+           o_old.sd_a, o_old.sd_b, o_old.sd_c, o_new.sd_a, o_new.sd_b, o_new.sd_c);
+    return TEST_FAIL;
+  }
+
+  if ( (PWM_TIMER->CCER1 & other) != other || (PWM_TIMER->CCER2 & other) != other )
+  {
+    printf(" equiv: sector %d bits outside the masks modified\n", sector);
+    return TEST_FAIL;
+  }
+  PWM_TIMER->CCER1 &= (uint8_t)~other;
+  PWM_TIMER->CCER2 &= (uint8_t)~other;
+
+  // continue the sequence from the step handler
+  Old_step_table[ sector ]();
+  sector = (sector + 1) % NR_SECTORS;
+
+  return TEST_OK;
+}
+
+/*
+ * timer state of a phase hand-off: channel enables and the compare register
+ * of each phase
+ */
+typedef struct
+{
+  uint8_t ccer1, ccer2;
+  uint16_t ccr[ 3 ];
+}
+timer_state_t;
+
+static timer_state_t get_timer_state(void)
+{
+  timer_state_t t;
+
+  t.ccer1 = PWM_TIMER->CCER1;
+  t.ccer2 = PWM_TIMER->CCER2;
+  t.ccr[ 0 ] = (uint16_t)( PWM_TIMER->PWM_PhA_CCRH << 8 ) | PWM_TIMER->PWM_PhA_CCRL;
+  t.ccr[ 1 ] = (uint16_t)( PWM_TIMER->PWM_PhB_CCRH << 8 ) | PWM_TIMER->PWM_PhB_CCRL;
+  t.ccr[ 2 ] = (uint16_t)( PWM_TIMER->PWM_PhC_CCRH << 8 ) | PWM_TIMER->PWM_PhC_CCRL;
+
+  return t;
+}
+
+static int handoff;
+
+/*
+ * from the same state, a phase hand-off (disable phase N, load and enable
+ * phase N+1) through the register-direct macros leaves the timer as the SPL
+ * calls do
+ */
+int test_case_handoff_iteration(void)
+{
+  static const step_ptr_t Old_disable[ 3 ] =
+  {
+    old_PhA_Disable, old_PhB_Disable, old_PhC_Disable
+  };
+  static const step_ptr_t Old_enable[ 3 ] =
+  {
+    old_PhA_Enable, old_PhB_Enable, old_PhC_Enable
+  };
+  timer_state_t t_old, t_new;
+  int ph = handoff % 3;
+
+  global_uDC = (uint16_t)( PWM_PERIOD_COUNTS / 4 + handoff );
+
+  Old_enable[ ph ]();
+  Old_disable[ ph ]();
+  Old_enable[ (ph + 1) % 3 ]();
+  t_old = get_timer_state();
+
+  // back to the state ahead of the hand-off, then use the macros instead
+  Old_disable[ (ph + 1) % 3 ]();
+  Old_enable[ ph ]();
+
+  switch (ph)
+  {
+  case 0:
+    PWM_PhA_CC_DISABLE();
+    PWM_PhB_CC_LOAD( global_uDC );
+    PWM_PhB_CC_ENABLE();
+    break;
+  case 1:
+    PWM_PhB_CC_DISABLE();
+    PWM_PhC_CC_LOAD( global_uDC );
+    PWM_PhC_CC_ENABLE();
+    break;
+  default:
+    PWM_PhC_CC_DISABLE();
+    PWM_PhA_CC_LOAD( global_uDC );
+    PWM_PhA_CC_ENABLE();
+    break;
+  }
+  t_new = get_timer_state();
+
+  if (t_old.ccer1 != t_new.ccer1 || t_old.ccer2 != t_new.ccer2 ||
+      t_old.ccr[ 0 ] != t_new.ccr[ 0 ] || t_old.ccr[ 1 ] != t_new.ccr[ 1 ] ||
+      t_old.ccr[ 2 ] != t_new.ccr[ 2 ])
+  {
+    printf(" handoff: phase %d ccer %02X %02X / %02X %02X\n",
+           ph, t_old.ccer1, t_old.ccer2, t_new.ccer1, t_new.ccer2);
+    return TEST_FAIL;
+  }
+
+  Old_disable[ (ph + 1) % 3 ]();
+  handoff += 1;
+
+  return TEST_OK;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+  int n;
+
+  // steady state of the step handlers (sector 5 is entered from sector 4)
+  for (n = 0; n < NR_SECTORS; n++)
+  {
+    Old_step_table[ n ]();
+  }
+  sector = 0;
+
+  putf_n_iterations(NR_SECTORS * 2, &test_case_equiv_iteration, "test_case_equiv_iteration");
+  putf_n_iterations(3 * 2, &test_case_handoff_iteration, "test_case_handoff_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+  test_driver_1();
+}
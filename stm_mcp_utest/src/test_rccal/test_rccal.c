@@ -0,0 +1,263 @@
+/**
+  ******************************************************************************
+  * @file    test_rccal.c
+  * @brief   test driver for rccal.c (simulated transmitter stick sequence)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "rccal.h"
+#include "rcin.h"
+#include "pstore.h"
+#include "pwm_stm8s.h"
+
+
+/*
+ * stubs for the parameter store and the servo display scale
+ */
+static pstore_params_t Params;
+static uint16_t Pwm_lo;
+static uint16_t Pwm_hi;
+
+const pstore_params_t * Pstore_get(void) { return &Params; }
+void Pstore_set(const pstore_params_t * pparams) { Params = *pparams; }
+void PWM_set_servo_range(uint16_t lo, uint16_t hi) { Pwm_lo = lo; Pwm_hi = hi; }
+
+/*
+ * Simulated 50 Hz servo signal (a pulse each 20 control frames) with +/-2
+ * counts of noise, and the control frame as in driver.c
+ */
+#define SIM_PERD_FRAMES  20
+
+static uint32_t Sim_rand = 1;
+static int Sim_frame;
+static int Sim_signal; // 0 if the transmitter is off
+
+static uint16_t sim_noise(uint16_t dur)
+{
+    Sim_rand = Sim_rand * 1103515245 + 12345;
+
+    return (uint16_t)( dur + (int)( ( Sim_rand >> 16 ) % 5 ) - 2 );
+}
+
+static void sim_start(void)
+{
+    Params.thr_lo = TCC_TIME_ARMING;
+    Params.thr_hi = TCC_TIME_MAX_THRUST;
+
+    Rcin_reset();
+    Rccal_init();
+
+    Sim_frame = 0;
+    Sim_signal = 1;
+}
+
+/*
+ * one control frame with the stick at 'us', returns TRUE if the throttle is
+ * held
+ */
+static uint8_t sim_frame(double us)
+{
+    Rcin_on_frame();
+
+    if (Sim_signal && 0 == Sim_frame % SIM_PERD_FRAMES)
+    {
+        Rcin_on_pulse( sim_noise( (uint16_t)( us * RCIN_CT_PER_US ) ),
+                       SIM_PERD_FRAMES * 1000 * RCIN_CT_PER_US );
+    }
+    Sim_frame += 1;
+
+    return Rccal_update( Rcin_get_loss() ? RCIN_NONE : Rcin_get_protocol(),
+                         Rcin_get_pulse_dur() );
+}
+
+/*
+ * full stick at power-up 3 s, stick moved to low over 0.5 s, held low 3 s:
+ * the range is measured within the noise and applied
+ */
+int test_case_calib_iteration(void)
+{
+    uint16_t lo, hi, thr;
+    int n;
+
+    sim_start();
+
+    for (n = 0; n < 3000; n++)
+    {
+        uint8_t held = sim_frame( 2000 );
+
+        if (n > 200 && FALSE == held)
+        {
+            printf(" calib: not held at frame %d status %d\n", n, Rccal_get_status());
+            return TEST_FAIL;
+        }
+    }
+    if (RCCAL_LO != Rccal_get_status())
+    {
+        printf(" calib: status %d after full stick\n", Rccal_get_status());
+        return TEST_FAIL;
+    }
+
+    for (n = 0; n < 500; n++)
+    {
+        (void)sim_frame( 2000 - n * 2 );
+    }
+    for (n = 0; n < 3000; n++)
+    {
+        (void)sim_frame( 1000 );
+    }
+
+    if (RCCAL_DONE != Rccal_get_status())
+    {
+        printf(" calib: status %d after low stick\n", Rccal_get_status());
+        return TEST_FAIL;
+    }
+
+    Rccal_get_range( &lo, &hi );
+    printf(" calib: range %u %u\n", lo, hi);
+
+    // 1000-2000 us less 1/32 of the range at each end, within the noise
+    if (lo < 2000 + 62 - 2 || lo > 2000 + 62 + 2 || hi < 4000 - 62 - 2 || hi > 4000 - 62 + 2)
+    {
+        return TEST_FAIL;
+    }
+
+    Rccal_apply();
+
+    if (RCCAL_OFF != Rccal_get_status() || lo != Params.thr_lo || hi != Params.thr_hi ||
+        lo != Pwm_lo || hi != Pwm_hi)
+    {
+        printf(" calib: not applied\n");
+        return TEST_FAIL;
+    }
+
+    // throttle is released, full stick is full throttle
+    for (n = 0; n < 3 * SIM_PERD_FRAMES; n++)
+    {
+        if (FALSE != sim_frame( 2000 ))
+        {
+            return TEST_FAIL;
+        }
+    }
+    (void)Rcin_get_throttle( &thr );
+
+    if (PWM_PERIOD_COUNTS != thr)
+    {
+        printf(" calib: full stick throttle %u\n", thr);
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * stick low at power-up: no calibration, the throttle is never held
+ */
+int test_case_normal_iteration(void)
+{
+    int n;
+
+    sim_start();
+
+    for (n = 0; n < 2 * RCCAL_START_FRAMES; n++)
+    {
+        if (FALSE != sim_frame( 1100 ))
+        {
+            printf(" normal: held at frame %d\n", n);
+            return TEST_FAIL;
+        }
+    }
+
+    if (RCCAL_OFF != Rccal_get_status() || TCC_TIME_ARMING != Params.thr_lo)
+    {
+        printf(" normal: status %d\n", Rccal_get_status());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * stick never lowered: fails at the timeout and holds the throttle at zero
+ */
+int test_case_timeout_iteration(void)
+{
+    int n;
+
+    sim_start();
+
+    for (n = 0; n < RCCAL_TIMEOUT_FRAMES + 1000; n++)
+    {
+        (void)sim_frame( (n & 0x400) ? 1900 : 2000 ); // full stick, wobbling
+    }
+
+    if (RCCAL_FAILED != Rccal_get_status() || FALSE == sim_frame( 1000 ))
+    {
+        printf(" timeout: status %d\n", Rccal_get_status());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * transmitter switched off during the calibration
+ */
+int test_case_loss_iteration(void)
+{
+    int n;
+
+    sim_start();
+
+    for (n = 0; n < 1000; n++)
+    {
+        (void)sim_frame( 2000 );
+    }
+    Sim_signal = 0;
+
+    for (n = 0; n < 2 * RCIN_LOSS_FRAMES; n++)
+    {
+        (void)sim_frame( 2000 );
+    }
+
+    if (RCCAL_FAILED != Rccal_get_status())
+    {
+        printf(" loss: status %d\n", Rccal_get_status());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    putf_n_iterations(1, &test_case_calib_iteration, "test_case_calib_iteration");
+
+    putf_n_iterations(1, &test_case_normal_iteration, "test_case_normal_iteration");
+
+    putf_n_iterations(1, &test_case_timeout_iteration, "test_case_timeout_iteration");
+
+    putf_n_iterations(1, &test_case_loss_iteration, "test_case_loss_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
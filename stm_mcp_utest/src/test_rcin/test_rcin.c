@@ -0,0 +1,380 @@
+/**
+  ******************************************************************************
+  * @file    test_rcin.c
+  * @brief   test driver for rcin.c (synthetic pulse duration and period)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "rcin.h"
+#include "pwm_stm8s.h"
+
+
+/*
+ * Protocol under test: throttle range and pulse period in us
+ */
+typedef struct
+{
+    rcin_protocol_t protocol;
+    double lo_us;
+    double hi_us;
+    double perd_us;
+}
+sim_proto_t;
+
+static const sim_proto_t Sim_protos[] =
+{
+    { RCIN_PWM,         1100, 1900, 20000 }, // 50 Hz
+    { RCIN_PWM,         1100, 1900,  2500 }, // 400 Hz
+    { RCIN_ONESHOT125,   125,  250,   500 }, // 2 kHz
+    { RCIN_ONESHOT42,     42,   84,   100 }, // 10 kHz
+    { RCIN_MULTISHOT,      5,   25,    32 }  // 31 kHz
+};
+
+#define SIM_NR_PROTOS  (int)( sizeof(Sim_protos) / sizeof(Sim_protos[0]) )
+
+static int Sim_proto;
+static int Sim_pulses;
+
+static uint16_t counts(double us)
+{
+    return (uint16_t)( us * RCIN_CT_PER_US + 0.5 );
+}
+
+static void sim_pulse(const sim_proto_t * pp, double dur_us)
+{
+    Rcin_on_pulse( counts( dur_us ), counts( pp->perd_us ) );
+    Sim_pulses += 1;
+}
+
+/*
+ * each protocol is locked after RCIN_DETECT_CT pulses (not before), then the
+ * throttle follows the pulse over the range with the resolution of the timer
+ */
+int test_case_detect_iteration(void)
+{
+    const sim_proto_t * pp = &Sim_protos[ Sim_proto ];
+    double range = pp->hi_us - pp->lo_us;
+    double dur_min_us = pp->lo_us - (int)range / 4;
+    uint16_t thr;
+    uint16_t dur;
+    double expect;
+
+    Rcin_reset();
+
+    for (Sim_pulses = 0; Sim_pulses < RCIN_DETECT_CT; )
+    {
+        if (RCIN_NONE != Rcin_get_protocol())
+        {
+            printf(" detect: locked after %d pulses\n", Sim_pulses);
+            return TEST_FAIL;
+        }
+        sim_pulse(pp, pp->lo_us + range / 2);
+    }
+
+    if (pp->protocol != Rcin_get_protocol())
+    {
+        printf(" detect: protocol %d, expected %d\n", Rcin_get_protocol(), pp->protocol);
+        return TEST_FAIL;
+    }
+
+    (void)Rcin_get_throttle( &thr );
+
+    // shortest pulse is at least half of the zero throttle pulse
+    if (dur_min_us < pp->lo_us / 2)
+    {
+        dur_min_us = pp->lo_us / 2;
+    }
+
+    // below, over and within the throttle range, each timer count (twice, to
+    // settle the median filter)
+    for (dur = counts( dur_min_us ); dur <= counts( pp->hi_us + (int)range / 4 ); dur++)
+    {
+        Rcin_on_pulse( dur, counts( pp->perd_us ) );
+        Rcin_on_pulse( dur, counts( pp->perd_us ) );
+
+        if (FALSE == Rcin_get_throttle( &thr ) || FALSE != Rcin_get_throttle( &thr ) ||
+            Rcin_get_pulse_dur() != dur)
+        {
+            printf(" detect: pulse %u not signalled once\n", dur);
+            return TEST_FAIL;
+        }
+
+        expect = ( dur / (double)RCIN_CT_PER_US - pp->lo_us ) * PWM_PERIOD_COUNTS / range;
+        expect = (expect < 0) ? 0 : (expect > PWM_PERIOD_COUNTS) ? PWM_PERIOD_COUNTS : expect;
+
+        if (thr > expect + 1 || thr < expect - 1)
+        {
+            printf(" detect: pulse %u throttle %u, expected %.1f\n", dur, thr, expect);
+            return TEST_FAIL;
+        }
+    }
+
+    if (0 != Rcin_get_errors())
+    {
+        printf(" detect: %u errors\n", Rcin_get_errors());
+        return TEST_FAIL;
+    }
+
+    printf(" detect: protocol %d steps %u\n", pp->protocol,
+           counts( pp->hi_us ) - counts( pp->lo_us ));
+
+    Sim_proto += 1;
+
+    return (Sim_proto < SIM_NR_PROTOS) ? TEST_OK : TEST_DONE;
+}
+
+/*
+ * pulses alternating between protocols, or with a period too short for the
+ * pulse, do not lock a protocol
+ */
+int test_case_noise_iteration(void)
+{
+    static const double noise_us[] = { 1500, 150, 60, 15 };
+    int n;
+
+    Rcin_reset();
+
+    for (n = 0; n < 1000; n++)
+    {
+        Rcin_on_pulse( counts( noise_us[ n % 4 ] ), counts( 2500 ) );
+    }
+
+    for (n = 0; n < 1000; n++)
+    {
+        Rcin_on_pulse( counts( 1500 ), counts( 1000 ) ); // period < pulse range
+        Rcin_on_pulse( counts( 200 ), counts( 30000 ) ); // period > 40 Hz
+        Rcin_on_pulse( counts( 500 ), counts( 2500 ) ); // between protocols
+    }
+
+    if (RCIN_NONE != Rcin_get_protocol())
+    {
+        printf(" noise: locked to %d\n", Rcin_get_protocol());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * once locked, a pulse of another protocol is rejected and the throttle held
+ */
+int test_case_locked_iteration(void)
+{
+    uint16_t thr;
+    int n;
+
+    Rcin_reset();
+
+    for (n = 0; n < RCIN_DETECT_CT; n++)
+    {
+        Rcin_on_pulse( counts( 1500 ), counts( 20000 ) );
+    }
+    (void)Rcin_get_throttle( &thr );
+
+    for (n = 0; n < 100; n++)
+    {
+        Rcin_on_pulse( counts( 200 ), counts( 500 ) ); // OneShot125 full throttle
+    }
+
+    if (RCIN_PWM != Rcin_get_protocol() || FALSE != Rcin_get_throttle( &thr ) ||
+        PWM_PERIOD_COUNTS / 2 != thr || 100 != Rcin_get_errors())
+    {
+        printf(" locked: protocol %d throttle %u errors %u\n",
+               Rcin_get_protocol(), thr, Rcin_get_errors());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * lock to standard PWM at 50 Hz and half throttle
+ */
+static void lock_pwm(void)
+{
+    int n;
+
+    Rcin_reset();
+
+    for (n = 0; n < RCIN_DETECT_CT; n++)
+    {
+        Rcin_on_pulse( counts( 1500 ), counts( 20000 ) );
+    }
+}
+
+/*
+ * a single corrupted pulse within the range does not move the throttle, two
+ * consecutive pulses (a step) do
+ */
+int test_case_glitch_iteration(void)
+{
+    uint16_t thr;
+
+    lock_pwm();
+
+    Rcin_on_pulse( counts( 1900 ), counts( 20000 ) );
+    Rcin_on_pulse( counts( 1500 ), counts( 20000 ) );
+    (void)Rcin_get_throttle( &thr );
+
+    if (PWM_PERIOD_COUNTS / 2 != thr)
+    {
+        printf(" glitch: throttle %u\n", thr);
+        return TEST_FAIL;
+    }
+
+    Rcin_on_pulse( counts( 1900 ), counts( 20000 ) );
+    Rcin_on_pulse( counts( 1900 ), counts( 20000 ) );
+    (void)Rcin_get_throttle( &thr );
+
+    if (PWM_PERIOD_COUNTS != thr)
+    {
+        printf(" glitch: step throttle %u\n", thr);
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * Multishot: a glitch shorter than half of the zero throttle pulse is rejected
+ * and the throttle held
+ */
+int test_case_multishot_glitch_iteration(void)
+{
+    uint16_t thr;
+    int n;
+
+    Rcin_reset();
+
+    for (n = 0; n < RCIN_DETECT_CT; n++)
+    {
+        Rcin_on_pulse( counts( 15 ), counts( 32 ) );
+    }
+    (void)Rcin_get_throttle( &thr );
+
+    for (n = 0; n < 10; n++)
+    {
+        Rcin_on_pulse( counts( 2 ), counts( 32 ) );
+    }
+
+    if (RCIN_MULTISHOT != Rcin_get_protocol() || FALSE != Rcin_get_throttle( &thr ) ||
+        PWM_PERIOD_COUNTS / 2 != thr || 10 != Rcin_get_errors())
+    {
+        printf(" multishot glitch: protocol %d throttle %u errors %u\n",
+               Rcin_get_protocol(), thr, Rcin_get_errors());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * a noise spike between two pulses gives a short period and is rejected, the
+ * pulse following it is accepted (period from the spike)
+ */
+int test_case_spike_iteration(void)
+{
+    uint16_t thr;
+
+    lock_pwm();
+
+    Rcin_on_pulse( counts( 1900 ), counts( 1000 ) );  // spike 1 ms after a pulse
+    Rcin_on_pulse( counts( 1900 ), counts( 1000 ) );
+    Rcin_on_pulse( counts( 1500 ), counts( 19000 ) ); // next pulse 19 ms later
+
+    if (FALSE == Rcin_get_throttle( &thr ) ||
+        PWM_PERIOD_COUNTS / 2 != thr || 2 != Rcin_get_errors())
+    {
+        printf(" spike: throttle %u errors %u\n", thr, Rcin_get_errors());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * no pulse for RCIN_LOSS_FRAMES control frames is a signal loss, cleared by
+ * the next pulse, but not before a protocol is locked
+ */
+int test_case_loss_iteration(void)
+{
+    int n;
+
+    Rcin_reset();
+
+    for (n = 0; n < 2 * RCIN_LOSS_FRAMES; n++)
+    {
+        Rcin_on_frame();
+    }
+    if (FALSE != Rcin_get_loss())
+    {
+        printf(" loss: before lock\n");
+        return TEST_FAIL;
+    }
+
+    lock_pwm();
+
+    for (n = 1; n <= RCIN_LOSS_FRAMES; n++)
+    {
+        if (0 == n % 20)
+        {
+            Rcin_on_pulse( counts( 3000 ), counts( 20000 ) ); // not plausible
+        }
+        Rcin_on_frame();
+
+        if ( (n >= RCIN_LOSS_FRAMES) != (FALSE != Rcin_get_loss()) )
+        {
+            printf(" loss: %d at frame %d\n", Rcin_get_loss(), n);
+            return TEST_FAIL;
+        }
+    }
+
+    Rcin_on_pulse( counts( 1500 ), counts( 20000 ) );
+
+    if (FALSE != Rcin_get_loss())
+    {
+        printf(" loss: not cleared\n");
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    Sim_proto = 0;
+    putf_n_iterations(SIM_NR_PROTOS, &test_case_detect_iteration, "test_case_detect_iteration");
+
+    putf_n_iterations(1, &test_case_noise_iteration, "test_case_noise_iteration");
+
+    putf_n_iterations(1, &test_case_locked_iteration, "test_case_locked_iteration");
+
+    putf_n_iterations(1, &test_case_glitch_iteration, "test_case_glitch_iteration");
+
+    putf_n_iterations(1, &test_case_multishot_glitch_iteration, "test_case_multishot_glitch_iteration");
+
+    putf_n_iterations(1, &test_case_spike_iteration, "test_case_spike_iteration");
+
+    putf_n_iterations(1, &test_case_loss_iteration, "test_case_loss_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
@@ -0,0 +1,197 @@
+/**
+  ******************************************************************************
+  * @file    test_superv.c
+  * @brief   test driver for superv.c (simulated ISR overrun and starvation)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "superv.h"
+
+
+/*
+ * stubs for the watchdog and the phase outputs
+ */
+static int Wdg_started;
+static int Wdg_kicks;
+static int Phase_stops;
+
+void MCU_wdg_init(void) { Wdg_started = 1; }
+void MCU_wdg_kick(void) { Wdg_kicks += 1; }
+void All_phase_stop(void) { Phase_stops += 1; }
+
+/*
+ * Simulated time line: a control frame is ~1 ms, the commutation timer
+ * interrupts 'comm_per_frame' times within it, and the background loop gets
+ * to run (or not) once per frame.
+ */
+static int Sim_comm_per_frame;
+static int Sim_background; // background loop runs each frame
+static int Sim_frames;
+
+static void sim_start(int comm_per_frame, int background)
+{
+    Wdg_started = 0;
+    Wdg_kicks = 0;
+    Phase_stops = 0;
+
+    Superv_init();
+
+    Sim_comm_per_frame = comm_per_frame;
+    Sim_background = background;
+    Sim_frames = 0;
+}
+
+static void sim_frame(void)
+{
+    int n;
+
+    for (n = 0; n < Sim_comm_per_frame; n++)
+    {
+        Superv_on_comm_isr();
+    }
+    Superv_on_control_frame();
+
+    if (Sim_background)
+    {
+        Superv_on_background();
+    }
+    Sim_frames += 1;
+}
+
+/*
+ * 100k eRPM (40 commutation timer events per frame): no fault, the watchdog
+ * is kicked every frame
+ */
+int test_case_normal_iteration(void)
+{
+    sim_frame();
+
+    if (0 != Superv_get_status() || 0 != Phase_stops)
+    {
+        printf(" normal: status %X stops %d\n", Superv_get_status(), Phase_stops);
+        return TEST_FAIL;
+    }
+    if (Wdg_kicks != Sim_frames || 0 == Wdg_started)
+    {
+        printf(" normal: %d kicks in %d frames\n", Wdg_kicks, Sim_frames);
+        return TEST_FAIL;
+    }
+    return TEST_OK;
+}
+
+/*
+ * commutation timing runaway: the ISR overrun is detected in the first frame,
+ * the phases are shut off and the watchdog is not serviced any more
+ */
+int test_case_overrun_iteration(void)
+{
+    int kicks = Wdg_kicks;
+
+    // normal for 10 frames, then the commutation timer period collapses
+    if (10 == Sim_frames)
+    {
+        Sim_comm_per_frame = 200;
+    }
+
+    sim_frame();
+
+    if (Sim_frames <= 10)
+    {
+        return (0 == Superv_get_status()) ? TEST_OK : TEST_FAIL;
+    }
+
+    if (0 == (Superv_get_status() & SUPERV_ISR_OVERRUN) || 0 == Phase_stops)
+    {
+        printf(" overrun: not detected, status %X\n", Superv_get_status());
+        return TEST_FAIL;
+    }
+    if (kicks != Wdg_kicks)
+    {
+        printf(" overrun: watchdog kicked after fault\n");
+        return TEST_FAIL;
+    }
+
+    // phases are held off in each frame while the watchdog runs out
+    if (Sim_frames > 20)
+    {
+        if (Phase_stops != Sim_frames - 10)
+        {
+            printf(" overrun: %d stops in %d frames\n", Phase_stops, Sim_frames - 10);
+            return TEST_FAIL;
+        }
+        return TEST_DONE;
+    }
+    return TEST_OK;
+}
+
+/*
+ * ISRs starve the background loop (but not enough to trip the overrun): the
+ * starvation is detected after the timeout and no kicks are given meanwhile
+ */
+int test_case_starve_iteration(void)
+{
+    sim_frame();
+
+    if (0 != Wdg_kicks)
+    {
+        printf(" starve: watchdog kicked without background\n");
+        return TEST_FAIL;
+    }
+
+    if (0 != Superv_get_status())
+    {
+        if (SUPERV_BG_STARVED != Superv_get_status() ||
+            Sim_frames != SUPERV_BG_TIMEOUT_FRAMES + 1)
+        {
+            printf(" starve: status %X after %d frames\n", Superv_get_status(), Sim_frames);
+            return TEST_FAIL;
+        }
+        if (0 == Phase_stops)
+        {
+            printf(" starve: phases not stopped\n");
+            return TEST_FAIL;
+        }
+        printf(" starve: detected after %d frames\n", Sim_frames);
+        return TEST_DONE;
+    }
+    return TEST_OK;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    sim_start(40, 1);
+    putf_n_iterations(1000, &test_case_normal_iteration, "test_case_normal_iteration");
+
+    sim_start(40, 1);
+    putf_n_iterations(1000, &test_case_overrun_iteration, "test_case_overrun_iteration");
+
+    sim_start(SUPERV_COMM_ISR_MAX, 0);
+    putf_n_iterations(1000, &test_case_starve_iteration, "test_case_starve_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
@@ -0,0 +1,170 @@
+/**
+  ******************************************************************************
+  * @file    test_telem.c
+  * @brief   test driver for telem.c (decoded as by the flight controller)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "telem.h"
+
+
+/*
+ * Receiver: line levels to GCR (a transition is a 1), 5-bit GCR to nibble,
+ * CRC check and period from exponent and mantissa. Returns -1 if invalid.
+ */
+static int decode(uint32_t line)
+{
+    static const uint8_t gcr_tbl[ 16 ] =
+    {
+        0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17,
+        0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+    };
+    uint32_t gcr = ( line ^ ( line >> 1 ) ) & 0xFFFFF;
+    uint16_t frame = 0;
+    uint16_t v;
+    int n, k;
+
+    if (0 != ( line >> ( TELEM_NR_BITS - 1 ) ))
+    {
+        return -1; // start bit
+    }
+
+    for (n = 15; n >= 0; n -= 5)
+    {
+        for (k = 0; k < 16 && gcr_tbl[ k ] != ( ( gcr >> n ) & 0x1F ); k++);
+
+        if (16 == k)
+        {
+            return -1;
+        }
+        frame = (uint16_t)( ( frame << 4 ) | k );
+    }
+
+    v = frame >> 4;
+
+    if (( ~( v ^ ( v >> 4 ) ^ ( v >> 8 ) ) & 0x0F ) != ( frame & 0x0F ))
+    {
+        return -1;
+    }
+    return ( v & 0x1FF ) << ( v >> 9 );
+}
+
+/*
+ * longest run of equal line levels, including the idle high before the start
+ */
+static int max_run(uint32_t line)
+{
+    int n, run = 1, max = 1;
+    int prev = 1;
+
+    for (n = TELEM_NR_BITS - 1; n >= 0; n--)
+    {
+        int b = (int)( ( line >> n ) & 1 );
+
+        run = (b == prev) ? run + 1 : 1;
+        max = (run > max) ? run : max;
+        prev = b;
+    }
+    return max;
+}
+
+static uint16_t Comm_period;
+
+/*
+ * each commutation period: the decoded electrical period is 3 us per count
+ * within the resolution of the mantissa (at least 256 steps), and the line is DC balanced
+ * enough for the receiver (no run longer than 3 bits)
+ */
+int test_case_period_iteration(void)
+{
+    uint32_t expect = (uint32_t)Comm_period * 3;
+    uint32_t line;
+    int period;
+
+    if (expect > TELEM_EPERIOD_MAX)
+    {
+        expect = TELEM_EPERIOD_MAX;
+    }
+
+    line = Telem_gcr( Telem_frame( Telem_eperiod_us( Comm_period ) ) );
+    period = decode( line );
+
+    if (period < 0 || period > (int)expect || period < (int)( expect - ( expect >> 8 ) ))
+    {
+        printf(" period: comm %u decoded %d expected %u\n", Comm_period, period, expect);
+        return TEST_FAIL;
+    }
+    if (max_run( line ) > 3 || 0 != ( line >> TELEM_NR_BITS ))
+    {
+        printf(" period: comm %u line %06X\n", Comm_period, line);
+        return TEST_FAIL;
+    }
+
+    Comm_period += 1;
+
+    return (0 == Comm_period) ? TEST_DONE : TEST_OK;
+}
+
+/*
+ * stopped motor (BL_reset sets the period to U16_MAX) is the longest period
+ * i.e. 0 eRPM, and a single bit error is detected
+ */
+int test_case_stopped_iteration(void)
+{
+    uint32_t line = Telem_gcr( Telem_frame( Telem_eperiod_us( 0xFFFF ) ) );
+    int n, errs = 0;
+
+    if (TELEM_EPERIOD_MAX != decode( line ))
+    {
+        printf(" stopped: decoded %d\n", decode( line ));
+        return TEST_FAIL;
+    }
+
+    line = Telem_gcr( Telem_frame( 1000 ) );
+
+    for (n = 0; n < TELEM_NR_BITS - 1; n++)
+    {
+        errs += ( 1000 == decode( line ^ ( (uint32_t)1 << n ) ) );
+    }
+    if (0 != errs)
+    {
+        printf(" stopped: %d bit errors not detected\n", errs);
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    Comm_period = 1;
+    putf_n_iterations(65535, &test_case_period_iteration, "test_case_period_iteration");
+
+    putf_n_iterations(1, &test_case_stopped_iteration, "test_case_stopped_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
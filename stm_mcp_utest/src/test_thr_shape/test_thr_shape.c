@@ -0,0 +1,242 @@
+/**
+  ******************************************************************************
+  * @file    test_thr_shape.c
+  * @brief   test driver and host benchmark for thr_shape.c
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "thr_shape.h"
+
+
+#define BENCH_N_ITER  1000000L
+
+static uint16_t prev_output;
+static uint16_t step_input;
+
+/*
+ * input within the deadband must give zero output
+ */
+int test_case_deadband_iteration(void)
+{
+    static uint16_t input = 0;
+
+    Thr_shape_reset();
+    Thr_shape_set_input(input);
+
+    if (0 != Thr_shape_update())
+    {
+        printf(" deadband: input = %u output = %u\n", input, Thr_shape_get_output());
+        return TEST_FAIL;
+    }
+    input += 1;
+
+    if (input > (THR_FULL_SCALE / 50))
+    {
+        return TEST_DONE;
+    }
+    return TEST_OK;
+}
+
+/*
+ * steady-state curve must be monotonic and reach full scale
+ */
+int test_case_curve_iteration(void)
+{
+    static uint16_t input = 0;
+    uint16_t output;
+    int n;
+
+    Thr_shape_reset();
+    Thr_shape_set_input(input);
+
+    // run enough frames to settle
+    for (n = 0; n < 1024; n++)
+    {
+        output = Thr_shape_update();
+    }
+
+    if (output < prev_output || output > THR_FULL_SCALE)
+    {
+        printf(" curve: input = %u output = %u prev = %u\n", input, output, prev_output);
+        return TEST_FAIL;
+    }
+    prev_output = output;
+
+    if (input >= THR_FULL_SCALE)
+    {
+        if (output != THR_FULL_SCALE)
+        {
+            printf(" curve: full scale output = %u\n", output);
+            return TEST_FAIL;
+        }
+        return TEST_DONE;
+    }
+    input += 1;
+    return TEST_OK;
+}
+
+/*
+ * on a step input, the per-frame change of the output must stay within the
+ * slew limit and the output must settle on the target
+ */
+int test_case_slew_iteration(void)
+{
+    uint16_t output = Thr_shape_update();
+    uint16_t delta;
+
+    if (output >= prev_output)
+    {
+        delta = output - prev_output;
+        if (delta > (THR_FULL_SCALE / 256))
+        {
+            printf(" slew up: %u -> %u\n", prev_output, output);
+            return TEST_FAIL;
+        }
+    }
+    else
+    {
+        delta = prev_output - output;
+        if (delta > (THR_FULL_SCALE / 128))
+        {
+            printf(" slew dn: %u -> %u\n", prev_output, output);
+            return TEST_FAIL;
+        }
+    }
+    prev_output = output;
+
+    if (step_input == THR_FULL_SCALE && output == THR_FULL_SCALE)
+    {
+        return TEST_DONE;
+    }
+    if (step_input == 0 && output == 0)
+    {
+        return TEST_DONE;
+    }
+    return TEST_OK;
+}
+
+/*
+ * inputs between control frames (digital throttle frames): the output tracks
+ * each input at once but stays within one slew step of the output at the
+ * start of the control frame, and a step within the slew limit is complete at
+ * the first track
+ */
+int test_case_track_iteration(void)
+{
+    static uint16_t input = 0;
+    uint16_t base = Thr_shape_update();
+    uint16_t output;
+    int n;
+
+    for (n = 0; n < 4; n++)
+    {
+        input = (input + 97) % (THR_FULL_SCALE + 1);
+        Thr_shape_set_input(input);
+        output = Thr_shape_track();
+
+        if ( (output > base && output - base > (THR_FULL_SCALE / 256)) ||
+             (output < base && base - output > (THR_FULL_SCALE / 128)) )
+        {
+            printf(" track: %u -> %u\n", base, output);
+            return TEST_FAIL;
+        }
+    }
+
+    // settle, then a step within the slew limit
+    for (n = 0; n < 2000; n++)
+    {
+        Thr_shape_update();
+    }
+    Thr_shape_set_input(input + 1);
+    output = Thr_shape_track();
+
+    if (output != Thr_shape_update())
+    {
+        printf(" track: step %u not applied at once\n", input + 1);
+        return TEST_FAIL;
+    }
+    return TEST_OK;
+}
+
+/*
+ * host benchmark of the control-frame evaluation
+ */
+void test_bench(void)
+{
+    clock_t t0, t1;
+    long n;
+    uint32_t sum = 0;
+
+    Thr_shape_reset();
+    t0 = clock();
+
+    for (n = 0; n < BENCH_N_ITER; n++)
+    {
+        Thr_shape_set_input( (uint16_t)(n % (THR_FULL_SCALE + 1)) );
+        sum += Thr_shape_update();
+    }
+    t1 = clock();
+
+    printf(" benchmark: %ld updates %.1f ns/update (checksum %08X)\n",
+           BENCH_N_ITER,
+           (double)(t1 - t0) * 1.0e9 / CLOCKS_PER_SEC / BENCH_N_ITER,
+           (unsigned int)sum);
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    Thr_shape_init();
+
+    putf_n_iterations(1000, &test_case_deadband_iteration, "test_case_deadband_iteration");
+
+    prev_output = 0;
+    putf_n_iterations(THR_FULL_SCALE + 1, &test_case_curve_iteration, "test_case_curve_iteration");
+
+    Thr_shape_reset();
+    prev_output = 0;
+    step_input = THR_FULL_SCALE;
+    Thr_shape_set_input(step_input);
+    putf_n_iterations(10000, &test_case_slew_iteration, "test_case_slew_iteration (up)");
+
+    step_input = 0;
+    Thr_shape_set_input(step_input);
+    putf_n_iterations(10000, &test_case_slew_iteration, "test_case_slew_iteration (down)");
+
+    // output held by a downstream limiter (regen), slews down from there
+    Thr_shape_set_output(THR_FULL_SCALE / 2);
+    prev_output = THR_FULL_SCALE / 2;
+    putf_n_iterations(10000, &test_case_slew_iteration, "test_case_slew_iteration (held)");
+
+    Thr_shape_reset();
+    putf_n_iterations(100, &test_case_track_iteration, "test_case_track_iteration");
+
+    test_bench();
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
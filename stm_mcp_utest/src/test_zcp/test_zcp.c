@@ -0,0 +1,198 @@
+/**
+  ******************************************************************************
+  * @file    test_zcp.c
+  * @brief   test driver for zcp.c (simulated comparator edges)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2021
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "zcp.h"
+
+
+/*
+ * ISR latency from the capture to the handler, timestamp counts
+ */
+#define SIM_LATENCY  10
+
+/*
+ * Simulated rotor: sector period in timestamp counts, the ZCP is at 30 degrees
+ * with the comparator offset alternating +/- Sim_ofs (rising, falling float)
+ */
+static uint16_t Sim_tm;
+static uint16_t Sim_perd;
+static uint16_t Sim_ofs;
+static int Sim_sectors;
+
+static void sim_start(uint16_t perd, uint16_t ofs)
+{
+    Sim_tm = 0xF000; // timestamp wraps during the test
+    Sim_perd = perd;
+    Sim_ofs = ofs;
+    Sim_sectors = 0;
+
+    Zcp_reset();
+}
+
+/*
+ * commutate to the next sector
+ */
+static void sim_commutate(void)
+{
+    Sim_tm += Sim_perd;
+    Sim_sectors += 1;
+
+    Zcp_on_commutation( Sim_tm, Sim_perd );
+}
+
+/*
+ * edges of one sector: commutation spike, ZCP and comparator chatter, only the
+ * ZCP is accepted and the commutation is due at 30 degrees less the advance
+ */
+int test_case_rotate_iteration(void)
+{
+    uint16_t delay = 0xFFFF;
+    uint16_t t_zcp;
+    uint16_t due;
+
+    sim_commutate();
+
+    t_zcp = Sim_tm + ( Sim_perd >> 1 );
+    t_zcp = (Sim_sectors & 1) ? t_zcp + Sim_ofs : t_zcp - Sim_ofs;
+
+    if (FALSE != Zcp_on_capture( Sim_tm + 5, Sim_tm + 5 + SIM_LATENCY, &delay ))
+    {
+        printf(" rotate: edge in the blanking window accepted\n");
+        return TEST_FAIL;
+    }
+
+    if (FALSE == Zcp_on_capture( t_zcp, t_zcp + SIM_LATENCY, &delay ))
+    {
+        printf(" rotate: ZCP not accepted in sector %d\n", Sim_sectors);
+        return TEST_FAIL;
+    }
+
+    if (FALSE != Zcp_on_capture( t_zcp + 3, t_zcp + 3 + SIM_LATENCY, &delay ))
+    {
+        printf(" rotate: chatter accepted\n");
+        return TEST_FAIL;
+    }
+
+    // the first interval is measured at the second ZCP, lock after ZCP_LOCK_CT
+    if ( ( Sim_sectors > ZCP_LOCK_CT ) != ( FALSE != Zcp_is_locked() ) )
+    {
+        printf(" rotate: lock %u in sector %d\n", Zcp_is_locked(), Sim_sectors);
+        return TEST_FAIL;
+    }
+
+    if (Sim_sectors > 2)
+    {
+        due = ( Sim_perd >> 1 ) - ( Sim_perd >> ZCP_ADV_SH ) - SIM_LATENCY;
+
+        if (Sim_perd != Zcp_get_period() || due != delay)
+        {
+            printf(" rotate: period %u delay %u in sector %d\n",
+                   Zcp_get_period(), delay, Sim_sectors);
+            return TEST_FAIL;
+        }
+    }
+    return (0 == Zcp_get_status()) ? TEST_OK : TEST_FAIL;
+}
+
+/*
+ * sectors without a ZCP, the lock is lost after ZCP_MISS_MAX sectors in a row
+ * and the status is latched until reset - a missed sector is counted at the
+ * commutation that ends it
+ */
+int test_case_miss_iteration(void)
+{
+    static int commutations = 0;
+    uint16_t delay;
+    int misses;
+
+    sim_commutate();
+    commutations += 1;
+    misses = commutations - 1;
+
+    if (misses < ZCP_MISS_MAX)
+    {
+        return ( FALSE != Zcp_is_locked() && 0 == Zcp_get_status() ) ?
+               TEST_OK : TEST_FAIL;
+    }
+
+    if (FALSE != Zcp_is_locked() || 0 == Zcp_get_status())
+    {
+        printf(" miss: lock %u status %u after %d sectors\n",
+               Zcp_is_locked(), Zcp_get_status(), misses);
+        return TEST_FAIL;
+    }
+
+    sim_commutate();
+    (void)Zcp_on_capture( Sim_tm + ( Sim_perd >> 1 ), Sim_tm + ( Sim_perd >> 1 ), &delay );
+
+    if (0 == Zcp_get_status() || FALSE != Zcp_is_locked())
+    {
+        printf(" miss: status not latched\n");
+        return TEST_FAIL;
+    }
+
+    Zcp_reset();
+
+    return (0 == Zcp_get_status()) ? TEST_DONE : TEST_FAIL;
+}
+
+/*
+ * ZCP before the blanking window ends at the minimum blanking time (high speed)
+ */
+int test_case_blank_min_iteration(void)
+{
+    uint16_t delay;
+
+    sim_commutate();
+
+    if (FALSE != Zcp_on_capture( Sim_tm + ZCP_BLANK_MIN - 1, Sim_tm + ZCP_BLANK_MIN, &delay ) ||
+        FALSE == Zcp_on_capture( Sim_tm + ZCP_BLANK_MIN, Sim_tm + ZCP_BLANK_MIN, &delay ))
+    {
+        printf(" blank: minimum window\n");
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    sim_start(1000, 0);
+    putf_n_iterations(1000, &test_case_rotate_iteration, "test_case_rotate_iteration");
+
+    sim_start(12000, 400);
+    putf_n_iterations(1000, &test_case_rotate_iteration, "test_case_rotate_iteration (offset)");
+    putf_n_iterations(ZCP_MISS_MAX + 1, &test_case_miss_iteration, "test_case_miss_iteration");
+
+    sim_start(40, 0);
+    putf_n_iterations(1, &test_case_blank_min_iteration, "test_case_blank_min_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}